@@ -0,0 +1,505 @@
+// Replays a scenario against the mesh pipeline on the virtual clock and reports how long
+// commands take to be confirmed over MQTT. Scenario format, one directive per line:
+//
+//   seed <n>
+//   radio [pdu_airtime_ms=40] [hop_latency_ms=30] [jitter_ms=20] [ack_delay_ms=20] [loss=0] [provisioning_ms=4000]
+//   light <count> [features=onoff,lightness,hsl,ctl] [hops=1] [loss=<radio loss>]
+//   at <ms> <action>
+//   every <period_ms> from <ms> to <ms> <action>
+//   run <ms>
+//
+// Actions, <lights> being a light index, a range "2-5" or "*":
+//   provision <lights>                     beacon, then provision_device() as the web UI does
+//   refresh                                refresh_all_nodes(), the warm boot traffic
+//   set <lights> onoff=0|1 brightness=0..255 hs=<h>,<s> color_temp=<kelvin>
+//                                          what parse_mqtt_event_data does for a set topic,
+//                                          "random" draws a value
+//   power <lights> on|off
+//   console <command line>                 a firmware console command
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "cJSON.h"
+
+#include "ble_mesh/ble_mesh_commands.h"
+#include "ble_mesh/ble_mesh_control.h"
+#include "ble_mesh/ble_mesh_node.h"
+#include "ble_mesh/ble_mesh_provisioning.h"
+#include "ble_mesh/message_queue.h"
+#include "debug/debug_commands_registry.h"
+
+#include "mesh_sim.h"
+#include "mqtt_sink.h"
+#include "sim_clock.h"
+#include "sim_host.h"
+
+namespace
+{
+struct scenario
+{
+    uint64_t seed = 1;
+    sim_radio_config radio;
+    std::vector<sim_light_config> lights;
+    std::vector<std::pair<int64_t, std::string>> actions; // Time and action text, in file order
+    int64_t run_us = -1;
+};
+
+std::mt19937_64 value_rng;
+std::map<uint16_t, int64_t> unconfirmed_since; // Primary unicast, oldest command not yet published
+std::vector<int64_t> completion_us;
+uint32_t commands = 0;
+uint32_t skipped = 0;
+} // namespace
+
+[[noreturn]] static void fail(size_t line, const std::string &message)
+{
+    fprintf(stderr, "scenario line %zu: %s\n", line, message.c_str());
+    exit(2);
+}
+
+static std::map<std::string, std::string> parse_options(std::istringstream &words)
+{
+    std::map<std::string, std::string> options;
+    for (std::string word; words >> word;)
+    {
+        const size_t equal = word.find('=');
+        options[word.substr(0, equal)] = equal == std::string::npos ? "" : word.substr(equal + 1);
+    }
+    return options;
+}
+
+static uint16_t parse_features(const std::string &list)
+{
+    uint16_t features = 0;
+    std::istringstream names(list);
+    for (std::string name; std::getline(names, name, ',');)
+    {
+        if (name == "onoff")
+            features |= FEATURE_GENERIC_ONOFF;
+        else if (name == "lightness")
+            features |= FEATURE_LIGHT_LIGHTNESS;
+        else if (name == "hsl")
+            features |= FEATURE_LIGHT_HSL;
+        else if (name == "ctl")
+            features |= FEATURE_LIGHT_CTL;
+    }
+    return features;
+}
+
+static scenario load_scenario(const char *path)
+{
+    std::ifstream file(path);
+    if (!file)
+    {
+        fprintf(stderr, "cannot open %s\n", path);
+        exit(2);
+    }
+
+    scenario result;
+    size_t line_number = 0;
+    for (std::string line; std::getline(file, line);)
+    {
+        line_number++;
+        line = line.substr(0, line.find('#'));
+        std::istringstream words(line);
+        std::string directive;
+        if (!(words >> directive))
+            continue;
+
+        if (directive == "seed")
+        {
+            words >> result.seed;
+        }
+        else if (directive == "radio")
+        {
+            for (const auto &[key, value] : parse_options(words))
+            {
+                const double number = atof(value.c_str());
+                if (key == "pdu_airtime_ms")
+                    result.radio.pdu_airtime_us = number * 1000;
+                else if (key == "hop_latency_ms")
+                    result.radio.hop_latency_us = number * 1000;
+                else if (key == "jitter_ms")
+                    result.radio.jitter_us = number * 1000;
+                else if (key == "ack_delay_ms")
+                    result.radio.ack_delay_us = number * 1000;
+                else if (key == "loss")
+                    result.radio.loss = number;
+                else if (key == "provisioning_ms")
+                    result.radio.provisioning_us = number * 1000;
+                else
+                    fail(line_number, "unknown radio option " + key);
+            }
+        }
+        else if (directive == "light")
+        {
+            int count = 0;
+            words >> count;
+            sim_light_config config;
+            config.features = FEATURE_GENERIC_ONOFF | FEATURE_LIGHT_LIGHTNESS;
+            for (const auto &[key, value] : parse_options(words))
+            {
+                if (key == "features")
+                    config.features = parse_features(value);
+                else if (key == "hops")
+                    config.hops = atoi(value.c_str());
+                else if (key == "loss")
+                    config.loss = atof(value.c_str());
+                else
+                    fail(line_number, "unknown light option " + key);
+            }
+            result.lights.insert(result.lights.end(), count, config);
+        }
+        else if (directive == "at")
+        {
+            int64_t at_ms = 0;
+            words >> at_ms;
+            std::string action;
+            std::getline(words, action);
+            result.actions.emplace_back(at_ms * 1000, action);
+        }
+        else if (directive == "every")
+        {
+            int64_t period_ms = 0, from_ms = 0, to_ms = 0;
+            std::string from, to;
+            words >> period_ms >> from >> from_ms >> to >> to_ms;
+            if (period_ms <= 0 || from != "from" || to != "to")
+                fail(line_number, "expected: every <period_ms> from <ms> to <ms> <action>");
+            std::string action;
+            std::getline(words, action);
+            for (int64_t at_ms = from_ms; at_ms <= to_ms; at_ms += period_ms)
+            {
+                result.actions.emplace_back(at_ms * 1000, action);
+            }
+        }
+        else if (directive == "run")
+        {
+            int64_t run_ms = 0;
+            words >> run_ms;
+            result.run_us = run_ms * 1000;
+        }
+        else
+        {
+            fail(line_number, "unknown directive " + directive);
+        }
+    }
+    return result;
+}
+
+static std::vector<size_t> parse_lights(const std::string &spec)
+{
+    std::vector<size_t> indexes;
+    const size_t count = mesh_sim_light_count();
+    if (spec == "*")
+    {
+        for (size_t i = 0; i < count; i++)
+            indexes.push_back(i);
+        return indexes;
+    }
+    size_t first = 0, last = 0;
+    if (sscanf(spec.c_str(), "%zu-%zu", &first, &last) != 2)
+        last = first = strtoul(spec.c_str(), nullptr, 10);
+    for (size_t i = first; i <= last && i < count; i++)
+    {
+        indexes.push_back(i);
+    }
+    return indexes;
+}
+
+static long parse_value(const std::string &text, long min, long max)
+{
+    if (text == "random")
+        return min + (long)(value_rng() % (uint64_t)(max - min + 1));
+    return std::clamp(strtol(text.c_str(), nullptr, 10), min, max);
+}
+
+// Same node updates and enqueues as parse_mqtt_event_data for a JSON set payload
+static void set_light(size_t index, const std::map<std::string, std::string> &values)
+{
+    bm2mqtt_node_info *node_info = node_manager().get_node(mesh_sim_get_light(index).unicast);
+    if (!node_info || node_info->features == 0)
+    {
+        skipped++;
+        return;
+    }
+
+    if (auto state = values.find("onoff"); state != values.end())
+    {
+        update_node_field(node_info, &bm2mqtt_node_info::onoff, parse_value(state->second, 0, 1), FIELD_ONOFF, state_source::assumed);
+        gen_onoff_set(node_info);
+    }
+
+    bool light_value_changed = false;
+    color_mode_t current_mode = node_info->color_mode;
+    if (node_info->features & (FEATURE_LIGHT_LIGHTNESS | FEATURE_LIGHT_HSL))
+    {
+        if (auto brightness = values.find("brightness"); brightness != values.end())
+        {
+            current_mode = color_mode_t::brightness;
+            update_node_field(node_info, &bm2mqtt_node_info::hsl_l, map(parse_value(brightness->second, 0, 255), 0, 255, node_info->min_lightness, node_info->max_lightness), FIELD_LIGHTNESS, state_source::assumed);
+            light_value_changed = true;
+        }
+    }
+    if (node_info->features & FEATURE_LIGHT_HSL)
+    {
+        if (auto hs = values.find("hs"); hs != values.end())
+        {
+            const size_t comma = hs->second.find(',');
+            update_node_field(node_info, &bm2mqtt_node_info::hsl_h, map(parse_value(hs->second.substr(0, comma), 0, 360), 0, 360, node_info->min_hue, node_info->max_hue), FIELD_HUE_SATURATION, state_source::assumed);
+            if (comma != std::string::npos)
+                update_node_field(node_info, &bm2mqtt_node_info::hsl_s, map(parse_value(hs->second.substr(comma + 1), 0, 100), 0, 100, node_info->min_saturation, node_info->max_saturation), FIELD_HUE_SATURATION, state_source::assumed);
+            current_mode = color_mode_t::hs;
+            light_value_changed = true;
+        }
+    }
+    if (node_info->features & FEATURE_LIGHT_CTL)
+    {
+        if (auto color_temp = values.find("color_temp"); color_temp != values.end())
+        {
+            update_node_field(node_info, &bm2mqtt_node_info::curr_temp, map(parse_value(color_temp->second, 2000, 6535), 2000, 6535, node_info->min_temp, node_info->max_temp), FIELD_TEMPERATURE, state_source::assumed);
+            current_mode = color_mode_t::color_temp;
+            light_value_changed = true;
+        }
+    }
+
+    if (light_value_changed)
+    {
+        if (current_mode == color_mode_t::color_temp)
+            ble_mesh_ctl_set(node_info);
+        else if (current_mode == color_mode_t::hs)
+            light_hsl_set(node_info);
+        else
+            ble_mesh_lightness_set(node_info);
+    }
+
+    commands++;
+    // A set that changes nothing gets no status publish, Home Assistant already shows its values
+    if (node_info->unpublished != 0)
+        unconfirmed_since.try_emplace(node_info->unicast, sim_now_us());
+    message_queue().enqueue(node_info, make_mqtt_marker(node_info->unicast, mqtt_action_t::status, command_priority_t::interactive));
+}
+
+static void run_action(const std::string &text)
+{
+    std::istringstream words(text);
+    std::string verb, target;
+    words >> verb;
+
+    if (verb == "refresh")
+    {
+        refresh_all_nodes();
+    }
+    else if (verb == "console")
+    {
+        std::string line;
+        std::getline(words, line);
+        int ret = 0;
+        if (sim_console_run(line, &ret) != ESP_OK)
+            fprintf(stderr, "unknown console command:%s\n", line.c_str());
+    }
+    else if (verb == "provision" && words >> target)
+    {
+        for (size_t index : parse_lights(target))
+        {
+            mesh_sim_beacon(index);
+            const sim_light &light = mesh_sim_get_light(index);
+            sim_schedule_in(500000, [&light]()
+                            { provision_device(light.uuid); });
+        }
+    }
+    else if (verb == "set" && words >> target)
+    {
+        const auto values = parse_options(words);
+        for (size_t index : parse_lights(target))
+        {
+            set_light(index, values);
+        }
+    }
+    else if (verb == "power" && words >> target)
+    {
+        std::string state;
+        words >> state;
+        for (size_t index : parse_lights(target))
+        {
+            mesh_sim_set_power(index, state == "on");
+        }
+    }
+    else
+    {
+        fprintf(stderr, "unknown action:%s\n", text.c_str());
+        exit(2);
+    }
+}
+
+static int64_t percentile(const std::vector<int64_t> &sorted, double percent)
+{
+    if (sorted.empty())
+        return 0;
+    const size_t rank = (size_t)(percent / 100.0 * (sorted.size() - 1) + 0.5);
+    return sorted[rank];
+}
+
+// Sums a counter over the entries of one section of the message queue stats JSON
+static uint64_t sum_field(const std::string &json, const char *section, const char *field)
+{
+    const std::string key = std::string("\"") + field + "\":";
+    size_t pos = json.find(std::string("\"") + section + "\":");
+    const size_t end = json.find("]", pos);
+    uint64_t sum = 0;
+    while ((pos = json.find(key, pos)) != std::string::npos && pos < end)
+    {
+        pos += key.size();
+        sum += strtoull(json.c_str() + pos, nullptr, 10);
+    }
+    return sum;
+}
+
+// Every page of the message queue stats JSON, the nodes are split between them
+static std::vector<std::string> stats_pages()
+{
+    std::vector<std::string> pages;
+    size_t slot = 0;
+    do
+    {
+        slot = message_queue().print_stats_json(slot, [&pages](std::string_view json) { pages.emplace_back(json); });
+    } while (slot != 0);
+    return pages;
+}
+
+static uint64_t sum_node_field(const std::vector<std::string> &pages, const char *field)
+{
+    uint64_t sum = 0;
+    for (const std::string &page : pages)
+    {
+        sum += sum_field(page, "nodes", field);
+    }
+    return sum;
+}
+
+static bool matches_last_command(const sim_light &light, const bm2mqtt_node_info &node)
+{
+    if (!(node.features & (FEATURE_LIGHT_LIGHTNESS | FEATURE_LIGHT_HSL | FEATURE_LIGHT_CTL)))
+        return light.state.onoff == node.onoff;
+    if (!node.onoff)
+        return light.state.onoff == 0;
+    if (node.color_mode == color_mode_t::color_temp)
+        return light.state.onoff && light.state.temperature == node.curr_temp;
+    if (node.color_mode == color_mode_t::hs)
+        return light.state.onoff && light.state.hue == node.hsl_h && light.state.saturation == node.hsl_s;
+    return light.state.lightness == node.hsl_l;
+}
+
+static void report(const char *path, int64_t run_us)
+{
+    std::sort(completion_us.begin(), completion_us.end());
+    const double seconds = run_us / 1e6;
+    const sim_radio_counters &radio = mesh_sim_get_counters();
+    const mqtt_sink_counters &mqtt = mqtt_sink_get_counters();
+
+    const std::vector<std::string> pages = stats_pages();
+    const std::string &stats = pages.front();
+
+    size_t provisioned = 0, matching = 0, commanded = 0;
+    for (size_t i = 0; i < mesh_sim_light_count(); i++)
+    {
+        const sim_light &light = mesh_sim_get_light(i);
+        bm2mqtt_node_info *node = node_manager().get_node(light.unicast);
+        if (!node)
+            continue;
+        provisioned++;
+        if (!unconfirmed_since.count(light.unicast) && !mqtt_sink_get_published().count(light.unicast))
+            continue;
+        commanded++;
+        matching += matches_last_command(light, *node);
+    }
+
+    printf("scenario     %s: %zu lights, %zu provisioned, %.1f s simulated\n", path, mesh_sim_light_count(), provisioned, seconds);
+    printf("commands     %" PRIu32 " sent, %zu confirmed, %zu unconfirmed, %" PRIu32 " skipped (light unknown)\n",
+           commands, completion_us.size(), unconfirmed_since.size(), skipped);
+    printf("completion   p50 %" PRId64 " ms, p90 %" PRId64 " ms, p99 %" PRId64 " ms, max %" PRId64 " ms\n",
+           percentile(completion_us, 50) / 1000, percentile(completion_us, 90) / 1000,
+           percentile(completion_us, 99) / 1000, completion_us.empty() ? 0 : completion_us.back() / 1000);
+    printf("throughput   %.2f confirmed/s, %.2f mesh messages/s, %.2f PDUs/s\n",
+           completion_us.size() / seconds, radio.messages / seconds, radio.pdus / seconds);
+    printf("pipeline     %" PRIu64 " sent, %" PRIu64 " retries, %" PRIu64 " timeouts, %" PRIu64 " dropped, %" PRIu64 " coalesced\n",
+           sum_field(stats, "opcodes", "sent"), sum_field(stats, "opcodes", "retries"), sum_field(stats, "opcodes", "timeouts"),
+           sum_field(stats, "opcodes", "dropped"), sum_node_field(pages, "coalesced"));
+    printf("radio        %" PRIu32 " messages, %" PRIu32 " PDUs, %" PRIu32 " lost, %" PRIu32 " ignored, %" PRIu32 " late, %" PRIu32 " busy, %" PRIu32 " no buffers, bearer backlog max %" PRIu32 " PDUs\n",
+           radio.messages, radio.pdus, radio.lost, radio.ignored, radio.late_replies, radio.busy, radio.no_buffers, radio.max_bearer_backlog);
+    printf("mqtt         %" PRIu32 " status (%.2f per command), %" PRIu32 " discovery, %" PRIu32 " online, %" PRIu32 " offline\n",
+           mqtt.status, commands ? (double)mqtt.status / commands : 0.0, mqtt.discovery, mqtt.online, mqtt.offline);
+    printf("final state  %zu/%zu commanded lights match the bridge state\n", matching, commanded);
+}
+
+int main(int argc, char **argv)
+{
+    const char *path = nullptr;
+    bool verbose = false, dump_json = false;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-v") == 0)
+            verbose = true;
+        else if (strcmp(argv[i], "-j") == 0)
+            dump_json = true;
+        else
+            path = argv[i];
+    }
+    if (!path)
+    {
+        fprintf(stderr, "usage: %s [-v] [-j] <scenario>\n  -v  firmware logs\n  -j  message queue stats JSON at the end\n", argv[0]);
+        return 2;
+    }
+
+    const scenario script = load_scenario(path);
+    esp_log_level_set("*", verbose ? ESP_LOG_INFO : ESP_LOG_NONE);
+    mesh_sim_configure(script.seed, script.radio);
+    value_rng.seed(script.seed ^ 0x5eed);
+    for (const sim_light_config &config : script.lights)
+    {
+        mesh_sim_add_light(config);
+    }
+
+    mqtt_sink_on_status([](const bm2mqtt_node_info *node)
+                        {
+        auto since = unconfirmed_since.find(node->unicast);
+        if (since == unconfirmed_since.end())
+            return;
+        completion_us.push_back(sim_now_us() - since->second);
+        unconfirmed_since.erase(since); });
+
+    // Boot order of app_main
+    debug_command_registry::run_all();
+    ble_mesh_init();
+    node_manager().initialize();
+    refresh_all_nodes();
+
+    int64_t last_action_us = 0;
+    for (const auto &[at_us, action] : script.actions)
+    {
+        sim_schedule(at_us, [action]()
+                     { run_action(action); });
+        last_action_us = std::max(last_action_us, at_us);
+    }
+    const int64_t run_us = script.run_us >= 0 ? script.run_us : last_action_us + 60000000;
+    sim_run_until(run_us);
+
+    report(path, run_us);
+    if (dump_json)
+    {
+        for (const std::string &page : stats_pages())
+        {
+            printf("%s\n", page.c_str());
+        }
+    }
+    return 0;
+}
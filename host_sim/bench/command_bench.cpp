@@ -0,0 +1,279 @@
+// Inbound light commands: the streaming parser (main/mqtt/light_command.cpp) against the cJSON
+// tree lookups it replaced. Runs the corpus files given on the command line through both and
+// compares what they extract, mutates the corpus for a fuzzing pass over exact size buffers (build
+// with -fsanitize=address,undefined to catch reads past the payload), then times both on the
+// corpus inputs, ns and heap allocations per command. SHOW=1 lists every input they disagree on.
+//   host_sim/build/command_bench host_sim/bench/corpus/light_command/*.json
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "cJSON.h"
+#include "mqtt/light_command.h"
+
+extern "C" void *__libc_malloc(size_t size);
+extern "C" void *__libc_calloc(size_t count, size_t size);
+extern "C" void *__libc_realloc(void *ptr, size_t size);
+extern "C" void __libc_free(void *ptr);
+
+namespace
+{
+size_t allocations = 0;
+}
+
+// Counted while the timings run. Not with the sanitizers, which bring their own allocator.
+#if !defined(__SANITIZE_ADDRESS__)
+extern "C" void *malloc(size_t size)
+{
+    allocations++;
+    return __libc_malloc(size);
+}
+
+extern "C" void *calloc(size_t count, size_t size)
+{
+    allocations++;
+    return __libc_calloc(count, size);
+}
+
+extern "C" void *realloc(void *ptr, size_t size)
+{
+    allocations++;
+    return __libc_realloc(ptr, size);
+}
+
+extern "C" void free(void *ptr)
+{
+    __libc_free(ptr);
+}
+#endif
+
+namespace
+{
+constexpr int fuzz_iterations = 200000;
+constexpr int timed_commands = 200000;
+volatile size_t sink;
+
+// What handle_node_set() read from the cJSON tree before the streaming parser
+bool extract_cjson(const char *data, size_t size, light_command *command)
+{
+    *command = light_command{};
+    cJSON *response = cJSON_ParseWithLength(data, size);
+    if (!response)
+        return false;
+    if (!cJSON_IsObject(response))
+    {
+        cJSON_Delete(response);
+        return false;
+    }
+    if (const cJSON *name = cJSON_GetObjectItemCaseSensitive(response, "state"))
+    {
+        command->present |= light_command::HAS_STATE;
+        if (cJSON_IsString(name) && (name->valuestring != NULL))
+        {
+            command->state = strcmp(name->valuestring, "ON") == 0 ? light_command::state_t::on : strcmp(name->valuestring, "OFF") == 0 ? light_command::state_t::off : light_command::state_t::other;
+        }
+    }
+    const auto number = [](const cJSON *item, double *value, uint8_t flag, uint8_t *present)
+    {
+        if (cJSON_IsNumber(item))
+        {
+            *value = item->valuedouble;
+            *present |= flag;
+        }
+    };
+    number(cJSON_GetObjectItemCaseSensitive(response, "brightness"), &command->brightness, light_command::HAS_BRIGHTNESS, &command->present);
+    number(cJSON_GetObjectItemCaseSensitive(response, "color_temp"), &command->color_temp, light_command::HAS_COLOR_TEMP, &command->present);
+    number(cJSON_GetObjectItemCaseSensitive(response, "transition"), &command->transition, light_command::HAS_TRANSITION, &command->present);
+    if (cJSON *color = cJSON_GetObjectItemCaseSensitive(response, "color"); cJSON_IsObject(color))
+    {
+        number(cJSON_GetObjectItemCaseSensitive(color, "h"), &command->hue, light_command::HAS_HUE, &command->present);
+        number(cJSON_GetObjectItemCaseSensitive(color, "s"), &command->saturation, light_command::HAS_SATURATION, &command->present);
+    }
+    cJSON_Delete(response);
+    return true;
+}
+
+// Effect strings differ by design (escapes kept raw, truncated), the rest must match
+bool same_command(const light_command &a, const light_command &b)
+{
+    const uint8_t compared = ~light_command::HAS_EFFECT;
+    const auto same = [](double x, double y)
+    { return x == y || (std::isnan(x) && std::isnan(y)); };
+    return (a.present & compared) == (b.present & compared) && a.state == b.state && same(a.brightness, b.brightness) &&
+           same(a.hue, b.hue) && same(a.saturation, b.saturation) && same(a.color_temp, b.color_temp) && same(a.transition, b.transition);
+}
+
+struct comparison
+{
+    size_t both = 0;        // Accepted by both and equal
+    size_t differ = 0;      // Accepted by both, different commands
+    size_t cjson_only = 0;  // Trailing bytes, numbers past the double range: cJSON is lenient
+    size_t stream_only = 0; // Must stay 0
+    size_t rejected = 0;
+};
+
+void compare(const std::string &input, comparison &result, const char *label)
+{
+    // Exact size copy, nothing readable past the payload
+    std::unique_ptr<char[]> payload{new char[input.size() ? input.size() : 1]};
+    memcpy(payload.get(), input.data(), input.size());
+
+    light_command streamed, tree;
+    const bool stream_ok = parse_light_command(payload.get(), input.size(), &streamed);
+    const bool cjson_ok = extract_cjson(payload.get(), input.size(), &tree);
+    if (stream_ok && cjson_ok)
+    {
+        if (same_command(streamed, tree))
+        {
+            result.both++;
+        }
+        else
+        {
+            result.differ++;
+            if (label)
+                printf("  differ: %s\n", label);
+        }
+    }
+    else if (stream_ok)
+    {
+        result.stream_only++;
+        if (label)
+            printf("  accepted by the streaming parser only: %s\n", label);
+    }
+    else if (cjson_ok)
+    {
+        result.cjson_only++;
+        if (label && getenv("SHOW"))
+            printf("  accepted by cJSON only: %s\n", label);
+    }
+    else
+    {
+        result.rejected++;
+    }
+}
+
+void mutate(std::string &input, std::mt19937 &rng, const std::vector<std::string> &corpus)
+{
+    static const char alphabet[] = "{}[]\":,\\ 0123456789.-+eEtrufalsnONF";
+    switch (rng() % 6)
+    {
+    case 0:
+        if (!input.empty())
+            input[rng() % input.size()] ^= 1 << (rng() % 8);
+        break;
+    case 1:
+        input.insert(input.begin() + (input.empty() ? 0 : rng() % (input.size() + 1)), alphabet[rng() % (sizeof(alphabet) - 1)]);
+        break;
+    case 2:
+        if (!input.empty())
+            input.erase(rng() % input.size(), 1 + rng() % 4);
+        break;
+    case 3:
+        input.resize(input.empty() ? 0 : rng() % input.size());
+        break;
+    case 4:
+    {
+        const std::string &other = corpus[rng() % corpus.size()];
+        if (!other.empty())
+            input.insert(input.empty() ? 0 : rng() % input.size(), other.substr(rng() % other.size()));
+        break;
+    }
+    default:
+        if (!input.empty())
+            input[rng() % input.size()] = alphabet[rng() % (sizeof(alphabet) - 1)];
+        break;
+    }
+}
+
+template <typename Parse>
+std::pair<double, double> measure(const std::vector<std::string> &inputs, Parse &&parse)
+{
+    const size_t allocations_before = allocations;
+    const auto start = std::chrono::steady_clock::now();
+    size_t total = 0;
+    for (int i = 0; i < timed_commands; i++)
+    {
+        const std::string &input = inputs[i % inputs.size()];
+        total += parse(input);
+    }
+    sink = total;
+    const double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    return {ns / timed_commands, double(allocations - allocations_before) / timed_commands};
+}
+} // namespace
+
+int main(int argc, char **argv)
+{
+    std::vector<std::string> corpus;
+    comparison seeds;
+    for (int i = 1; i < argc; i++)
+    {
+        std::ifstream file(argv[i], std::ios::binary);
+        if (!file)
+        {
+            fprintf(stderr, "cannot read %s\n", argv[i]);
+            return 2;
+        }
+        corpus.emplace_back(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        compare(corpus.back(), seeds, argv[i]);
+    }
+    if (corpus.empty())
+    {
+        fprintf(stderr, "usage: %s corpus files...\n", argv[0]);
+        return 2;
+    }
+
+    comparison fuzzed;
+    std::mt19937 rng(1);
+    for (int i = 0; i < fuzz_iterations; i++)
+    {
+        std::string input = corpus[rng() % corpus.size()];
+        for (int mutations = 1 + rng() % 4; mutations > 0; mutations--)
+        {
+            mutate(input, rng, corpus);
+        }
+        compare(input, fuzzed, getenv("SHOW") ? input.c_str() : nullptr);
+    }
+
+    // Timings on the inputs a light actually gets: the ones both accept
+    std::vector<std::string> valid;
+    for (const std::string &input : corpus)
+    {
+        light_command streamed, tree;
+        if (parse_light_command(input.data(), input.size(), &streamed) && extract_cjson(input.data(), input.size(), &tree))
+            valid.push_back(input);
+    }
+    // cJSON_Parse() on a NUL terminated copy, as handle_node_set() called it
+    const auto [cjson_ns, cjson_allocations] = measure(valid, [](const std::string &input)
+                                                       {
+        cJSON *response = cJSON_Parse(input.c_str());
+        size_t found = cJSON_GetObjectItemCaseSensitive(response, "state") != nullptr;
+        found += cJSON_GetObjectItemCaseSensitive(response, "brightness") != nullptr;
+        found += cJSON_GetObjectItemCaseSensitive(response, "color") != nullptr;
+        found += cJSON_GetObjectItemCaseSensitive(response, "color_temp") != nullptr;
+        cJSON_Delete(response);
+        return found; });
+    const auto [stream_ns, stream_allocations] = measure(valid, [](const std::string &input)
+                                                         {
+        light_command command;
+        return parse_light_command(input.data(), input.size(), &command) ? size_t{command.present} : 0; });
+
+    const auto print = [](const char *name, const comparison &c)
+    {
+        printf("%-12s %zu same, %zu different, %zu cJSON only, %zu streaming only, %zu rejected by both\n", name,
+               c.both, c.differ, c.cjson_only, c.stream_only, c.rejected);
+    };
+    print("corpus", seeds);
+    print("fuzzed", fuzzed);
+    printf("cJSON        %.1f ns, %.1f allocations per command\n", cjson_ns, cjson_allocations);
+    printf("streaming    %.1f ns, %.1f allocations per command\n", stream_ns, stream_allocations);
+    return seeds.differ + seeds.stream_only + fuzzed.differ + fuzzed.stream_only == 0 ? 0 : 1;
+}
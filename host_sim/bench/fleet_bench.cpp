@@ -0,0 +1,166 @@
+// Lookup and for-each throughput of the node table on large fleets: the hot/cold node layout in
+// the slab with separate occupancy bitmaps, against the interleaved layout it replaced (UUID
+// first, slot flags after each node). Wall clock, not the simulated one.
+#include <chrono>
+#include <cstdio>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include "ble_mesh/ble_mesh_node.h"
+
+namespace
+{
+constexpr size_t capacity = 2048;
+constexpr int lookups = 400000;
+constexpr int scans = 2000;
+volatile uint32_t sink;
+
+// bm2mqtt_node_info before the split
+struct interleaved_node
+{
+    Uuid128 uuid;
+    uint16_t unicast{0};
+    uint16_t hsl_h{0};
+    uint16_t min_hue{0};
+    uint16_t max_hue{std::numeric_limits<uint16_t>::max()};
+    uint16_t hsl_s{0};
+    uint16_t min_saturation{0};
+    uint16_t max_saturation{std::numeric_limits<uint16_t>::max()};
+    uint16_t hsl_l{0};
+    uint16_t min_lightness{0};
+    uint16_t max_lightness{std::numeric_limits<uint16_t>::max()};
+    uint16_t curr_temp{0};
+    uint16_t min_temp{0};
+    uint16_t max_temp{std::numeric_limits<uint16_t>::max()};
+    int16_t level{0};
+    uint16_t features{0};
+    uint16_t features_to_bind{0};
+    uint16_t node_index{0};
+    uint8_t elem_num{0};
+    uint8_t onoff{0};
+    uint8_t light_ctl_temp_offset{0};
+    color_mode_t color_mode = color_mode_t::brightness;
+};
+
+// Slot storage of the slab before the split: flags next to each element
+struct interleaved_table
+{
+    struct slot
+    {
+        interleaved_node value{};
+        uint16_t generation = 0;
+        bool used = false;
+    };
+    std::vector<slot> slots = std::vector<slot>(capacity);
+
+    interleaved_node *at(size_t index) { return index < slots.size() && slots[index].used ? &slots[index].value : nullptr; }
+
+    template <typename F>
+    void for_each(F &&func)
+    {
+        for (slot &s : slots)
+        {
+            if (s.used)
+                func(s.value);
+        }
+    }
+};
+
+using split_table = slab<bm2mqtt_node_info, capacity>;
+
+template <typename Body>
+double ns_per_op(int count, Body &&body)
+{
+    const auto start = std::chrono::steady_clock::now();
+    uint32_t total = 0;
+    for (int i = 0; i < count; i++)
+    {
+        total += body(i);
+    }
+    sink = total;
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / count;
+}
+
+// Status path: resolve the source address, update the light state
+template <typename Table>
+double status_updates(Table &table, const node_index &index, const std::vector<uint16_t> &addrs)
+{
+    return ns_per_op(lookups, [&](int i)
+                     {
+        auto *node = table.at(index.find_unicast(addrs[i]));
+        if (!node)
+            return 0u;
+        node->onoff = 1;
+        node->hsl_l = addrs[i];
+        return static_cast<uint32_t>(node->curr_temp + static_cast<uint8_t>(node->color_mode)); });
+}
+
+// Publish path: every provisioned node's live state, per node
+template <typename Table>
+double state_scans(Table &table, size_t count)
+{
+    return ns_per_op(scans, [&](int)
+                     {
+        uint32_t total = 0;
+        table.for_each([&total](const auto &node)
+                       {
+            if (node.unicast != 0)
+                total += node.onoff + node.hsl_l + node.curr_temp; });
+        return total; }) / count;
+}
+} // namespace
+
+int main()
+{
+    printf("node layout: %zu bytes split, %zu bytes interleaved + slot flags\n\n",
+           sizeof(bm2mqtt_node_info), sizeof(interleaved_table::slot));
+    printf("%6s  %27s  %27s\n", "nodes", "status update split/old ns", "for-each split/old ns/node");
+
+    static split_table split;
+    for (size_t count : {100, 500, 1000, 2000})
+    {
+        std::mt19937_64 rng(count);
+        interleaved_table interleaved;
+        split.clear();
+        node_index index;
+        uint16_t next_unicast = 0x0005;
+        std::vector<uint16_t> unicasts;
+
+        for (uint16_t slot = 0; slot < count; slot++)
+        {
+            uint8_t uuid[16];
+            for (uint8_t &b : uuid)
+                b = rng();
+            const uint8_t elem_num = 1 + rng() % 3;
+
+            bm2mqtt_node_info *node = split.allocate();
+            node->uuid = Uuid128{uuid};
+            node->unicast = next_unicast;
+            node->elem_num = elem_num;
+            interleaved.slots[slot].used = true;
+            interleaved.slots[slot].value.uuid = node->uuid;
+            interleaved.slots[slot].value.unicast = next_unicast;
+            interleaved.slots[slot].value.elem_num = elem_num;
+
+            index.insert(slot, node->uuid);
+            index.set_address(slot, next_unicast, elem_num);
+            unicasts.push_back(next_unicast);
+            next_unicast += elem_num;
+        }
+
+        std::vector<uint16_t> addrs(lookups);
+        for (uint16_t &addr : addrs)
+        {
+            addr = unicasts[rng() % count];
+        }
+
+        const double update_split = status_updates(split, index, addrs);
+        const double update_old = status_updates(interleaved, index, addrs);
+        const double scan_split = state_scans(split, count);
+        const double scan_old = state_scans(interleaved, count);
+
+        printf("%6zu  %13.1f / %11.1f  %13.2f / %11.2f\n", count, update_split, update_old, scan_split, scan_old);
+    }
+    return 0;
+}
@@ -0,0 +1,158 @@
+// Lookup cost of the node manager indexes against the linear scans they replaced, and of the
+// inbound MQTT topic router against the topic parsing it replaced, for registries of 10 to 500
+// nodes. Wall clock, not the simulated one.
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "ble_mesh_example_init.h"
+#include "ble_mesh/node_index.h"
+#include "mqtt/mqtt_bridge.h"
+#include "mqtt/topic_router.h"
+
+namespace
+{
+struct scanned_node
+{
+    Uuid128 uuid;
+    uint8_t addr[6];
+    uint16_t unicast;
+    uint8_t elem_num;
+};
+
+constexpr int lookups = 200000;
+volatile uint32_t sink;
+
+template <typename Lookup>
+double ns_per_lookup(Lookup &&lookup)
+{
+    const auto start = std::chrono::steady_clock::now();
+    uint32_t found = 0;
+    for (int i = 0; i < lookups; i++)
+    {
+        found += lookup(i);
+    }
+    sink = found;
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / lookups;
+}
+
+void node_set_handler(const char *, int, slab_handle)
+{
+}
+
+// The firmware's resolve_node_level(), over the bench's index
+const node_index *routed_index = nullptr;
+
+slab_handle resolve_node_level(std::string_view level)
+{
+    uint64_t key;
+    if (!level.starts_with("node_") || !mac_key_from_hex(level.substr(5), &key))
+        return {};
+    const uint16_t slot = routed_index->find_mac(key);
+    return slot != node_index::npos ? slab_handle{slot, 0} : slab_handle{};
+}
+
+std::string node_set_topic(const uint8_t addr[6])
+{
+    return get_bridge_base_topic() + "/node_" + bt_hex(addr, 6) + "/set";
+}
+} // namespace
+
+int main()
+{
+    printf("%6s  %23s  %23s  %23s  %23s\n", "nodes", "unicast scan/index ns", "uuid scan/index ns", "mac scan/index ns",
+           "topic parse/router ns");
+    for (size_t count : {10, 50, 100, 250, 500})
+    {
+        std::mt19937_64 rng(count);
+        std::vector<scanned_node> nodes(count);
+        node_index index;
+        topic_router router;
+        router.add_level(get_bridge_base_topic(), "set", &node_set_handler, &resolve_node_level);
+        routed_index = &index;
+        uint16_t next_unicast = 0x0005;
+        for (uint16_t slot = 0; slot < count; slot++)
+        {
+            scanned_node &node = nodes[slot];
+            uint8_t uuid[16];
+            for (uint8_t &b : uuid)
+                b = rng();
+            node.uuid = Uuid128{uuid};
+            for (uint8_t &b : node.addr)
+                b = rng();
+            node.unicast = next_unicast;
+            node.elem_num = 1 + rng() % 3;
+            next_unicast += node.elem_num;
+
+            index.insert(slot, node.uuid);
+            index.set_address(slot, node.unicast, node.elem_num);
+            index.set_mac(slot, mac_key(node.addr));
+        }
+
+        // Same random targets for the scan and the index
+        std::vector<uint16_t> addrs(lookups);
+        std::vector<size_t> targets(lookups);
+        std::vector<std::string> macs(lookups);
+        for (int i = 0; i < lookups; i++)
+        {
+            targets[i] = rng() % count;
+            addrs[i] = nodes[targets[i]].unicast + rng() % nodes[targets[i]].elem_num;
+        }
+        std::vector<std::string> topics(lookups);
+        for (int i = 0; i < lookups; i++)
+        {
+            macs[i] = bt_hex(nodes[targets[i]].addr, 6);
+            topics[i] = node_set_topic(nodes[targets[i]].addr);
+        }
+
+        const double unicast_scan = ns_per_lookup([&](int i)
+                                                  {
+            for (const scanned_node &node : nodes)
+                if (node.unicast <= addrs[i] && node.unicast + node.elem_num > addrs[i])
+                    return 1;
+            return 0; });
+        const double unicast_index = ns_per_lookup([&](int i)
+                                                   { return index.find_unicast(addrs[i]) != node_index::npos; });
+
+        const double uuid_scan = ns_per_lookup([&](int i)
+                                               {
+            for (const scanned_node &node : nodes)
+                if (node.uuid == nodes[targets[i]].uuid)
+                    return 1;
+            return 0; });
+        const double uuid_index = ns_per_lookup([&](int i)
+                                                { return index.find(nodes[targets[i]].uuid) != node_index::npos; });
+
+        const double mac_scan = ns_per_lookup([&](int i)
+                                              {
+            for (const scanned_node &node : nodes)
+                if (std::string{bt_hex(node.addr, 6)} == macs[i])
+                    return 1;
+            return 0; });
+        const double mac_index = ns_per_lookup([&](int i)
+                                               {
+            uint64_t key;
+            return mac_key_from_hex(macs[i], &key) && index.find_mac(key) != node_index::npos; });
+
+        // parse_mqtt_event_data() before the router: topic copied, MAC cut out and parsed
+        const double topic_parse = ns_per_lookup([&](int i)
+                                                 {
+            const std::string topic{topics[i].data(), topics[i].size()};
+            if (auto index_pos = topic.find("node_"); index_pos != std::string::npos)
+            {
+                const std::string mac{topic, index_pos + 5, 12};
+                uint64_t key;
+                return mac_key_from_hex(mac, &key) && index.find_mac(key) != node_index::npos;
+            }
+            return false; });
+        const double topic_router = ns_per_lookup([&](int i)
+                                                  { return router.find(topics[i]).node.valid(); });
+
+        printf("%6zu  %11.1f / %9.1f  %11.1f / %9.1f  %11.1f / %9.1f  %11.1f / %9.1f\n", count,
+               unicast_scan, unicast_index, uuid_scan, uuid_index, mac_scan, mac_index, topic_parse, topic_router);
+    }
+    return 0;
+}
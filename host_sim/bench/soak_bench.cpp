@@ -0,0 +1,284 @@
+// Large fleet soak: provisions <nodes> simulated lights, then reports heap use, node lookup
+// latency (wall clock), the time refresh_all_nodes() and a warm start from the stored state take
+// to get a status from every light (virtual clock) and an hour of Home Assistant traffic. Build
+// with the large fleet profile:
+//   cmake -S host_sim -B host_sim/build_large -DSIM_SDKCONFIG_PROFILE=sdkconfig.large_fleet
+//   host_sim/build_large/soak_bench 500
+#include <malloc.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "ble_mesh_example_init.h"
+#include "ble_mesh/ble_mesh_commands.h"
+#include "ble_mesh/ble_mesh_control.h"
+#include "ble_mesh/ble_mesh_node.h"
+#include "ble_mesh/ble_mesh_provisioning.h"
+#include "ble_mesh/message_queue.h"
+#include "debug/debug_commands_registry.h"
+
+#include "mesh_sim.h"
+#include "mqtt_sink.h"
+#include "sim_clock.h"
+#include "sim_host.h"
+
+namespace
+{
+constexpr int64_t provision_interval_us = 6000000;
+constexpr int64_t soak_us = 3600 * 1000000ll;
+constexpr int lookups = 200000;
+
+std::map<uint16_t, int64_t> unconfirmed_since;
+std::vector<int64_t> completion_us;
+volatile uintptr_t sink;
+
+// Large blocks are mapped separately by glibc, hblkhd counts them
+size_t heap_in_use()
+{
+    const struct mallinfo2 info = mallinfo2();
+    return info.uordblks + info.hblkhd;
+}
+
+size_t count_configured()
+{
+    size_t configured = 0;
+    for (size_t i = 0; i < mesh_sim_light_count(); i++)
+    {
+        const bm2mqtt_node_info *node = node_manager().get_node(mesh_sim_get_light(i).unicast);
+        configured += node && node->features != 0;
+    }
+    return configured;
+}
+
+template <typename Lookup>
+double ns_per_lookup(Lookup &&lookup)
+{
+    const auto start = std::chrono::steady_clock::now();
+    uintptr_t found = 0;
+    for (int i = 0; i < lookups; i++)
+    {
+        found += reinterpret_cast<uintptr_t>(lookup(i));
+    }
+    sink = found;
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / lookups;
+}
+
+int64_t percentile(std::vector<int64_t> values, double percent)
+{
+    if (values.empty())
+        return 0;
+    std::sort(values.begin(), values.end());
+    return values[(size_t)(percent / 100.0 * (values.size() - 1) + 0.5)];
+}
+
+void record_completion(const bm2mqtt_node_info *node)
+{
+    auto since = unconfirmed_since.find(node->unicast);
+    if (since == unconfirmed_since.end())
+        return;
+    completion_us.push_back(sim_now_us() - since->second);
+    unconfirmed_since.erase(since);
+}
+
+// What a Home Assistant brightness change does: lightness set plus the status publish marker
+void set_brightness(size_t index, uint16_t lightness)
+{
+    bm2mqtt_node_info *node = node_manager().get_node(mesh_sim_get_light(index).unicast);
+    if (!node || node->features == 0)
+        return;
+    update_node_field(node, &bm2mqtt_node_info::onoff, 1, FIELD_ONOFF, state_source::assumed);
+    update_node_field(node, &bm2mqtt_node_info::hsl_l, lightness, FIELD_LIGHTNESS, state_source::assumed);
+    ble_mesh_lightness_set(node);
+    if (node->unpublished != 0)
+        unconfirmed_since.try_emplace(node->unicast, sim_now_us());
+    message_queue().enqueue(node, make_mqtt_marker(node->unicast, mqtt_action_t::status, command_priority_t::interactive));
+}
+// A brightness change every 2 s, a scene on 20 lights every minute. Scheduled one tick at a
+// time so the simulator's event queue does not weigh on the heap figures.
+void soak_tick(std::mt19937_64 &rng, size_t nodes, int64_t end_us, uint32_t tick)
+{
+    set_brightness(rng() % nodes, rng());
+    if (tick % 30 == 0)
+    {
+        const size_t first = rng() % nodes;
+        const uint16_t lightness = rng();
+        for (size_t i = 0; i < std::min<size_t>(20, nodes); i++)
+        {
+            set_brightness((first + i) % nodes, lightness);
+        }
+    }
+    if (sim_now_us() + 2000000 < end_us)
+    {
+        sim_schedule_in(2000000, [&rng, nodes, end_us, tick]()
+                        { soak_tick(rng, nodes, end_us, tick + 1); });
+    }
+}
+} // namespace
+
+int main(int argc, char **argv)
+{
+    const size_t nodes = argc > 1 ? strtoul(argv[1], nullptr, 10) : 50;
+    if (nodes == 0 || nodes > CONFIG_BLE_MESH_MAX_PROV_NODES)
+    {
+        fprintf(stderr, "usage: %s <nodes>, at most CONFIG_BLE_MESH_MAX_PROV_NODES (%d)\n", argv[0], CONFIG_BLE_MESH_MAX_PROV_NODES);
+        return 2;
+    }
+
+    esp_log_level_set("*", ESP_LOG_NONE);
+    mesh_sim_configure(nodes, sim_radio_config{});
+    std::mt19937_64 rng(nodes);
+    for (size_t i = 0; i < nodes; i++)
+    {
+        sim_light_config config;
+        config.features = FEATURE_GENERIC_ONOFF | FEATURE_LIGHT_LIGHTNESS;
+        if (i % 3 == 1)
+            config.features |= FEATURE_LIGHT_HSL;
+        else if (i % 3 == 2)
+            config.features |= FEATURE_LIGHT_CTL;
+        config.hops = 1 + i % 3;
+        mesh_sim_add_light(config);
+    }
+
+    completion_us.reserve(soak_us / 1000000);
+    const size_t heap_before = heap_in_use();
+    debug_command_registry::run_all();
+    ble_mesh_init();
+    node_manager().initialize();
+    const size_t heap_boot = heap_in_use();
+
+    // Provisioning, one light every few seconds like an installer walking the site
+    int ret = 0;
+    sim_console_run("ble_mesh_set_provisioning_enabled -v 1", &ret);
+    for (size_t i = 0; i < nodes; i++)
+    {
+        sim_schedule(1000000 + i * provision_interval_us, [i]()
+                     {
+            mesh_sim_beacon(i);
+            sim_schedule_in(500000, [i]()
+                            { provision_device(mesh_sim_get_light(i).uuid); }); });
+    }
+    int64_t now_us = 1000000 + nodes * provision_interval_us;
+    sim_run_until(now_us);
+    while (count_configured() < nodes && now_us < 2 * (1000000 + (int64_t)nodes * provision_interval_us))
+    {
+        now_us += 10000000;
+        sim_run_until(now_us);
+    }
+    const size_t configured = count_configured();
+    const size_t heap_provisioned = heap_in_use();
+
+    // Lookups as the mesh callbacks and MQTT handlers make them
+    std::vector<size_t> targets(lookups);
+    for (size_t &target : targets)
+    {
+        target = rng() % nodes;
+    }
+    std::vector<std::string> macs(nodes);
+    for (size_t i = 0; i < nodes; i++)
+    {
+        macs[i] = bt_hex(mesh_sim_get_light(i).mac, BD_ADDR_LEN);
+    }
+    const double unicast_ns = ns_per_lookup([&](int i)
+                                            { return node_manager().get_node(mesh_sim_get_light(targets[i]).unicast); });
+    const double uuid_ns = ns_per_lookup([&](int i)
+                                         { return node_manager().get_node(Uuid128{mesh_sim_get_light(targets[i]).uuid}); });
+    const double mac_ns = ns_per_lookup([&](int i)
+                                        { return node_manager().get_node(macs[targets[i]]); });
+
+    // Refresh: every light queried, done once each has published a status
+    now_us += 60000000;
+    sim_run_until(now_us);
+    const int64_t refresh_start_us = now_us;
+    std::map<uint16_t, int64_t> refreshed_at;
+    mqtt_sink_on_status([&refreshed_at](const bm2mqtt_node_info *node)
+                        { refreshed_at.try_emplace(node->unicast, sim_now_us()); });
+    const auto refresh_wall = std::chrono::steady_clock::now();
+    // As after a reboot or a broker reconnect, otherwise unchanged lights publish nothing
+    node_manager().mark_all_unpublished();
+    refresh_all_nodes();
+    while (refreshed_at.size() < configured && now_us < refresh_start_us + 1800000000ll)
+    {
+        now_us += 1000000;
+        sim_run_until(now_us);
+    }
+    const double refresh_wall_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - refresh_wall).count();
+    std::vector<int64_t> refresh_us;
+    for (const auto &[unicast, at_us] : refreshed_at)
+    {
+        refresh_us.push_back(at_us - refresh_start_us);
+    }
+    const size_t heap_refreshed = heap_in_use();
+
+    // Warm start: the state is as loaded from NVS, published from the cache, then verified by the sweep
+    now_us += 60000000;
+    sim_run_until(now_us);
+    const int64_t warm_start_us = now_us;
+    for (size_t i = 0; i < nodes; i++)
+    {
+        if (bm2mqtt_node_info *node = node_manager().get_node(mesh_sim_get_light(i).unicast))
+        {
+            confirm_node_fields(node, FIELD_LIGHT_STATE, state_source::assumed);
+        }
+    }
+    std::map<uint16_t, int64_t> warm_at;
+    mqtt_sink_on_status([&warm_at](const bm2mqtt_node_info *node)
+                        { warm_at.try_emplace(node->unicast, sim_now_us()); });
+    const auto assumed_left = [nodes]()
+    {
+        size_t left = 0;
+        for (size_t i = 0; i < nodes; i++)
+        {
+            const bm2mqtt_node_info *node = node_manager().get_node(mesh_sim_get_light(i).unicast);
+            left += node && get_field_source(node, FIELD_ONOFF) == state_source::assumed;
+        }
+        return left;
+    };
+    publish_all_node_status();
+    start_nodes();
+    while (assumed_left() > 0 && now_us < warm_start_us + 3600000000ll)
+    {
+        now_us += 1000000;
+        sim_run_until(now_us);
+    }
+    const int64_t verified_us = now_us - warm_start_us;
+    std::vector<int64_t> warm_us;
+    for (const auto &[unicast, at_us] : warm_at)
+    {
+        warm_us.push_back(at_us - warm_start_us);
+    }
+
+    // An hour of Home Assistant traffic
+    mqtt_sink_on_status(record_completion);
+    const int64_t soak_start_us = now_us + 1000000;
+    sim_schedule(soak_start_us, [&rng, nodes, soak_start_us]()
+                 { soak_tick(rng, nodes, soak_start_us + soak_us, 0); });
+    const auto soak_wall = std::chrono::steady_clock::now();
+    now_us = soak_start_us + soak_us + 60000000;
+    sim_run_until(now_us);
+    const double soak_wall_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - soak_wall).count();
+    const size_t heap_soaked = heap_in_use();
+
+    printf("fleet        %zu lights, %zu configured, capacity %d\n", nodes, configured, CONFIG_BLE_MESH_MAX_PROV_NODES);
+    printf("tables       node manager %zu B static, message queues %zu B heap (%zu B per slot)\n",
+           sizeof(ble2mqtt_node_manager), sizeof(class message_queue) * CONFIG_BLE_MESH_MAX_PROV_NODES, sizeof(class message_queue));
+    printf("heap         boot %+zd B, provisioned %+zd B (%zd B per light), after refresh %+zd B, after soak %+zd B\n",
+           (ssize_t)(heap_boot - heap_before), (ssize_t)(heap_provisioned - heap_before),
+           (ssize_t)(heap_provisioned - heap_boot) / (ssize_t)nodes,
+           (ssize_t)(heap_refreshed - heap_before), (ssize_t)(heap_soaked - heap_before));
+    printf("lookup       unicast %.1f ns, uuid %.1f ns, mac %.1f ns\n", unicast_ns, uuid_ns, mac_ns);
+    printf("refresh      %zu/%zu statuses, p50 %.1f s, last %.1f s, %.0f ms wall clock\n",
+           refreshed_at.size(), configured, percentile(refresh_us, 50) / 1e6, percentile(refresh_us, 100) / 1e6, refresh_wall_ms);
+    printf("warm start   %zu/%zu statuses, p50 %.1f s, last %.1f s, all verified within %.0f s\n",
+           warm_at.size(), configured, percentile(warm_us, 50) / 1e6, percentile(warm_us, 100) / 1e6, verified_us / 1e6);
+    printf("soak         1 h, %zu confirmed, %zu unconfirmed, p50 %" PRId64 " ms, p99 %" PRId64 " ms, %.0f ms wall clock\n",
+           completion_us.size(), unconfirmed_since.size(), percentile(completion_us, 50) / 1000,
+           percentile(completion_us, 99) / 1000, soak_wall_ms);
+    return 0;
+}
@@ -0,0 +1,227 @@
+// Status publish cost: the fixed-buffer payload writer against the cJSON tree it replaced and the
+// interned node topics against formatting them per publish, ns and heap allocations per message,
+// with a byte-for-byte comparison of their output.
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "cJSON.h"
+#include "ble_mesh/ble_mesh_control.h"
+#include "ble_mesh/ble_mesh_node.h"
+#include "mqtt/mqtt_bridge.h"
+#include "mqtt/node_topics.h"
+#include "mqtt/status_json.h"
+
+// Every allocation of the process goes through here, counted while a measurement runs
+extern "C" void *__libc_malloc(size_t size);
+extern "C" void *__libc_calloc(size_t count, size_t size);
+extern "C" void *__libc_realloc(void *ptr, size_t size);
+extern "C" void __libc_free(void *ptr);
+
+namespace
+{
+size_t allocations = 0;
+}
+
+extern "C" void *malloc(size_t size)
+{
+    allocations++;
+    return __libc_malloc(size);
+}
+
+extern "C" void *calloc(size_t count, size_t size)
+{
+    allocations++;
+    return __libc_calloc(count, size);
+}
+
+extern "C" void *realloc(void *ptr, size_t size)
+{
+    allocations++;
+    return __libc_realloc(ptr, size);
+}
+
+extern "C" void free(void *ptr)
+{
+    __libc_free(ptr);
+}
+
+namespace
+{
+constexpr int messages = 200000;
+constexpr int states = 64;
+volatile size_t sink;
+
+// make_status_message() and the print of mqtt_node_send_status() before the fixed-buffer writer
+std::unique_ptr<cJSON> make_status_message(const bm2mqtt_node_info *node_info)
+{
+    cJSON *root, *color;
+    root = cJSON_CreateObject();
+
+    if (node_info->unicast != ESP_BLE_MESH_ADDR_UNASSIGNED)
+    {
+        cJSON_AddStringToObject(root, "state", node_info->onoff ? "ON" : "OFF");
+
+        if (node_info->color_mode == color_mode_t::brightness)
+        {
+            cJSON_AddStringToObject(root, "color_mode", "brightness");
+            cJSON_AddNumberToObject(root, "brightness", (uint16_t)map(node_info->hsl_l, node_info->min_lightness, node_info->max_lightness, 0, 255));
+        }
+        else if (node_info->color_mode == color_mode_t::color_temp)
+        {
+            cJSON_AddStringToObject(root, "color_mode", "color_temp");
+            cJSON_AddNumberToObject(root, "color_temp", node_info->curr_temp);
+        }
+        else if (node_info->color_mode == color_mode_t::hs)
+        {
+            cJSON_AddStringToObject(root, "color_mode", "hs");
+            cJSON_AddItemToObject(root, "color", color = cJSON_CreateObject());
+            cJSON_AddNumberToObject(color, "h", (uint16_t)map(node_info->hsl_h, node_info->min_hue, node_info->max_hue, 0, 360));
+            cJSON_AddNumberToObject(color, "s", (uint16_t)map(node_info->hsl_s, node_info->min_saturation, node_info->max_saturation, 0, 100));
+        }
+
+        if (get_field_source(node_info, FIELD_ONOFF) == state_source::assumed)
+        {
+            cJSON_AddItemToObject(root, "assumed", cJSON_CreateBool(1));
+        }
+    }
+
+    return std::unique_ptr<cJSON>{root};
+}
+
+size_t print_cjson(const bm2mqtt_node_info &node)
+{
+    std::unique_ptr<cJSON> message = make_status_message(&node);
+    char *json = cJSON_PrintUnformatted(message.get());
+    const size_t size = strlen(json);
+    cJSON_free(json);
+    return size;
+}
+
+size_t print_fixed(const bm2mqtt_node_info &node)
+{
+    return make_status_json(node).size;
+}
+
+// get_node_state_topic() and get_node_discovery_id() before the topics were interned, the Wi-Fi
+// MAC read and formatted on each call
+std::string format_bridge_base_topic()
+{
+    const uint8_t mac[6] = {0x24, 0xdc, 0xc3, 0xa1, 0xb2, 0xc4};
+    char mac_str[13];
+    snprintf(mac_str, sizeof(mac_str), "%02x%02x%02x%02x%02x%02x", mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+    char topic[32];
+    snprintf(topic, sizeof(topic), "blemesh2mqtt_%s", mac_str);
+    return std::string(topic);
+}
+
+std::string format_state_topic(const uint8_t addr[6])
+{
+    std::string node_addr{bt_hex(addr, BD_ADDR_LEN)};
+    const std::string base = format_bridge_base_topic() + "/node_" + node_addr;
+    return base.empty() ? std::string{} : base + "/state";
+}
+
+std::string format_discovery_id(const uint8_t addr[6])
+{
+    char buf[64] = {0};
+    snprintf(buf, sizeof(buf), "homeassistant/light/blemesh2mqtt_%s", bt_hex(addr, BD_ADDR_LEN));
+    return std::string{buf} + "_light/config";
+}
+
+struct measurement
+{
+    double ns;
+    double allocations;
+};
+
+template <typename Print>
+measurement measure(const std::vector<bm2mqtt_node_info> &nodes, Print &&print)
+{
+    const size_t allocations_before = allocations;
+    const auto start = std::chrono::steady_clock::now();
+    size_t total = 0;
+    for (int i = 0; i < messages; i++)
+    {
+        total += print(nodes[i % nodes.size()]);
+    }
+    sink = total;
+    const double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    return {ns / messages, double(allocations - allocations_before) / messages};
+}
+} // namespace
+
+int main()
+{
+    std::mt19937 rng(1);
+    std::vector<bm2mqtt_node_info> nodes(states);
+    for (size_t i = 0; i < nodes.size(); i++)
+    {
+        bm2mqtt_node_info &node = nodes[i];
+        node.unicast = i == 0 ? ESP_BLE_MESH_ADDR_UNASSIGNED : 0x0005 + i;
+        node.onoff = rng() % 2;
+        node.color_mode = static_cast<color_mode_t>(rng() % 3);
+        node.hsl_h = rng();
+        node.hsl_s = rng();
+        node.hsl_l = rng();
+        node.curr_temp = rng();
+        node.max_hue = node.max_saturation = node.max_lightness = 0xFFFF;
+        node.min_lightness = rng() % 2 ? 0 : rng() % 0x1000;
+        confirm_node_fields(&node, FIELD_LIGHT_STATE, rng() % 4 ? state_source::ack : state_source::assumed);
+    }
+
+    size_t mismatches = 0;
+    for (const bm2mqtt_node_info &node : nodes)
+    {
+        std::unique_ptr<cJSON> message = make_status_message(&node);
+        char *expected = cJSON_PrintUnformatted(message.get());
+        const status_json json = make_status_json(node);
+        if (json.view() != expected)
+        {
+            printf("mismatch: cJSON %s, writer %s\n", expected, json.c_str());
+            mismatches++;
+        }
+        cJSON_free(expected);
+    }
+
+    std::vector<std::array<uint8_t, 6>> macs(states);
+    std::vector<node_topics> interned(states);
+    for (size_t i = 0; i < macs.size(); i++)
+    {
+        for (uint8_t &b : macs[i])
+            b = rng();
+        interned[i] = make_node_topics(get_bridge_base_topic(), macs[i].data());
+        if (interned[i].state() != format_state_topic(macs[i].data()) || interned[i].discovery() != format_discovery_id(macs[i].data()))
+        {
+            printf("mismatch: topics of %s\n", bt_hex(macs[i].data(), BD_ADDR_LEN));
+            mismatches++;
+        }
+    }
+
+    const measurement cjson = measure(nodes, print_cjson);
+    const measurement fixed = measure(nodes, print_fixed);
+    printf("output       %zu/%zu states identical, largest payload %zu of %zu B\n", nodes.size() - mismatches, nodes.size(),
+           [&nodes]()
+           {
+               size_t largest = 0;
+               for (const bm2mqtt_node_info &node : nodes)
+                   largest = std::max(largest, make_status_json(node).size);
+               return largest;
+           }(),
+           status_json::max_size);
+    const measurement formatted_topic = measure(nodes, [&macs](const bm2mqtt_node_info &node)
+                                                { return format_state_topic(macs[node.unicast % states].data()).size(); });
+    const measurement interned_topic = measure(nodes, [&interned](const bm2mqtt_node_info &node)
+                                               {
+        const node_topics topics = interned[node.unicast % states];
+        return strlen(topics.state()); });
+    printf("cJSON        %.1f ns, %.1f allocations per message\n", cjson.ns, cjson.allocations);
+    printf("fixed buffer %.1f ns, %.1f allocations per message\n", fixed.ns, fixed.allocations);
+    printf("topic        formatted %.1f ns, %.1f allocations, interned copy %.1f ns, %.1f allocations\n",
+           formatted_topic.ns, formatted_topic.allocations, interned_topic.ns, interned_topic.allocations);
+    return mismatches == 0 ? 0 : 1;
+}
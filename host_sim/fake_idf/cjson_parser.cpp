@@ -0,0 +1,218 @@
+// Parsing subset of cJSON for the host benches, allocating the way cJSON does: one item per
+// value, key and string copies on the heap, numbers through strtod. Surrogate pairs are not
+// decoded.
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "cJSON.h"
+
+namespace
+{
+struct parser
+{
+    const char *p;
+    const char *end;
+
+    void skip_whitespace()
+    {
+        while (p < end && (unsigned char)*p <= ' ')
+            p++;
+    }
+
+    bool string(char **out)
+    {
+        if (p == end || *p != '"')
+            return false;
+        std::string value;
+        for (p++; p < end && *p != '"'; p++)
+        {
+            if (*p == '\\')
+            {
+                if (++p == end)
+                    return false;
+                switch (*p)
+                {
+                case '"': value += '"'; break;
+                case '\\': value += '\\'; break;
+                case '/': value += '/'; break;
+                case 'n': value += '\n'; break;
+                case 't': value += '\t'; break;
+                case 'r': value += '\r'; break;
+                case 'b': value += '\b'; break;
+                case 'f': value += '\f'; break;
+                case 'u':
+                {
+                    if (end - p < 5 || !isxdigit((unsigned char)p[1]) || !isxdigit((unsigned char)p[2]) ||
+                        !isxdigit((unsigned char)p[3]) || !isxdigit((unsigned char)p[4]))
+                        return false;
+                    const unsigned code = strtoul(std::string(p + 1, 4).c_str(), nullptr, 16);
+                    if (code < 0x80)
+                        value += (char)code;
+                    else if (code < 0x800)
+                        value += {(char)(0xC0 | (code >> 6)), (char)(0x80 | (code & 0x3F))};
+                    else if (code >= 0xD800 && code <= 0xDFFF)
+                        value += '?';
+                    else
+                        value += {(char)(0xE0 | (code >> 12)), (char)(0x80 | ((code >> 6) & 0x3F)), (char)(0x80 | (code & 0x3F))};
+                    p += 4;
+                    break;
+                }
+                default:
+                    return false; // Like cJSON, an unknown escape fails the parse
+                }
+            }
+            else
+            {
+                value += *p;
+            }
+        }
+        if (p == end)
+            return false;
+        p++;
+        *out = strdup(value.c_str());
+        return true;
+    }
+
+    cJSON *value(int depth)
+    {
+        skip_whitespace();
+        if (p == end || depth > 1000)
+            return nullptr;
+        cJSON *item = static_cast<cJSON *>(calloc(1, sizeof(cJSON)));
+        bool ok = false;
+        if (*p == '{' || *p == '[')
+        {
+            const bool object = *p == '{';
+            item->type = object ? cJSON_Object : cJSON_Array;
+            p++;
+            skip_whitespace();
+            ok = true;
+            if (p < end && *p == (object ? '}' : ']'))
+            {
+                p++;
+            }
+            else
+            {
+                for (;;)
+                {
+                    char *name = nullptr;
+                    skip_whitespace();
+                    if (object && !(string(&name) && (skip_whitespace(), p < end && *p++ == ':')))
+                    {
+                        free(name);
+                        ok = false;
+                        break;
+                    }
+                    cJSON *child = value(depth + 1);
+                    if (!child)
+                    {
+                        free(name);
+                        ok = false;
+                        break;
+                    }
+                    child->string = name;
+                    cJSON_AddItemToArray(item, child);
+                    skip_whitespace();
+                    if (p < end && *p == ',')
+                    {
+                        p++;
+                        continue;
+                    }
+                    ok = p < end && *p++ == (object ? '}' : ']');
+                    break;
+                }
+            }
+        }
+        else if (*p == '"')
+        {
+            item->type = cJSON_String;
+            ok = string(&item->valuestring);
+        }
+        else if (end - p >= 4 && strncmp(p, "true", 4) == 0)
+        {
+            item->type = cJSON_True;
+            p += 4;
+            ok = true;
+        }
+        else if (end - p >= 5 && strncmp(p, "false", 5) == 0)
+        {
+            item->type = cJSON_False;
+            p += 5;
+            ok = true;
+        }
+        else if (end - p >= 4 && strncmp(p, "null", 4) == 0)
+        {
+            item->type = cJSON_NULL;
+            p += 4;
+            ok = true;
+        }
+        else if (*p == '-' || (*p >= '0' && *p <= '9'))
+        {
+            // cJSON copies the number into a terminated buffer for strtod
+            char number[64];
+            size_t length = 0;
+            while (p + length < end && length < sizeof(number) - 1 && strchr("0123456789+-.eE", p[length]) && p[length])
+                length++;
+            memcpy(number, p, length);
+            number[length] = '\0';
+            char *number_end;
+            item->type = cJSON_Number;
+            item->valuedouble = strtod(number, &number_end);
+            item->valueint = (int)item->valuedouble;
+            ok = number_end != number;
+            p += number_end - number;
+        }
+        if (!ok)
+        {
+            cJSON_Delete(item);
+            return nullptr;
+        }
+        return item;
+    }
+};
+} // namespace
+
+extern "C" {
+
+cJSON *cJSON_ParseWithLength(const char *value, size_t buffer_length)
+{
+    if (!value)
+        return nullptr;
+    parser state{value, value + buffer_length};
+    return state.value(0);
+}
+
+cJSON *cJSON_Parse(const char *value)
+{
+    return value ? cJSON_ParseWithLength(value, strlen(value)) : nullptr;
+}
+
+cJSON *cJSON_GetObjectItemCaseSensitive(const cJSON *object, const char *string)
+{
+    if (!object || !string)
+        return nullptr;
+    for (cJSON *child = object->child; child; child = child->next)
+    {
+        if (child->string && strcmp(child->string, string) == 0)
+            return child;
+    }
+    return nullptr;
+}
+
+cJSON_bool cJSON_IsString(const cJSON *item)
+{
+    return item && item->type == cJSON_String;
+}
+
+cJSON_bool cJSON_IsNumber(const cJSON *item)
+{
+    return item && item->type == cJSON_Number;
+}
+
+cJSON_bool cJSON_IsObject(const cJSON *item)
+{
+    return item && item->type == cJSON_Object;
+}
+}
@@ -0,0 +1,219 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "cJSON.h"
+
+static cJSON *new_item(int type)
+{
+    cJSON *item = static_cast<cJSON *>(calloc(1, sizeof(cJSON)));
+    item->type = type;
+    return item;
+}
+
+static void print_string(const char *value, std::string &out)
+{
+    out += '"';
+    for (const char *c = value; *c; c++)
+    {
+        switch (*c)
+        {
+        case '"':
+            out += "\\\"";
+            break;
+        case '\\':
+            out += "\\\\";
+            break;
+        case '\n':
+            out += "\\n";
+            break;
+        default:
+            if ((unsigned char)*c < 0x20)
+            {
+                char escaped[8];
+                snprintf(escaped, sizeof(escaped), "\\u%04x", *c);
+                out += escaped;
+            }
+            else
+            {
+                out += *c;
+            }
+        }
+    }
+    out += '"';
+}
+
+static void print_item(const cJSON *item, std::string &out)
+{
+    switch (item->type)
+    {
+    case cJSON_Object:
+    case cJSON_Array:
+    {
+        const bool object = item->type == cJSON_Object;
+        out += object ? '{' : '[';
+        for (const cJSON *child = item->child; child; child = child->next)
+        {
+            if (child != item->child)
+                out += ',';
+            if (object)
+            {
+                print_string(child->string, out);
+                out += ':';
+            }
+            print_item(child, out);
+        }
+        out += object ? '}' : ']';
+        break;
+    }
+    case cJSON_String:
+        print_string(item->valuestring, out);
+        break;
+    case cJSON_Number:
+    {
+        char number[32];
+        if (item->valuedouble == (double)(long long)item->valuedouble)
+            snprintf(number, sizeof(number), "%lld", (long long)item->valuedouble);
+        else
+            snprintf(number, sizeof(number), "%g", item->valuedouble);
+        out += number;
+        break;
+    }
+    case cJSON_True:
+        out += "true";
+        break;
+    case cJSON_False:
+        out += "false";
+        break;
+    default:
+        out += "null";
+        break;
+    }
+}
+
+extern "C" {
+
+cJSON *cJSON_CreateObject(void)
+{
+    return new_item(cJSON_Object);
+}
+
+cJSON *cJSON_CreateArray(void)
+{
+    return new_item(cJSON_Array);
+}
+
+cJSON *cJSON_CreateString(const char *string)
+{
+    cJSON *item = new_item(cJSON_String);
+    item->valuestring = strdup(string);
+    return item;
+}
+
+cJSON *cJSON_CreateNumber(double num)
+{
+    cJSON *item = new_item(cJSON_Number);
+    item->valuedouble = num;
+    item->valueint = (int)num;
+    return item;
+}
+
+cJSON *cJSON_CreateBool(cJSON_bool boolean)
+{
+    return new_item(boolean ? cJSON_True : cJSON_False);
+}
+
+cJSON *cJSON_CreateNull(void)
+{
+    return new_item(cJSON_NULL);
+}
+
+// Children form a list whose head's prev points at the tail, like cJSON
+cJSON_bool cJSON_AddItemToArray(cJSON *array, cJSON *item)
+{
+    if (!array || !item)
+        return 0;
+    if (!array->child)
+    {
+        array->child = item;
+        item->prev = item;
+    }
+    else
+    {
+        cJSON *tail = array->child->prev;
+        tail->next = item;
+        item->prev = tail;
+        array->child->prev = item;
+    }
+    return 1;
+}
+
+cJSON_bool cJSON_AddItemToObject(cJSON *object, const char *string, cJSON *item)
+{
+    if (!object || !string || !item)
+        return 0;
+    item->string = strdup(string);
+    return cJSON_AddItemToArray(object, item);
+}
+
+cJSON *cJSON_AddStringToObject(cJSON *object, const char *name, const char *string)
+{
+    cJSON *item = cJSON_CreateString(string);
+    cJSON_AddItemToObject(object, name, item);
+    return item;
+}
+
+cJSON *cJSON_AddNumberToObject(cJSON *object, const char *name, double number)
+{
+    cJSON *item = cJSON_CreateNumber(number);
+    cJSON_AddItemToObject(object, name, item);
+    return item;
+}
+
+cJSON *cJSON_AddBoolToObject(cJSON *object, const char *name, cJSON_bool boolean)
+{
+    cJSON *item = cJSON_CreateBool(boolean);
+    cJSON_AddItemToObject(object, name, item);
+    return item;
+}
+
+cJSON *cJSON_AddObjectToObject(cJSON *object, const char *name)
+{
+    cJSON *item = cJSON_CreateObject();
+    cJSON_AddItemToObject(object, name, item);
+    return item;
+}
+
+cJSON *cJSON_AddArrayToObject(cJSON *object, const char *name)
+{
+    cJSON *item = cJSON_CreateArray();
+    cJSON_AddItemToObject(object, name, item);
+    return item;
+}
+
+void cJSON_Delete(cJSON *item)
+{
+    while (item)
+    {
+        cJSON *next = item->next;
+        cJSON_Delete(item->child);
+        free(item->valuestring);
+        free(item->string);
+        free(item);
+        item = next;
+    }
+}
+
+void cJSON_free(void *object)
+{
+    free(object);
+}
+
+char *cJSON_PrintUnformatted(const cJSON *item)
+{
+    std::string out;
+    print_item(item, out);
+    return strdup(out.c_str());
+}
+}
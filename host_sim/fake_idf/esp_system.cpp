@@ -0,0 +1,295 @@
+#include <cstdarg>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "argtable3/argtable3.h"
+#include "ble_mesh_example_init.h"
+#include "esp_console.h"
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_system.h"
+#include "freertos/task.h"
+
+#include "sim_clock.h"
+#include "sim_host.h"
+
+static esp_log_level_t log_level = ESP_LOG_NONE;
+static std::map<std::string, esp_console_cmd_t> console_commands;
+
+extern "C" {
+
+void esp_log_level_set(const char *tag, esp_log_level_t level)
+{
+    if (strcmp(tag, "*") == 0)
+        log_level = level;
+}
+
+void esp_log_write(esp_log_level_t level, const char *tag, const char *format, ...)
+{
+    if (level > log_level)
+        return;
+
+    static const char letters[] = "NEWIDV";
+    printf("%c (%lld) %s: ", letters[level], (long long)(sim_now_us() / 1000), tag);
+    va_list args;
+    va_start(args, format);
+    vprintf(format, args);
+    va_end(args);
+    putchar('\n');
+}
+
+void esp_log_buffer_hex(const char *tag, const void *buffer, uint16_t len)
+{
+    esp_log_write(ESP_LOG_INFO, tag, "%s", bt_hex(buffer, len));
+}
+
+const char *esp_err_to_name(esp_err_t code)
+{
+    switch (code)
+    {
+    case ESP_OK:
+        return "ESP_OK";
+    case ESP_FAIL:
+        return "ESP_FAIL";
+    case ESP_ERR_NO_MEM:
+        return "ESP_ERR_NO_MEM";
+    case ESP_ERR_INVALID_ARG:
+        return "ESP_ERR_INVALID_ARG";
+    case ESP_ERR_INVALID_STATE:
+        return "ESP_ERR_INVALID_STATE";
+    case ESP_ERR_INVALID_SIZE:
+        return "ESP_ERR_INVALID_SIZE";
+    case ESP_ERR_NOT_FOUND:
+        return "ESP_ERR_NOT_FOUND";
+    case ESP_ERR_NOT_SUPPORTED:
+        return "ESP_ERR_NOT_SUPPORTED";
+    case ESP_ERR_TIMEOUT:
+        return "ESP_ERR_TIMEOUT";
+    case ESP_ERR_INVALID_VERSION:
+        return "ESP_ERR_INVALID_VERSION";
+    default:
+        return "UNKNOWN ERROR";
+    }
+}
+
+// The host heap is not what is being measured, report the DRAM an ESP32 has left after boot
+uint32_t esp_get_free_heap_size(void)
+{
+    return 160 * 1024;
+}
+
+uint32_t esp_get_minimum_free_heap_size(void)
+{
+    return 160 * 1024;
+}
+
+void esp_restart(void)
+{
+    fprintf(stderr, "esp_restart called at %lld ms\n", (long long)(sim_now_us() / 1000));
+    exit(1);
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    sim_run_until(sim_now_us() + (int64_t)ticks * 1000);
+}
+
+const char *bt_hex(const void *buf, size_t len)
+{
+    static const char hex[] = "0123456789abcdef";
+    static char str[4][129];
+    static int index;
+    char *out = str[index++ % 4];
+    const uint8_t *bytes = static_cast<const uint8_t *>(buf);
+
+    if (len > 64)
+        len = 64;
+    for (size_t i = 0; i < len; i++)
+    {
+        out[i * 2] = hex[bytes[i] >> 4];
+        out[i * 2 + 1] = hex[bytes[i] & 0xf];
+    }
+    out[len * 2] = '\0';
+    return out;
+}
+
+void ble_mesh_get_dev_uuid(uint8_t *dev_uuid)
+{
+    // Same layout as the example helper: the provisioner's BD address at the start
+    static const uint8_t uuid[16] = {0x24, 0x0a, 0xc4, 0x00, 0x00, 0x01};
+    memcpy(dev_uuid, uuid, sizeof(uuid));
+}
+
+esp_err_t esp_console_cmd_register(const esp_console_cmd_t *cmd)
+{
+    if (!cmd || !cmd->command || !cmd->func)
+        return ESP_ERR_INVALID_ARG;
+    console_commands[cmd->command] = *cmd;
+    return ESP_OK;
+}
+
+} // extern "C"
+
+// The arg_* functions keep their C linkage from argtable3.h
+static std::vector<std::unique_ptr<uint8_t[]>> arg_storage;
+
+template <typename T>
+static T *arg_alloc(arg_kind kind, const char *shortopts, const char *longopts, const char *datatype, const char *glossary, int mincount)
+{
+    arg_storage.emplace_back(new uint8_t[sizeof(T)]());
+    T *arg = reinterpret_cast<T *>(arg_storage.back().get());
+    arg->hdr = arg_hdr{kind, shortopts, longopts, datatype, glossary, mincount};
+    return arg;
+}
+
+static struct arg_int *arg_int_new(const char *shortopts, const char *longopts, const char *datatype, const char *glossary, int mincount)
+{
+    struct arg_int *arg = arg_alloc<struct arg_int>(ARG_KIND_INT, shortopts, longopts, datatype, glossary, mincount);
+    static int values[64];
+    static size_t used;
+    arg->ival = &values[used++ % 64];
+    return arg;
+}
+
+struct arg_int *arg_int0(const char *shortopts, const char *longopts, const char *datatype, const char *glossary)
+{
+    return arg_int_new(shortopts, longopts, datatype, glossary, 0);
+}
+
+struct arg_int *arg_int1(const char *shortopts, const char *longopts, const char *datatype, const char *glossary)
+{
+    return arg_int_new(shortopts, longopts, datatype, glossary, 1);
+}
+
+struct arg_str *arg_str1(const char *shortopts, const char *longopts, const char *datatype, const char *glossary)
+{
+    struct arg_str *arg = arg_alloc<struct arg_str>(ARG_KIND_STR, shortopts, longopts, datatype, glossary, 1);
+    static const char *values[64];
+    static size_t used;
+    arg->sval = &values[used++ % 64];
+    return arg;
+}
+
+struct arg_end *arg_end(int maxerrors)
+{
+    return arg_alloc<struct arg_end>(ARG_KIND_END, nullptr, nullptr, nullptr, nullptr, 0);
+}
+
+static bool arg_matches(const arg_hdr *hdr, const std::string &name, bool long_name)
+{
+    if (long_name)
+        return hdr->longopts && name == hdr->longopts;
+    return hdr->shortopts && name.size() == 1 && strchr(hdr->shortopts, name[0]);
+}
+
+int arg_parse(int argc, char **argv, void **argtable)
+{
+    std::vector<arg_hdr *> table;
+    struct arg_end *end = nullptr;
+    for (size_t i = 0; !end; i++)
+    {
+        arg_hdr *hdr = static_cast<arg_hdr *>(argtable[i]);
+        if (hdr->kind == ARG_KIND_END)
+            end = reinterpret_cast<struct arg_end *>(hdr);
+        else
+            table.push_back(hdr);
+    }
+    for (arg_hdr *hdr : table)
+    {
+        reinterpret_cast<struct arg_int *>(hdr)->count = 0;
+    }
+    end->count = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string option = argv[i];
+        const bool long_name = option.rfind("--", 0) == 0;
+        if (option.size() < 2 || option[0] != '-')
+        {
+            end->count++;
+            continue;
+        }
+        std::string name = option.substr(long_name ? 2 : 1);
+        std::string value;
+        if (const size_t equal = name.find('='); equal != std::string::npos)
+        {
+            value = name.substr(equal + 1);
+            name.resize(equal);
+        }
+        else if (i + 1 < argc)
+        {
+            value = argv[++i];
+        }
+
+        arg_hdr *match = nullptr;
+        for (arg_hdr *hdr : table)
+        {
+            if (arg_matches(hdr, name, long_name))
+                match = hdr;
+        }
+        if (!match)
+        {
+            end->count++;
+            continue;
+        }
+        if (match->kind == ARG_KIND_INT)
+        {
+            struct arg_int *arg = reinterpret_cast<struct arg_int *>(match);
+            arg->ival[0] = (int)strtol(value.c_str(), nullptr, 0);
+            arg->count = 1;
+        }
+        else
+        {
+            // Only one value per option, kept alive until the next parse
+            static std::string held[8];
+            static size_t next;
+            std::string &slot = held[next++ % 8];
+            slot = value;
+            struct arg_str *arg = reinterpret_cast<struct arg_str *>(match);
+            arg->sval[0] = slot.c_str();
+            arg->count = 1;
+        }
+    }
+
+    for (arg_hdr *hdr : table)
+    {
+        if (reinterpret_cast<struct arg_int *>(hdr)->count < hdr->mincount)
+            end->count++;
+    }
+    return end->count;
+}
+
+void arg_print_errors(FILE *fp, struct arg_end *end, const char *progname)
+{
+    fprintf(fp, "%s: %d invalid or missing argument(s)\n", progname, end->count);
+}
+
+esp_err_t sim_console_run(const std::string &line, int *ret)
+{
+    std::istringstream stream(line);
+    std::vector<std::string> words;
+    for (std::string word; stream >> word;)
+    {
+        words.push_back(word);
+    }
+    if (words.empty())
+        return ESP_ERR_INVALID_ARG;
+
+    auto command = console_commands.find(words[0]);
+    if (command == console_commands.end())
+        return ESP_ERR_NOT_FOUND;
+
+    std::vector<char *> argv;
+    for (std::string &word : words)
+    {
+        argv.push_back(word.data());
+    }
+    argv.push_back(nullptr);
+    *ret = command->second.func((int)words.size(), argv.data());
+    return ESP_OK;
+}
@@ -0,0 +1,157 @@
+#include "esp_timer.h"
+
+#include <memory>
+#include <queue>
+#include <vector>
+
+#include "sim_clock.h"
+
+namespace
+{
+struct sim_event
+{
+    int64_t at_us;
+    uint64_t sequence;
+    std::function<void()> fn;
+
+    bool operator>(const sim_event &other) const
+    {
+        return at_us != other.at_us ? at_us > other.at_us : sequence > other.sequence;
+    }
+};
+
+int64_t now_us = 0;
+uint64_t next_sequence = 0;
+std::priority_queue<sim_event, std::vector<sim_event>, std::greater<>> events;
+} // namespace
+
+int64_t sim_now_us()
+{
+    return now_us;
+}
+
+void sim_schedule(int64_t at_us, std::function<void()> fn)
+{
+    events.push(sim_event{at_us < now_us ? now_us : at_us, next_sequence++, std::move(fn)});
+}
+
+void sim_schedule_in(int64_t delay_us, std::function<void()> fn)
+{
+    sim_schedule(now_us + delay_us, std::move(fn));
+}
+
+void sim_run_until(int64_t at_us)
+{
+    while (!events.empty() && events.top().at_us <= at_us)
+    {
+        sim_event event = std::move(const_cast<sim_event &>(events.top()));
+        events.pop();
+        now_us = event.at_us;
+        event.fn();
+    }
+    if (at_us > now_us)
+        now_us = at_us;
+}
+
+size_t sim_pending_events()
+{
+    return events.size();
+}
+
+// esp_timer on top of the event queue. An armed timer owns one pending event, stopping or
+// re-arming bumps the generation so the stale event does nothing when it comes up.
+struct esp_timer
+{
+    esp_timer_cb_t callback;
+    void *arg;
+    const char *name;
+    uint64_t period_us = 0;
+    uint32_t generation = 0;
+    bool active = false;
+};
+
+static std::vector<std::unique_ptr<esp_timer>> timers;
+
+static void arm(esp_timer_handle_t timer, uint64_t timeout_us)
+{
+    timer->active = true;
+    const uint32_t generation = ++timer->generation;
+    sim_schedule_in(timeout_us, [timer, generation]()
+                    {
+        if (!timer->active || timer->generation != generation)
+            return;
+        if (timer->period_us)
+            arm(timer, timer->period_us);
+        else
+            timer->active = false;
+        timer->callback(timer->arg); });
+}
+
+extern "C" {
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *create_args, esp_timer_handle_t *out_handle)
+{
+    if (!create_args || !create_args->callback || !out_handle)
+        return ESP_ERR_INVALID_ARG;
+
+    timers.push_back(std::make_unique<esp_timer>(esp_timer{create_args->callback, create_args->arg, create_args->name}));
+    *out_handle = timers.back().get();
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us)
+{
+    if (timer->active)
+        return ESP_ERR_INVALID_STATE;
+    timer->period_us = 0;
+    arm(timer, timeout_us);
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period)
+{
+    if (timer->active)
+        return ESP_ERR_INVALID_STATE;
+    timer->period_us = period;
+    arm(timer, period);
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_restart(esp_timer_handle_t timer, uint64_t timeout_us)
+{
+    if (!timer->active)
+        return ESP_ERR_INVALID_STATE;
+    if (timer->period_us)
+        timer->period_us = timeout_us;
+    arm(timer, timeout_us);
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer)
+{
+    if (!timer->active)
+        return ESP_ERR_INVALID_STATE;
+    timer->active = false;
+    timer->generation++;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_delete(esp_timer_handle_t timer)
+{
+    // Kept allocated, a stale event may still point at it
+    if (timer->active)
+        return ESP_ERR_INVALID_STATE;
+    timer->generation++;
+    return ESP_OK;
+}
+
+int64_t esp_timer_get_time(void)
+{
+    return now_us;
+}
+
+bool esp_timer_is_active(esp_timer_handle_t timer)
+{
+    return timer->active;
+}
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include <stdio.h>
+
+// Subset of argtable3 used by the console commands: integer and string options given as
+// "-n 3", "--node 3" or "--node=3".
+enum arg_kind { ARG_KIND_INT, ARG_KIND_STR, ARG_KIND_END };
+
+struct arg_hdr {
+    enum arg_kind kind;
+    const char *shortopts;
+    const char *longopts;
+    const char *datatype;
+    const char *glossary;
+    int mincount;
+};
+struct arg_int { struct arg_hdr hdr; int count; int *ival; };
+struct arg_str { struct arg_hdr hdr; int count; const char **sval; };
+struct arg_end { struct arg_hdr hdr; int count; };
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+struct arg_int *arg_int0(const char *shortopts, const char *longopts, const char *datatype, const char *glossary);
+struct arg_int *arg_int1(const char *shortopts, const char *longopts, const char *datatype, const char *glossary);
+struct arg_str *arg_str1(const char *shortopts, const char *longopts, const char *datatype, const char *glossary);
+struct arg_end *arg_end(int maxerrors);
+int arg_parse(int argc, char **argv, void **argtable);
+void arg_print_errors(FILE *fp, struct arg_end *end, const char *progname);
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,13 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#ifdef __cplusplus
+extern "C" {
+#endif
+const char *bt_hex(const void *buf, size_t len);
+void ble_mesh_get_dev_uuid(uint8_t *dev_uuid);
+esp_err_t bluetooth_init(void);
+#ifdef __cplusplus
+}
+#endif
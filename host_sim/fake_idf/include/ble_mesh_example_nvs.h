@@ -0,0 +1,9 @@
+#pragma once
+#include "nvs_flash.h"
+#ifdef __cplusplus
+extern "C" {
+#endif
+esp_err_t ble_mesh_nvs_open(nvs_handle_t *handle);
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,48 @@
+#pragma once
+#include <stddef.h>
+// Building, printing and parsing subset of cJSON, what the mesh pipeline and the benches use
+#ifdef __cplusplus
+extern "C" {
+#endif
+#define cJSON_Invalid (0)
+#define cJSON_False  (1 << 0)
+#define cJSON_True   (1 << 1)
+#define cJSON_NULL   (1 << 2)
+#define cJSON_Number (1 << 3)
+#define cJSON_String (1 << 4)
+#define cJSON_Array  (1 << 5)
+#define cJSON_Object (1 << 6)
+typedef int cJSON_bool;
+typedef struct cJSON {
+    struct cJSON *next, *prev, *child;
+    int type;
+    char *valuestring;
+    int valueint;
+    double valuedouble;
+    char *string;
+} cJSON;
+char *cJSON_PrintUnformatted(const cJSON *item);
+void cJSON_Delete(cJSON *item);
+void cJSON_free(void *object);
+cJSON *cJSON_CreateObject(void);
+cJSON *cJSON_CreateArray(void);
+cJSON *cJSON_CreateString(const char *string);
+cJSON *cJSON_CreateNumber(double num);
+cJSON *cJSON_CreateBool(cJSON_bool boolean);
+cJSON *cJSON_CreateNull(void);
+cJSON_bool cJSON_AddItemToObject(cJSON *object, const char *string, cJSON *item);
+cJSON_bool cJSON_AddItemToArray(cJSON *array, cJSON *item);
+cJSON *cJSON_AddStringToObject(cJSON *object, const char *name, const char *string);
+cJSON *cJSON_AddNumberToObject(cJSON *object, const char *name, double number);
+cJSON *cJSON_AddBoolToObject(cJSON *object, const char *name, cJSON_bool boolean);
+cJSON *cJSON_AddObjectToObject(cJSON *object, const char *name);
+cJSON *cJSON_AddArrayToObject(cJSON *object, const char *name);
+cJSON *cJSON_Parse(const char *value);
+cJSON *cJSON_ParseWithLength(const char *value, size_t buffer_length);
+cJSON *cJSON_GetObjectItemCaseSensitive(const cJSON *object, const char *string);
+cJSON_bool cJSON_IsString(const cJSON *item);
+cJSON_bool cJSON_IsNumber(const cJSON *item);
+cJSON_bool cJSON_IsObject(const cJSON *item);
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,9 @@
+#pragma once
+#include "esp_ble_mesh_defs.h"
+#ifdef __cplusplus
+extern "C" {
+#endif
+esp_err_t esp_ble_mesh_init(esp_ble_mesh_prov_t *prov, esp_ble_mesh_comp_t *comp);
+#ifdef __cplusplus
+}
+#endif
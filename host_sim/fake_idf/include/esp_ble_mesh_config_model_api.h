@@ -0,0 +1,35 @@
+#pragma once
+#include "esp_ble_mesh_defs.h"
+typedef union {
+    struct { uint8_t page; } comp_data_get;
+} esp_ble_mesh_cfg_client_get_state_t;
+typedef union {
+    struct { uint16_t net_idx; uint16_t app_idx; uint8_t app_key[16]; } app_key_add;
+    struct { uint16_t element_addr; uint16_t model_app_idx; uint16_t model_id; uint16_t company_id; } model_app_bind;
+} esp_ble_mesh_cfg_client_set_state_t;
+typedef struct { uint8_t page; struct net_buf_simple *composition_data; } esp_ble_mesh_cfg_comp_data_status_cb_t;
+typedef union {
+    esp_ble_mesh_cfg_comp_data_status_cb_t comp_data_status;
+} esp_ble_mesh_cfg_client_common_cb_param_t;
+typedef struct {
+    int error_code;
+    esp_ble_mesh_client_common_param_t *params;
+    esp_ble_mesh_cfg_client_common_cb_param_t status_cb;
+} esp_ble_mesh_cfg_client_cb_param_t;
+typedef enum {
+    ESP_BLE_MESH_CFG_CLIENT_GET_STATE_EVT,
+    ESP_BLE_MESH_CFG_CLIENT_SET_STATE_EVT,
+    ESP_BLE_MESH_CFG_CLIENT_PUBLISH_EVT,
+    ESP_BLE_MESH_CFG_CLIENT_TIMEOUT_EVT,
+    ESP_BLE_MESH_CFG_CLIENT_EVT_MAX,
+} esp_ble_mesh_cfg_client_cb_event_t;
+typedef void (*esp_ble_mesh_cfg_client_cb_t)(esp_ble_mesh_cfg_client_cb_event_t event, esp_ble_mesh_cfg_client_cb_param_t *param);
+#ifdef __cplusplus
+extern "C" {
+#endif
+esp_err_t esp_ble_mesh_register_config_client_callback(esp_ble_mesh_cfg_client_cb_t callback);
+esp_err_t esp_ble_mesh_config_client_get_state(esp_ble_mesh_client_common_param_t *params, esp_ble_mesh_cfg_client_get_state_t *get_state);
+esp_err_t esp_ble_mesh_config_client_set_state(esp_ble_mesh_client_common_param_t *params, esp_ble_mesh_cfg_client_set_state_t *set_state);
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,253 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+#define BD_ADDR_LEN 6
+#ifndef ARRAY_SIZE
+#define ARRAY_SIZE(a) (sizeof(a) / sizeof((a)[0]))
+#endif
+
+typedef uint8_t esp_ble_mesh_bd_addr_t[BD_ADDR_LEN];
+typedef uint8_t esp_ble_mesh_octet16_t[16];
+
+#define ESP_BLE_MESH_ADDR_UNASSIGNED 0x0000
+#define ESP_BLE_MESH_ADDR_ALL_NODES 0xFFFF
+#define ESP_BLE_MESH_ADDR_IS_UNICAST(addr) ((addr) && (addr) < 0x8000)
+#define ESP_BLE_MESH_KEY_UNUSED 0xFFFF
+#define ESP_BLE_MESH_KEY_PRIMARY 0x0000
+#define ESP_BLE_MESH_CID_NVAL 0xFFFF
+
+#define ESP_BLE_MESH_TRANSMIT(count, int_ms) ((count) | (((int_ms / 10) - 1) << 3))
+#define ESP_BLE_MESH_RELAY_DISABLED 0x00
+#define ESP_BLE_MESH_BEACON_ENABLED 0x01
+#define ESP_BLE_MESH_GATT_PROXY_ENABLED 0x01
+#define ESP_BLE_MESH_GATT_PROXY_NOT_SUPPORTED 0x02
+#define ESP_BLE_MESH_FRIEND_ENABLED 0x01
+#define ESP_BLE_MESH_FRIEND_NOT_SUPPORTED 0x02
+
+/* Model IDs */
+#define ESP_BLE_MESH_MODEL_ID_CONFIG_SRV 0x0000
+#define ESP_BLE_MESH_MODEL_ID_CONFIG_CLI 0x0001
+#define ESP_BLE_MESH_MODEL_ID_GEN_ONOFF_SRV 0x1000
+#define ESP_BLE_MESH_MODEL_ID_GEN_ONOFF_CLI 0x1001
+#define ESP_BLE_MESH_MODEL_ID_GEN_LEVEL_SRV 0x1002
+#define ESP_BLE_MESH_MODEL_ID_GEN_LEVEL_CLI 0x1003
+#define ESP_BLE_MESH_MODEL_ID_LIGHT_LIGHTNESS_SRV 0x1300
+#define ESP_BLE_MESH_MODEL_ID_LIGHT_LIGHTNESS_CLI 0x1302
+#define ESP_BLE_MESH_MODEL_ID_LIGHT_CTL_SRV 0x1303
+#define ESP_BLE_MESH_MODEL_ID_LIGHT_CTL_CLI 0x1305
+#define ESP_BLE_MESH_MODEL_ID_LIGHT_CTL_TEMP_SRV 0x1306
+#define ESP_BLE_MESH_MODEL_ID_LIGHT_HSL_SRV 0x1307
+#define ESP_BLE_MESH_MODEL_ID_LIGHT_HSL_CLI 0x1309
+
+/* Opcodes */
+#define ESP_BLE_MESH_MODEL_OP_1(b0) (b0)
+#define ESP_BLE_MESH_MODEL_OP_2(b0, b1) (((b0) << 8) | (b1))
+#define ESP_BLE_MESH_MODEL_OP_APP_KEY_ADD ESP_BLE_MESH_MODEL_OP_1(0x00)
+#define ESP_BLE_MESH_MODEL_OP_COMPOSITION_DATA_STATUS ESP_BLE_MESH_MODEL_OP_1(0x02)
+#define ESP_BLE_MESH_MODEL_OP_APP_KEY_STATUS ESP_BLE_MESH_MODEL_OP_2(0x80, 0x03)
+#define ESP_BLE_MESH_MODEL_OP_COMPOSITION_DATA_GET ESP_BLE_MESH_MODEL_OP_2(0x80, 0x08)
+#define ESP_BLE_MESH_MODEL_OP_MODEL_APP_BIND ESP_BLE_MESH_MODEL_OP_2(0x80, 0x3D)
+#define ESP_BLE_MESH_MODEL_OP_NODE_RESET ESP_BLE_MESH_MODEL_OP_2(0x80, 0x49)
+#define ESP_BLE_MESH_MODEL_OP_GEN_ONOFF_GET ESP_BLE_MESH_MODEL_OP_2(0x82, 0x01)
+#define ESP_BLE_MESH_MODEL_OP_GEN_ONOFF_SET ESP_BLE_MESH_MODEL_OP_2(0x82, 0x02)
+#define ESP_BLE_MESH_MODEL_OP_GEN_ONOFF_SET_UNACK ESP_BLE_MESH_MODEL_OP_2(0x82, 0x03)
+#define ESP_BLE_MESH_MODEL_OP_GEN_ONOFF_STATUS ESP_BLE_MESH_MODEL_OP_2(0x82, 0x04)
+#define ESP_BLE_MESH_MODEL_OP_GEN_LEVEL_GET ESP_BLE_MESH_MODEL_OP_2(0x82, 0x05)
+#define ESP_BLE_MESH_MODEL_OP_GEN_LEVEL_SET ESP_BLE_MESH_MODEL_OP_2(0x82, 0x06)
+#define ESP_BLE_MESH_MODEL_OP_LIGHT_LIGHTNESS_GET ESP_BLE_MESH_MODEL_OP_2(0x82, 0x4B)
+#define ESP_BLE_MESH_MODEL_OP_LIGHT_LIGHTNESS_SET ESP_BLE_MESH_MODEL_OP_2(0x82, 0x4C)
+#define ESP_BLE_MESH_MODEL_OP_LIGHT_LIGHTNESS_STATUS ESP_BLE_MESH_MODEL_OP_2(0x82, 0x4E)
+#define ESP_BLE_MESH_MODEL_OP_LIGHT_LIGHTNESS_RANGE_GET ESP_BLE_MESH_MODEL_OP_2(0x82, 0x57)
+#define ESP_BLE_MESH_MODEL_OP_LIGHT_CTL_GET ESP_BLE_MESH_MODEL_OP_2(0x82, 0x5D)
+#define ESP_BLE_MESH_MODEL_OP_LIGHT_CTL_SET ESP_BLE_MESH_MODEL_OP_2(0x82, 0x5E)
+#define ESP_BLE_MESH_MODEL_OP_LIGHT_CTL_STATUS ESP_BLE_MESH_MODEL_OP_2(0x82, 0x60)
+#define ESP_BLE_MESH_MODEL_OP_LIGHT_CTL_TEMPERATURE_GET ESP_BLE_MESH_MODEL_OP_2(0x82, 0x61)
+#define ESP_BLE_MESH_MODEL_OP_LIGHT_CTL_TEMPERATURE_RANGE_GET ESP_BLE_MESH_MODEL_OP_2(0x82, 0x62)
+#define ESP_BLE_MESH_MODEL_OP_LIGHT_CTL_TEMPERATURE_STATUS ESP_BLE_MESH_MODEL_OP_2(0x82, 0x66)
+#define ESP_BLE_MESH_MODEL_OP_LIGHT_CTL_TEMPERATURE_SET ESP_BLE_MESH_MODEL_OP_2(0x82, 0x64)
+#define ESP_BLE_MESH_MODEL_OP_LIGHT_CTL_TEMPERATURE_SET_UNACK ESP_BLE_MESH_MODEL_OP_2(0x82, 0x65)
+#define ESP_BLE_MESH_MODEL_OP_LIGHT_HSL_GET ESP_BLE_MESH_MODEL_OP_2(0x82, 0x6D)
+#define ESP_BLE_MESH_MODEL_OP_LIGHT_HSL_STATUS ESP_BLE_MESH_MODEL_OP_2(0x82, 0x78)
+#define ESP_BLE_MESH_MODEL_OP_LIGHT_HSL_SET ESP_BLE_MESH_MODEL_OP_2(0x82, 0x76)
+#define ESP_BLE_MESH_MODEL_OP_LIGHT_HSL_RANGE_GET ESP_BLE_MESH_MODEL_OP_2(0x82, 0x77)
+
+struct net_buf_simple {
+    uint8_t *data;
+    uint16_t len;
+    uint16_t size;
+    uint8_t *__buf;
+};
+
+typedef struct {
+    uint16_t net_idx;
+    uint16_t app_idx;
+    uint16_t addr;
+    uint16_t recv_dst;
+    int8_t recv_rssi;
+    uint8_t recv_ttl;
+    uint32_t recv_op;
+    uint8_t send_rel : 1;
+    uint8_t send_ttl;
+} esp_ble_mesh_msg_ctx_t;
+
+typedef struct esp_ble_mesh_model esp_ble_mesh_model_t;
+struct esp_ble_mesh_model {
+    uint16_t model_id;
+    void *pub;
+    void *user_data;
+    struct esp_ble_mesh_elem *element;
+};
+
+typedef struct esp_ble_mesh_elem {
+    uint16_t element_addr;
+    uint16_t location;
+    uint8_t sig_model_count;
+    uint8_t vnd_model_count;
+    esp_ble_mesh_model_t *sig_models;
+    esp_ble_mesh_model_t *vnd_models;
+} esp_ble_mesh_elem_t;
+
+#define ESP_BLE_MESH_MODEL_NONE ((esp_ble_mesh_model_t *)0)
+#define ESP_BLE_MESH_ELEMENT(_loc, _mods, _vnd_mods)          \
+    {                                                         \
+        0, (_loc), (uint8_t)ARRAY_SIZE(_mods), 0, (_mods), NULL \
+    }
+#define ESP_BLE_MESH_SIG_MODEL_(_id, _pub, _user_data) { (uint16_t)(_id), (void *)(_pub), (void *)(_user_data), NULL }
+#define ESP_BLE_MESH_MODEL_CFG_SRV(srv_data) ESP_BLE_MESH_SIG_MODEL_(ESP_BLE_MESH_MODEL_ID_CONFIG_SRV, NULL, srv_data)
+#define ESP_BLE_MESH_MODEL_CFG_CLI(cli_data) ESP_BLE_MESH_SIG_MODEL_(ESP_BLE_MESH_MODEL_ID_CONFIG_CLI, NULL, cli_data)
+#define ESP_BLE_MESH_MODEL_GEN_ONOFF_CLI(cli_pub, cli_data) ESP_BLE_MESH_SIG_MODEL_(ESP_BLE_MESH_MODEL_ID_GEN_ONOFF_CLI, cli_pub, cli_data)
+#define ESP_BLE_MESH_MODEL_GEN_LEVEL_CLI(cli_pub, cli_data) ESP_BLE_MESH_SIG_MODEL_(ESP_BLE_MESH_MODEL_ID_GEN_LEVEL_CLI, cli_pub, cli_data)
+#define ESP_BLE_MESH_MODEL_LIGHT_LIGHTNESS_CLI(cli_pub, cli_data) ESP_BLE_MESH_SIG_MODEL_(ESP_BLE_MESH_MODEL_ID_LIGHT_LIGHTNESS_CLI, cli_pub, cli_data)
+#define ESP_BLE_MESH_MODEL_LIGHT_CTL_CLI(cli_pub, cli_data) ESP_BLE_MESH_SIG_MODEL_(ESP_BLE_MESH_MODEL_ID_LIGHT_CTL_CLI, cli_pub, cli_data)
+#define ESP_BLE_MESH_MODEL_LIGHT_HSL_CLI(cli_pub, cli_data) ESP_BLE_MESH_SIG_MODEL_(ESP_BLE_MESH_MODEL_ID_LIGHT_HSL_CLI, cli_pub, cli_data)
+
+typedef struct {
+    uint16_t cid;
+    uint16_t pid;
+    uint16_t vid;
+    size_t element_count;
+    esp_ble_mesh_elem_t *elements;
+} esp_ble_mesh_comp_t;
+
+typedef struct {
+    uint8_t net_transmit;
+    uint8_t relay;
+    uint8_t relay_retransmit;
+    uint8_t beacon;
+    uint8_t gatt_proxy;
+    uint8_t friend_state;
+    uint8_t default_ttl;
+} esp_ble_mesh_cfg_srv_t;
+
+typedef struct {
+    esp_ble_mesh_model_t *model;
+    void *op_pair;
+    uint32_t op_pair_size;
+    void *internal_data;
+} esp_ble_mesh_client_t;
+
+typedef struct {
+    const uint8_t *uuid;
+    const uint8_t *prov_uuid;
+    uint16_t prov_unicast_addr;
+    uint16_t prov_start_address;
+    uint8_t prov_attention;
+    uint8_t prov_algorithm;
+    uint8_t prov_pub_key_oob;
+    const uint8_t *prov_static_oob_val;
+    uint8_t prov_static_oob_len;
+    uint8_t flags;
+    uint32_t iv_index;
+} esp_ble_mesh_prov_t;
+
+typedef enum { ROLE_NODE = 0, ROLE_PROVISIONER, ROLE_FAST_PROV } esp_ble_mesh_dev_role_t;
+
+typedef struct {
+    uint32_t opcode;
+    esp_ble_mesh_model_t *model;
+    esp_ble_mesh_msg_ctx_t ctx;
+    int32_t msg_timeout;
+    uint8_t msg_role;
+} esp_ble_mesh_client_common_param_t;
+
+typedef enum { BLE_MESH_ADDR_PUBLIC, BLE_MESH_ADDR_RANDOM } esp_ble_mesh_addr_type_t;
+typedef enum { ESP_BLE_MESH_PROV_ADV = 1 << 0, ESP_BLE_MESH_PROV_GATT = 1 << 1 } esp_ble_mesh_prov_bearer_t;
+
+typedef struct {
+    esp_ble_mesh_bd_addr_t addr;
+    esp_ble_mesh_addr_type_t addr_type;
+    uint8_t dev_uuid[16];
+    uint16_t oob_info;
+    uint16_t unicast_addr;
+    uint8_t element_num;
+    uint16_t net_idx;
+    uint8_t flags;
+    uint32_t iv_index;
+    uint8_t dev_key[16];
+    char name[32];
+    uint16_t comp_length;
+    uint8_t *comp_data;
+} esp_ble_mesh_node_t;
+
+typedef struct {
+    esp_ble_mesh_bd_addr_t addr;
+    esp_ble_mesh_addr_type_t addr_type;
+    uint8_t uuid[16];
+    uint16_t oob_info;
+    esp_ble_mesh_prov_bearer_t bearer;
+} esp_ble_mesh_unprov_dev_add_t;
+
+typedef uint8_t esp_ble_mesh_dev_add_flag_t;
+#define ADD_DEV_RM_AFTER_PROV_FLAG BIT(0)
+#define ADD_DEV_START_PROV_NOW_FLAG BIT(1)
+#define ADD_DEV_FLUSHABLE_DEV_FLAG BIT(2)
+
+typedef enum {
+    ESP_BLE_MESH_PROV_REGISTER_COMP_EVT,
+    ESP_BLE_MESH_PROVISIONER_PROV_ENABLE_COMP_EVT,
+    ESP_BLE_MESH_PROVISIONER_PROV_DISABLE_COMP_EVT,
+    ESP_BLE_MESH_PROVISIONER_RECV_UNPROV_ADV_PKT_EVT,
+    ESP_BLE_MESH_PROVISIONER_PROV_LINK_OPEN_EVT,
+    ESP_BLE_MESH_PROVISIONER_PROV_LINK_CLOSE_EVT,
+    ESP_BLE_MESH_PROVISIONER_PROV_COMPLETE_EVT,
+    ESP_BLE_MESH_PROVISIONER_ADD_UNPROV_DEV_COMP_EVT,
+    ESP_BLE_MESH_PROVISIONER_SET_DEV_UUID_MATCH_COMP_EVT,
+    ESP_BLE_MESH_PROVISIONER_SET_NODE_NAME_COMP_EVT,
+    ESP_BLE_MESH_PROVISIONER_ADD_LOCAL_APP_KEY_COMP_EVT,
+    ESP_BLE_MESH_PROVISIONER_BIND_APP_KEY_TO_MODEL_COMP_EVT,
+    ESP_BLE_MESH_PROV_EVT_MAX,
+} esp_ble_mesh_prov_cb_event_t;
+
+typedef union {
+    struct ble_mesh_prov_register_comp_param { int err_code; } prov_register_comp;
+    struct ble_mesh_provisioner_prov_enable_comp_param { int err_code; } provisioner_prov_enable_comp;
+    struct ble_mesh_provisioner_prov_disable_comp_param { int err_code; } provisioner_prov_disable_comp;
+    struct ble_mesh_provisioner_recv_unprov_adv_pkt_param {
+        uint8_t dev_uuid[16];
+        esp_ble_mesh_bd_addr_t addr;
+        esp_ble_mesh_addr_type_t addr_type;
+        uint16_t oob_info;
+        uint8_t adv_type;
+        esp_ble_mesh_prov_bearer_t bearer;
+        int8_t rssi;
+    } provisioner_recv_unprov_adv_pkt;
+    struct ble_mesh_provisioner_link_open_evt_param { esp_ble_mesh_prov_bearer_t bearer; } provisioner_prov_link_open;
+    struct ble_mesh_provisioner_link_close_evt_param { esp_ble_mesh_prov_bearer_t bearer; uint8_t reason; } provisioner_prov_link_close;
+    struct ble_mesh_provisioner_prov_comp_param {
+        uint16_t node_idx;
+        esp_ble_mesh_octet16_t device_uuid;
+        uint16_t unicast_addr;
+        uint8_t element_num;
+        uint16_t netkey_idx;
+    } provisioner_prov_complete;
+    struct ble_mesh_provisioner_add_unprov_dev_comp_param { int err_code; } provisioner_add_unprov_dev_comp;
+    struct ble_mesh_provisioner_set_dev_uuid_match_comp_param { int err_code; } provisioner_set_dev_uuid_match_comp;
+    struct ble_mesh_provisioner_set_node_name_comp_param { int err_code; uint16_t node_index; } provisioner_set_node_name_comp;
+    struct ble_mesh_provisioner_add_local_app_key_comp_param { int err_code; uint16_t net_idx; uint16_t app_idx; } provisioner_add_app_key_comp;
+    struct ble_mesh_provisioner_bind_local_mod_app_comp_param { int err_code; } provisioner_bind_app_key_to_model_comp;
+} esp_ble_mesh_prov_cb_param_t;
+
+typedef void (*esp_ble_mesh_prov_cb_t)(esp_ble_mesh_prov_cb_event_t event, esp_ble_mesh_prov_cb_param_t *param);
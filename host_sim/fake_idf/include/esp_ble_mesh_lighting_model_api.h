@@ -0,0 +1,42 @@
+#pragma once
+#include "esp_ble_mesh_defs.h"
+typedef union {
+    struct { uint8_t dummy; } dummy_get;
+} esp_ble_mesh_light_client_get_state_t;
+typedef union {
+    struct { bool op_en; uint16_t lightness; uint8_t tid; uint8_t trans_time; uint8_t delay; } lightness_set;
+    struct { bool op_en; uint16_t ctl_lightness; uint16_t ctl_temperature; int16_t ctl_delta_uv; uint8_t tid; uint8_t trans_time; uint8_t delay; } ctl_set;
+    struct { bool op_en; uint16_t ctl_temperature; int16_t ctl_delta_uv; uint8_t tid; uint8_t trans_time; uint8_t delay; } ctl_temperature_set;
+    struct { bool op_en; uint16_t hsl_lightness; uint16_t hsl_hue; uint16_t hsl_saturation; uint8_t tid; uint8_t trans_time; uint8_t delay; } hsl_set;
+} esp_ble_mesh_light_client_set_state_t;
+typedef union {
+    struct { bool op_en; uint16_t present_lightness; uint16_t target_lightness; uint8_t remain_time; } lightness_status;
+    struct { uint8_t status_code; uint16_t range_min; uint16_t range_max; } lightness_range_status;
+    struct { bool op_en; uint16_t present_ctl_lightness; uint16_t present_ctl_temperature; uint16_t target_ctl_lightness; uint16_t target_ctl_temperature; uint8_t remain_time; } ctl_status;
+    struct { bool op_en; uint16_t present_ctl_temperature; int16_t present_ctl_delta_uv; uint16_t target_ctl_temperature; int16_t target_ctl_delta_uv; uint8_t remain_time; } ctl_temperature_status;
+    struct { uint8_t status_code; uint16_t range_min; uint16_t range_max; } ctl_temperature_range_status;
+    struct { bool op_en; uint16_t hsl_lightness; uint16_t hsl_hue; uint16_t hsl_saturation; uint8_t remain_time; } hsl_status;
+    struct { uint8_t status_code; uint16_t hue_range_min; uint16_t hue_range_max; uint16_t saturation_range_min; uint16_t saturation_range_max; } hsl_range_status;
+} esp_ble_mesh_light_client_status_cb_t;
+typedef struct {
+    int error_code;
+    esp_ble_mesh_client_common_param_t *params;
+    esp_ble_mesh_light_client_status_cb_t status_cb;
+} esp_ble_mesh_light_client_cb_param_t;
+typedef enum {
+    ESP_BLE_MESH_LIGHT_CLIENT_GET_STATE_EVT,
+    ESP_BLE_MESH_LIGHT_CLIENT_SET_STATE_EVT,
+    ESP_BLE_MESH_LIGHT_CLIENT_PUBLISH_EVT,
+    ESP_BLE_MESH_LIGHT_CLIENT_TIMEOUT_EVT,
+    ESP_BLE_MESH_LIGHT_CLIENT_EVT_MAX,
+} esp_ble_mesh_light_client_cb_event_t;
+typedef void (*esp_ble_mesh_light_client_cb_t)(esp_ble_mesh_light_client_cb_event_t event, esp_ble_mesh_light_client_cb_param_t *param);
+#ifdef __cplusplus
+extern "C" {
+#endif
+esp_err_t esp_ble_mesh_register_light_client_callback(esp_ble_mesh_light_client_cb_t callback);
+esp_err_t esp_ble_mesh_light_client_get_state(esp_ble_mesh_client_common_param_t *params, esp_ble_mesh_light_client_get_state_t *get_state);
+esp_err_t esp_ble_mesh_light_client_set_state(esp_ble_mesh_client_common_param_t *params, esp_ble_mesh_light_client_set_state_t *set_state);
+#ifdef __cplusplus
+}
+#endif
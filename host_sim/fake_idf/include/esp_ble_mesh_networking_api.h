@@ -0,0 +1,2 @@
+#pragma once
+#include "esp_ble_mesh_defs.h"
@@ -0,0 +1,21 @@
+#pragma once
+#include "esp_ble_mesh_defs.h"
+#ifdef __cplusplus
+extern "C" {
+#endif
+esp_err_t esp_ble_mesh_register_prov_callback(esp_ble_mesh_prov_cb_t callback);
+esp_err_t esp_ble_mesh_provisioner_prov_enable(esp_ble_mesh_prov_bearer_t bearers);
+esp_err_t esp_ble_mesh_provisioner_prov_disable(esp_ble_mesh_prov_bearer_t bearers);
+esp_err_t esp_ble_mesh_provisioner_add_unprov_dev(esp_ble_mesh_unprov_dev_add_t *add_dev, esp_ble_mesh_dev_add_flag_t flags);
+esp_err_t esp_ble_mesh_provisioner_set_node_name(uint16_t index, const char *name);
+const char *esp_ble_mesh_provisioner_get_node_name(uint16_t index);
+esp_ble_mesh_node_t *esp_ble_mesh_provisioner_get_node_with_uuid(const uint8_t uuid[16]);
+esp_ble_mesh_node_t *esp_ble_mesh_provisioner_get_node_with_addr(uint16_t unicast_addr);
+esp_ble_mesh_node_t **esp_ble_mesh_provisioner_get_node_table_entry(void);
+uint16_t esp_ble_mesh_provisioner_get_prov_node_count(void);
+esp_err_t esp_ble_mesh_provisioner_delete_node_with_uuid(const uint8_t uuid[16]);
+esp_err_t esp_ble_mesh_provisioner_add_local_app_key(const uint8_t app_key[16], uint16_t net_idx, uint16_t app_idx);
+esp_err_t esp_ble_mesh_provisioner_bind_app_key_to_local_model(uint16_t element_addr, uint16_t app_idx, uint16_t model_id, uint16_t company_id);
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,152 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "esp_event.h"
+typedef struct esp_mqtt_client *esp_mqtt_client_handle_t;
+typedef enum {
+    MQTT_EVENT_ANY = -1,
+    MQTT_EVENT_ERROR = 0,
+    MQTT_EVENT_CONNECTED,
+    MQTT_EVENT_DISCONNECTED,
+    MQTT_EVENT_SUBSCRIBED,
+    MQTT_EVENT_UNSUBSCRIBED,
+    MQTT_EVENT_PUBLISHED,
+    MQTT_EVENT_DATA,
+    MQTT_EVENT_BEFORE_CONNECT,
+    MQTT_EVENT_DELETED,
+} esp_mqtt_event_id_t;
+typedef enum { MQTT_ERROR_TYPE_NONE = 0, MQTT_ERROR_TYPE_TCP_TRANSPORT, MQTT_ERROR_TYPE_CONNECTION_REFUSED } esp_mqtt_error_type_t;
+typedef enum { MQTT_TRANSPORT_UNKNOWN = 0, MQTT_TRANSPORT_OVER_TCP } esp_mqtt_transport_t;
+typedef enum { MQTT_PROTOCOL_UNDEFINED = 0, MQTT_PROTOCOL_V_3_1, MQTT_PROTOCOL_V_3_1_1, MQTT_PROTOCOL_V_5 } esp_mqtt_protocol_ver_t;
+typedef struct {
+    esp_err_t esp_tls_last_esp_err;
+    int esp_tls_stack_err;
+    int esp_tls_cert_verify_flags;
+    esp_mqtt_error_type_t error_type;
+    int connect_return_code;
+    int esp_transport_sock_errno;
+} esp_mqtt_error_codes_t;
+typedef struct esp_mqtt_event {
+    esp_mqtt_event_id_t event_id;
+    esp_mqtt_client_handle_t client;
+    char *data;
+    int data_len;
+    int total_data_len;
+    int current_data_offset;
+    char *topic;
+    int topic_len;
+    int msg_id;
+    int session_present;
+    esp_mqtt_error_codes_t *error_handle;
+    bool retain;
+    int qos;
+    bool dup;
+} esp_mqtt_event_t;
+typedef esp_mqtt_event_t *esp_mqtt_event_handle_t;
+typedef struct mqtt5_user_property_list_t *mqtt5_user_property_handle_t;
+typedef struct {
+    bool payload_format_indicator;
+    uint32_t message_expiry_interval;
+    uint16_t topic_alias;
+    const char *response_topic;
+    const char *correlation_data;
+    uint16_t correlation_data_len;
+    const char *content_type;
+    mqtt5_user_property_handle_t user_property;
+} esp_mqtt5_publish_property_config_t;
+typedef struct {
+    uint16_t subscribe_id;
+    bool no_local_flag;
+    bool retain_as_published_flag;
+    uint8_t retain_handle;
+    bool is_share_subscribe;
+    const char *share_name;
+    mqtt5_user_property_handle_t user_property;
+} esp_mqtt5_subscribe_property_config_t;
+typedef struct {
+    bool is_share_subscribe;
+    const char *share_name;
+    mqtt5_user_property_handle_t user_property;
+} esp_mqtt5_unsubscribe_property_config_t;
+typedef struct {
+    uint32_t session_expiry_interval;
+    uint8_t disconnect_reason;
+    mqtt5_user_property_handle_t user_property;
+} esp_mqtt5_disconnect_property_config_t;
+typedef struct {
+    uint32_t session_expiry_interval;
+    uint32_t maximum_packet_size;
+    uint16_t receive_maximum;
+    uint16_t topic_alias_maximum;
+    bool request_resp_info;
+    bool request_problem_info;
+    mqtt5_user_property_handle_t user_property;
+    uint32_t will_delay_interval;
+    uint32_t message_expiry_interval;
+    bool payload_format_indicator;
+    const char *content_type;
+    const char *response_topic;
+    const char *correlation_data;
+    uint16_t correlation_data_len;
+    mqtt5_user_property_handle_t will_user_property;
+} esp_mqtt5_connection_property_config_t;
+typedef struct {
+    struct {
+        struct {
+            const char *uri;
+            const char *hostname;
+            esp_mqtt_transport_t transport;
+            const char *path;
+            uint32_t port;
+        } address;
+    } broker;
+    struct {
+        const char *username;
+        const char *client_id;
+        bool set_null_client_id;
+        struct {
+            const char *password;
+        } authentication;
+    } credentials;
+    struct {
+        struct {
+            const char *topic;
+            const char *msg;
+            int msg_len;
+            int qos;
+            int retain;
+        } last_will;
+        bool disable_clean_session;
+        int keepalive;
+        bool disable_keepalive;
+        esp_mqtt_protocol_ver_t protocol_ver;
+    } session;
+    struct {
+        int reconnect_timeout_ms;
+        int timeout_ms;
+        int refresh_connection_after_ms;
+        bool disable_auto_reconnect;
+    } network;
+} esp_mqtt_client_config_t;
+typedef void (*esp_event_handler_t)(void *event_handler_arg, esp_event_base_t event_base, int32_t event_id, void *event_data);
+#ifdef __cplusplus
+extern "C" {
+#endif
+esp_mqtt_client_handle_t esp_mqtt_client_init(const esp_mqtt_client_config_t *config);
+esp_err_t esp_mqtt_client_start(esp_mqtt_client_handle_t client);
+esp_err_t esp_mqtt_client_disconnect(esp_mqtt_client_handle_t client);
+int esp_mqtt_client_subscribe(esp_mqtt_client_handle_t client, const char *topic, int qos);
+int esp_mqtt_client_unsubscribe(esp_mqtt_client_handle_t client, const char *topic);
+int esp_mqtt_client_publish(esp_mqtt_client_handle_t client, const char *topic, const char *data, int len, int qos, int retain);
+int esp_mqtt_client_enqueue(esp_mqtt_client_handle_t client, const char *topic, const char *data, int len, int qos, int retain, bool store);
+esp_err_t esp_mqtt_client_register_event(esp_mqtt_client_handle_t client, esp_mqtt_event_id_t event, esp_event_handler_t event_handler, void *event_handler_arg);
+esp_err_t esp_mqtt5_client_set_publish_property(esp_mqtt_client_handle_t client, const esp_mqtt5_publish_property_config_t *property);
+esp_err_t esp_mqtt5_client_set_subscribe_property(esp_mqtt_client_handle_t client, const esp_mqtt5_subscribe_property_config_t *property);
+esp_err_t esp_mqtt5_client_set_unsubscribe_property(esp_mqtt_client_handle_t client, const esp_mqtt5_unsubscribe_property_config_t *property);
+esp_err_t esp_mqtt5_client_set_disconnect_property(esp_mqtt_client_handle_t client, const esp_mqtt5_disconnect_property_config_t *property);
+esp_err_t esp_mqtt5_client_set_connect_property(esp_mqtt_client_handle_t client, const esp_mqtt5_connection_property_config_t *connect_property);
+void esp_mqtt5_client_delete_user_property(mqtt5_user_property_handle_t user_property);
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,122 @@
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "nvs_flash.h"
+
+// In-memory NVS, lost when the process exits. Writes are visible before nvs_commit like
+// on the target (commit only flushes the handle's cache there).
+namespace
+{
+struct nvs_entry
+{
+    std::vector<uint8_t> blob;
+    uint32_t u32 = 0;
+    bool is_blob = false;
+};
+
+std::map<std::string, std::map<std::string, nvs_entry>> namespaces;
+std::vector<std::string> handles; // Handle value is its index plus one
+} // namespace
+
+static std::map<std::string, nvs_entry> *get_namespace(nvs_handle_t handle)
+{
+    if (handle == 0 || handle > handles.size())
+        return nullptr;
+    return &namespaces[handles[handle - 1]];
+}
+
+extern "C" {
+
+esp_err_t nvs_flash_init(void)
+{
+    return ESP_OK;
+}
+
+esp_err_t nvs_flash_erase(void)
+{
+    namespaces.clear();
+    return ESP_OK;
+}
+
+esp_err_t nvs_open(const char *namespace_name, nvs_open_mode_t open_mode, nvs_handle_t *out_handle)
+{
+    if (open_mode == NVS_READONLY && !namespaces.count(namespace_name))
+        return ESP_ERR_NVS_NOT_FOUND;
+    handles.push_back(namespace_name);
+    *out_handle = handles.size();
+    return ESP_OK;
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char *key, const void *value, size_t length)
+{
+    auto *entries = get_namespace(handle);
+    if (!entries)
+        return ESP_ERR_INVALID_ARG;
+    nvs_entry &entry = (*entries)[key];
+    entry.is_blob = true;
+    entry.blob.assign(static_cast<const uint8_t *>(value), static_cast<const uint8_t *>(value) + length);
+    return ESP_OK;
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char *key, void *out_value, size_t *length)
+{
+    auto *entries = get_namespace(handle);
+    if (!entries)
+        return ESP_ERR_INVALID_ARG;
+    auto entry = entries->find(key);
+    if (entry == entries->end() || !entry->second.is_blob)
+        return ESP_ERR_NVS_NOT_FOUND;
+
+    const std::vector<uint8_t> &blob = entry->second.blob;
+    if (out_value)
+    {
+        if (*length < blob.size())
+            return ESP_ERR_NVS_INVALID_LENGTH;
+        memcpy(out_value, blob.data(), blob.size());
+    }
+    *length = blob.size();
+    return ESP_OK;
+}
+
+esp_err_t nvs_set_u32(nvs_handle_t handle, const char *key, uint32_t value)
+{
+    auto *entries = get_namespace(handle);
+    if (!entries)
+        return ESP_ERR_INVALID_ARG;
+    nvs_entry &entry = (*entries)[key];
+    entry.is_blob = false;
+    entry.u32 = value;
+    return ESP_OK;
+}
+
+esp_err_t nvs_get_u32(nvs_handle_t handle, const char *key, uint32_t *out_value)
+{
+    auto *entries = get_namespace(handle);
+    if (!entries)
+        return ESP_ERR_INVALID_ARG;
+    auto entry = entries->find(key);
+    if (entry == entries->end() || entry->second.is_blob)
+        return ESP_ERR_NVS_NOT_FOUND;
+    *out_value = entry->second.u32;
+    return ESP_OK;
+}
+
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char *key)
+{
+    auto *entries = get_namespace(handle);
+    if (!entries)
+        return ESP_ERR_INVALID_ARG;
+    return entries->erase(key) ? ESP_OK : ESP_ERR_NVS_NOT_FOUND;
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle)
+{
+    return get_namespace(handle) ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+void nvs_close(nvs_handle_t handle)
+{
+}
+}
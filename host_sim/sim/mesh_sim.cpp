@@ -0,0 +1,801 @@
+#include "mesh_sim.h"
+
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <random>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "esp_ble_mesh_common_api.h"
+#include "esp_ble_mesh_config_model_api.h"
+#include "esp_ble_mesh_generic_model_api.h"
+#include "esp_ble_mesh_lighting_model_api.h"
+#include "esp_ble_mesh_provisioning_api.h"
+
+#include "ble_mesh/ble_mesh_control.h"
+#include "ble_mesh/mesh_command.h"
+#include "sim_clock.h"
+
+namespace
+{
+enum class client_kind
+{
+    config,
+    generic,
+    light,
+};
+
+// Server models a light can bind, one bit each in sim_light::bound_models
+enum model_bit : uint32_t
+{
+    model_onoff = 1 << 0,
+    model_lightness = 1 << 1,
+    model_hsl = 1 << 2,
+    model_ctl = 1 << 3,
+    model_ctl_temp = 1 << 4, // On the second element
+};
+
+struct exchange
+{
+    client_kind client;
+    bool get;
+    esp_ble_mesh_client_common_param_t params;
+    esp_ble_mesh_cfg_client_set_state_t cfg_set;
+    esp_ble_mesh_generic_client_set_state_t gen_set;
+    esp_ble_mesh_light_client_set_state_t light_set;
+    bool done = false;
+
+    // Filled by the light when it answers
+    std::vector<uint8_t> composition;
+    net_buf_simple composition_buf{};
+    esp_ble_mesh_gen_client_status_cb_t gen_status{};
+    esp_ble_mesh_light_client_status_cb_t light_status{};
+};
+
+sim_radio_config radio;
+sim_radio_counters counters;
+std::mt19937_64 rng;
+std::deque<sim_light> lights; // Stable addresses, pending events point at lights
+
+esp_ble_mesh_prov_cb_t prov_cb;
+esp_ble_mesh_cfg_client_cb_t config_cb;
+esp_ble_mesh_generic_client_cb_t generic_cb;
+esp_ble_mesh_light_client_cb_t light_cb;
+bool prov_enabled = false;
+uint16_t next_unicast = 0x0005;
+
+esp_ble_mesh_node_t node_storage[CONFIG_BLE_MESH_MAX_PROV_NODES];
+esp_ble_mesh_node_t *node_table[CONFIG_BLE_MESH_MAX_PROV_NODES];
+
+// Client model and element with an acknowledged message outstanding
+std::set<std::pair<const esp_ble_mesh_model_t *, uint16_t>> outstanding;
+int64_t bearer_free_us = 0;
+} // namespace
+
+static double uniform()
+{
+    return (rng() >> 11) * 0x1.0p-53;
+}
+
+static uint32_t path_latency_us(const sim_light &light)
+{
+    uint32_t latency = 0;
+    for (int hop = 0; hop < light.config.hops; hop++)
+    {
+        latency += radio.hop_latency_us + (uint32_t)(uniform() * radio.jitter_us);
+    }
+    return latency;
+}
+
+static bool survives(const sim_light &light, uint8_t pdus)
+{
+    const double loss = light.config.loss >= 0 ? light.config.loss : radio.loss;
+    return uniform() >= 1.0 - std::pow(1.0 - loss, light.config.hops * pdus);
+}
+
+static void post_prov_event(esp_ble_mesh_prov_cb_event_t event, const esp_ble_mesh_prov_cb_param_t &param, int64_t delay_us = 0)
+{
+    sim_schedule_in(delay_us, [event, copy = param]() mutable
+                    {
+        if (prov_cb)
+            prov_cb(event, &copy); });
+}
+
+static uint32_t light_models(const sim_light &light)
+{
+    uint32_t models = 0;
+    if (light.config.features & FEATURE_GENERIC_ONOFF)
+        models |= model_onoff;
+    if (light.config.features & FEATURE_LIGHT_LIGHTNESS)
+        models |= model_lightness;
+    if (light.config.features & FEATURE_LIGHT_HSL)
+        models |= model_hsl;
+    if (light.config.features & FEATURE_LIGHT_CTL)
+        models |= model_ctl | model_ctl_temp;
+    return models;
+}
+
+static uint32_t model_at(uint16_t element, uint16_t model_id)
+{
+    switch (model_id)
+    {
+    case ESP_BLE_MESH_MODEL_ID_GEN_ONOFF_SRV:
+        return element == 0 ? model_onoff : 0;
+    case ESP_BLE_MESH_MODEL_ID_LIGHT_LIGHTNESS_SRV:
+        return element == 0 ? model_lightness : 0;
+    case ESP_BLE_MESH_MODEL_ID_LIGHT_HSL_SRV:
+        return element == 0 ? model_hsl : 0;
+    case ESP_BLE_MESH_MODEL_ID_LIGHT_CTL_SRV:
+        return element == 0 ? model_ctl : 0;
+    case ESP_BLE_MESH_MODEL_ID_LIGHT_CTL_TEMP_SRV:
+        return element == 1 ? model_ctl_temp : 0;
+    default:
+        return 0;
+    }
+}
+
+// Server model an access message is processed by, given the element it is sent to
+static uint32_t served_by(uint32_t opcode, uint16_t element)
+{
+    switch (opcode)
+    {
+    case ESP_BLE_MESH_MODEL_OP_GEN_ONOFF_GET:
+    case ESP_BLE_MESH_MODEL_OP_GEN_ONOFF_SET:
+        return model_at(element, ESP_BLE_MESH_MODEL_ID_GEN_ONOFF_SRV);
+    case ESP_BLE_MESH_MODEL_OP_LIGHT_LIGHTNESS_GET:
+    case ESP_BLE_MESH_MODEL_OP_LIGHT_LIGHTNESS_SET:
+    case ESP_BLE_MESH_MODEL_OP_LIGHT_LIGHTNESS_RANGE_GET:
+        return model_at(element, ESP_BLE_MESH_MODEL_ID_LIGHT_LIGHTNESS_SRV);
+    case ESP_BLE_MESH_MODEL_OP_LIGHT_HSL_GET:
+    case ESP_BLE_MESH_MODEL_OP_LIGHT_HSL_SET:
+    case ESP_BLE_MESH_MODEL_OP_LIGHT_HSL_RANGE_GET:
+        return model_at(element, ESP_BLE_MESH_MODEL_ID_LIGHT_HSL_SRV);
+    case ESP_BLE_MESH_MODEL_OP_LIGHT_CTL_GET:
+    case ESP_BLE_MESH_MODEL_OP_LIGHT_CTL_SET:
+    case ESP_BLE_MESH_MODEL_OP_LIGHT_CTL_TEMPERATURE_RANGE_GET:
+        return model_at(element, ESP_BLE_MESH_MODEL_ID_LIGHT_CTL_SRV);
+    case ESP_BLE_MESH_MODEL_OP_LIGHT_CTL_TEMPERATURE_GET:
+    case ESP_BLE_MESH_MODEL_OP_LIGHT_CTL_TEMPERATURE_SET:
+        return model_at(element, ESP_BLE_MESH_MODEL_ID_LIGHT_CTL_TEMP_SRV);
+    default:
+        return 0;
+    }
+}
+
+static void put_u16(std::vector<uint8_t> &data, uint16_t value)
+{
+    data.push_back(value & 0xff);
+    data.push_back(value >> 8);
+}
+
+// Page 0: CID, PID, VID, CRPL, Features, then per element Loc, NumS, NumV and SIG model ids
+static std::vector<uint8_t> composition_data(const sim_light &light)
+{
+    std::vector<uint16_t> primary = {ESP_BLE_MESH_MODEL_ID_CONFIG_SRV};
+    const uint32_t models = light_models(light);
+    if (models & model_onoff)
+        primary.push_back(ESP_BLE_MESH_MODEL_ID_GEN_ONOFF_SRV);
+    if (models & model_lightness)
+        primary.push_back(ESP_BLE_MESH_MODEL_ID_LIGHT_LIGHTNESS_SRV);
+    if (models & model_hsl)
+        primary.push_back(ESP_BLE_MESH_MODEL_ID_LIGHT_HSL_SRV);
+    if (models & model_ctl)
+        primary.push_back(ESP_BLE_MESH_MODEL_ID_LIGHT_CTL_SRV);
+
+    std::vector<uint8_t> data;
+    put_u16(data, 0x02E5); // Espressif
+    put_u16(data, 0x0001);
+    put_u16(data, 0x0001);
+    put_u16(data, 10);
+    put_u16(data, BIT(0)); // Relay
+    put_u16(data, 0);
+    data.push_back(primary.size());
+    data.push_back(0);
+    for (uint16_t model : primary)
+    {
+        put_u16(data, model);
+    }
+    if (models & model_ctl_temp)
+    {
+        put_u16(data, 0);
+        data.push_back(1);
+        data.push_back(0);
+        put_u16(data, ESP_BLE_MESH_MODEL_ID_LIGHT_CTL_TEMP_SRV);
+    }
+    return data;
+}
+
+static void set_lightness(sim_light_state &state, uint16_t lightness)
+{
+    state.lightness = lightness;
+    state.onoff = lightness != 0;
+    if (lightness)
+        state.last_lightness = lightness;
+}
+
+static void apply_set(sim_light &light, const exchange &message)
+{
+    sim_light_state &state = light.state;
+    switch (message.params.opcode)
+    {
+    case ESP_BLE_MESH_MODEL_OP_GEN_ONOFF_SET:
+        // Generic OnOff is bound to Light Lightness Actual: off is 0, on restores the last level
+        set_lightness(state, message.gen_set.onoff_set.onoff ? state.last_lightness : 0);
+        break;
+    case ESP_BLE_MESH_MODEL_OP_LIGHT_LIGHTNESS_SET:
+        set_lightness(state, message.light_set.lightness_set.lightness);
+        break;
+    case ESP_BLE_MESH_MODEL_OP_LIGHT_HSL_SET:
+        state.hue = message.light_set.hsl_set.hsl_hue;
+        state.saturation = message.light_set.hsl_set.hsl_saturation;
+        set_lightness(state, message.light_set.hsl_set.hsl_lightness);
+        break;
+    case ESP_BLE_MESH_MODEL_OP_LIGHT_CTL_SET:
+        state.temperature = message.light_set.ctl_set.ctl_temperature;
+        set_lightness(state, message.light_set.ctl_set.ctl_lightness);
+        break;
+    case ESP_BLE_MESH_MODEL_OP_LIGHT_CTL_TEMPERATURE_SET:
+        state.temperature = message.light_set.ctl_temperature_set.ctl_temperature;
+        break;
+    default:
+        break;
+    }
+}
+
+static void fill_status(const sim_light &light, exchange &message)
+{
+    const sim_light_state &state = light.state;
+    switch (message.params.opcode)
+    {
+    case ESP_BLE_MESH_MODEL_OP_GEN_ONOFF_GET:
+    case ESP_BLE_MESH_MODEL_OP_GEN_ONOFF_SET:
+        message.gen_status.onoff_status.present_onoff = state.onoff;
+        message.gen_status.onoff_status.target_onoff = state.onoff;
+        break;
+    case ESP_BLE_MESH_MODEL_OP_LIGHT_LIGHTNESS_GET:
+    case ESP_BLE_MESH_MODEL_OP_LIGHT_LIGHTNESS_SET:
+        message.light_status.lightness_status.present_lightness = state.lightness;
+        message.light_status.lightness_status.target_lightness = state.lightness;
+        break;
+    case ESP_BLE_MESH_MODEL_OP_LIGHT_LIGHTNESS_RANGE_GET:
+        message.light_status.lightness_range_status.range_min = 1;
+        message.light_status.lightness_range_status.range_max = 0xFFFF;
+        break;
+    case ESP_BLE_MESH_MODEL_OP_LIGHT_HSL_GET:
+    case ESP_BLE_MESH_MODEL_OP_LIGHT_HSL_SET:
+        message.light_status.hsl_status.hsl_hue = state.hue;
+        message.light_status.hsl_status.hsl_saturation = state.saturation;
+        message.light_status.hsl_status.hsl_lightness = state.lightness;
+        break;
+    case ESP_BLE_MESH_MODEL_OP_LIGHT_HSL_RANGE_GET:
+        message.light_status.hsl_range_status.hue_range_max = 0xFFFF;
+        message.light_status.hsl_range_status.saturation_range_max = 0xFFFF;
+        break;
+    case ESP_BLE_MESH_MODEL_OP_LIGHT_CTL_GET:
+    case ESP_BLE_MESH_MODEL_OP_LIGHT_CTL_SET:
+        message.light_status.ctl_status.present_ctl_lightness = state.lightness;
+        message.light_status.ctl_status.present_ctl_temperature = state.temperature;
+        message.light_status.ctl_status.target_ctl_lightness = state.lightness;
+        message.light_status.ctl_status.target_ctl_temperature = state.temperature;
+        break;
+    case ESP_BLE_MESH_MODEL_OP_LIGHT_CTL_TEMPERATURE_GET:
+    case ESP_BLE_MESH_MODEL_OP_LIGHT_CTL_TEMPERATURE_SET:
+        message.light_status.ctl_temperature_status.present_ctl_temperature = state.temperature;
+        message.light_status.ctl_temperature_status.target_ctl_temperature = state.temperature;
+        break;
+    case ESP_BLE_MESH_MODEL_OP_LIGHT_CTL_TEMPERATURE_RANGE_GET:
+        message.light_status.ctl_temperature_range_status.range_min = 2700;
+        message.light_status.ctl_temperature_range_status.range_max = 6500;
+        break;
+    default:
+        break;
+    }
+}
+
+static void unprovision(sim_light &light)
+{
+    light.unicast = ESP_BLE_MESH_ADDR_UNASSIGNED;
+    light.app_key = false;
+    light.bound_models = 0;
+}
+
+// Processes a message that reached the light, false if it stays unanswered
+static bool light_receive(sim_light &light, exchange &message)
+{
+    const uint16_t element = message.params.ctx.addr - light.unicast;
+    light.received++;
+
+    if (message.client == client_kind::config)
+    {
+        switch (message.params.opcode)
+        {
+        case ESP_BLE_MESH_MODEL_OP_COMPOSITION_DATA_GET:
+            message.composition = composition_data(light);
+            message.composition_buf.data = message.composition.data();
+            message.composition_buf.len = message.composition.size();
+            message.composition_buf.size = message.composition.size();
+            return true;
+        case ESP_BLE_MESH_MODEL_OP_APP_KEY_ADD:
+            light.app_key = true;
+            return true;
+        case ESP_BLE_MESH_MODEL_OP_MODEL_APP_BIND:
+        {
+            const auto &bind = message.cfg_set.model_app_bind;
+            light.bound_models |= model_at(bind.element_addr - light.unicast, bind.model_id) & light_models(light);
+            return true;
+        }
+        case ESP_BLE_MESH_MODEL_OP_NODE_RESET:
+            // Answers first, then forgets the network
+            sim_schedule_in(radio.ack_delay_us, [&light]()
+                            { unprovision(light); });
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    const uint32_t model = served_by(message.params.opcode, element);
+    if (!light.app_key || !(light.bound_models & model))
+        return false;
+
+    if (!message.get)
+        apply_set(light, message);
+    fill_status(light, message);
+    return true;
+}
+
+static void deliver(const std::shared_ptr<exchange> &message, int error_code, bool timeout)
+{
+    message->done = true;
+    outstanding.erase({message->params.model, message->params.ctx.addr});
+
+    switch (message->client)
+    {
+    case client_kind::config:
+    {
+        esp_ble_mesh_cfg_client_cb_param_t param = {};
+        param.error_code = error_code;
+        param.params = &message->params;
+        param.status_cb.comp_data_status.composition_data = &message->composition_buf;
+        if (config_cb)
+            config_cb(timeout ? ESP_BLE_MESH_CFG_CLIENT_TIMEOUT_EVT : message->get ? ESP_BLE_MESH_CFG_CLIENT_GET_STATE_EVT : ESP_BLE_MESH_CFG_CLIENT_SET_STATE_EVT, &param);
+        break;
+    }
+    case client_kind::generic:
+    {
+        esp_ble_mesh_generic_client_cb_param_t param = {};
+        param.error_code = error_code;
+        param.params = &message->params;
+        param.status_cb = message->gen_status;
+        if (generic_cb)
+            generic_cb(timeout ? ESP_BLE_MESH_GENERIC_CLIENT_TIMEOUT_EVT : message->get ? ESP_BLE_MESH_GENERIC_CLIENT_GET_STATE_EVT : ESP_BLE_MESH_GENERIC_CLIENT_SET_STATE_EVT, &param);
+        break;
+    }
+    case client_kind::light:
+    {
+        esp_ble_mesh_light_client_cb_param_t param = {};
+        param.error_code = error_code;
+        param.params = &message->params;
+        param.status_cb = message->light_status;
+        if (light_cb)
+            light_cb(timeout ? ESP_BLE_MESH_LIGHT_CLIENT_TIMEOUT_EVT : message->get ? ESP_BLE_MESH_LIGHT_CLIENT_GET_STATE_EVT : ESP_BLE_MESH_LIGHT_CLIENT_SET_STATE_EVT, &param);
+        break;
+    }
+    }
+}
+
+// Like the stack, errors found once the message is processed come back as a state event
+// carrying error_code, never as a return value
+static esp_err_t send_message(std::shared_ptr<exchange> message)
+{
+    if (!message->params.model || !ESP_BLE_MESH_ADDR_IS_UNICAST(message->params.ctx.addr))
+        return ESP_ERR_INVALID_ARG;
+
+    counters.messages++;
+    const auto key = std::make_pair((const esp_ble_mesh_model_t *)message->params.model, message->params.ctx.addr);
+    if (outstanding.count(key))
+    {
+        counters.busy++;
+        sim_schedule_in(0, [message]()
+                        { deliver(message, -EBUSY, false); });
+        return ESP_OK;
+    }
+
+    mesh_command cmd = {};
+    cmd.opcode = message->params.opcode;
+    cmd.type = message_type_t::ble_mesh_message;
+    const uint8_t pdus = mesh_command_airtime(cmd);
+
+    const int64_t now = sim_now_us();
+    const int64_t start_us = std::max(now, bearer_free_us);
+    const uint32_t backlog = (start_us - now + radio.pdu_airtime_us - 1) / radio.pdu_airtime_us;
+    if (backlog + pdus > CONFIG_BLE_MESH_ADV_BUF_COUNT)
+    {
+        counters.no_buffers++;
+        sim_schedule_in(0, [message]()
+                        { deliver(message, -ENOBUFS, false); });
+        return ESP_OK;
+    }
+    counters.max_bearer_backlog = std::max(counters.max_bearer_backlog, backlog + pdus);
+    counters.pdus += pdus;
+    bearer_free_us = start_us + (int64_t)pdus * radio.pdu_airtime_us;
+
+    outstanding.insert(key);
+    const int32_t timeout_ms = message->params.msg_timeout ? message->params.msg_timeout : CONFIG_BLE_MESH_CLIENT_MSG_TIMEOUT;
+    sim_schedule_in((int64_t)timeout_ms * 1000, [message]()
+                    {
+        if (message->done)
+            return;
+        counters.timeouts++;
+        deliver(message, 0, true); });
+
+    sim_light *light = mesh_sim_find_light(message->params.ctx.addr);
+    if (!light || !light->powered)
+    {
+        counters.ignored++;
+        return ESP_OK;
+    }
+    if (!survives(*light, pdus))
+    {
+        counters.lost++;
+        return ESP_OK;
+    }
+
+    sim_schedule(bearer_free_us + path_latency_us(*light), [message, light]()
+                 {
+        if (!light->powered || mesh_sim_find_light(message->params.ctx.addr) != light || !light_receive(*light, *message))
+        {
+            counters.ignored++;
+            return;
+        }
+
+        const uint8_t reply_pdus = message->composition.empty() ? 1 : (message->composition.size() + 2 + 4 + 11) / 12;
+        if (!survives(*light, reply_pdus))
+        {
+            counters.lost++;
+            return;
+        }
+        sim_schedule_in(radio.ack_delay_us + path_latency_us(*light), [message]()
+                        {
+            if (message->done)
+            {
+                counters.late_replies++;
+                return;
+            }
+            counters.replies++;
+            deliver(message, 0, false); }); });
+    return ESP_OK;
+}
+
+static std::shared_ptr<exchange> new_exchange(client_kind client, bool get, const esp_ble_mesh_client_common_param_t *params)
+{
+    auto message = std::make_shared<exchange>();
+    message->client = client;
+    message->get = get;
+    message->params = *params;
+    return message;
+}
+
+void mesh_sim_configure(uint64_t seed, const sim_radio_config &config)
+{
+    rng.seed(seed);
+    radio = config;
+}
+
+size_t mesh_sim_add_light(const sim_light_config &config)
+{
+    sim_light &light = lights.emplace_back();
+    light.config = config;
+    light.elements = (config.features & FEATURE_LIGHT_CTL) ? 2 : 1;
+    const size_t index = lights.size() - 1;
+    for (size_t i = 0; i < 16; i++)
+    {
+        light.uuid[i] = (uint8_t)(rng() >> 56);
+    }
+    light.mac[0] = 0xA4;
+    light.mac[1] = 0xC1;
+    light.mac[2] = 0x38;
+    light.mac[3] = index >> 16;
+    light.mac[4] = index >> 8;
+    light.mac[5] = index;
+    return index;
+}
+
+size_t mesh_sim_light_count()
+{
+    return lights.size();
+}
+
+sim_light &mesh_sim_get_light(size_t index)
+{
+    return lights[index];
+}
+
+sim_light *mesh_sim_find_light(uint16_t addr)
+{
+    for (sim_light &light : lights)
+    {
+        if (light.unicast != ESP_BLE_MESH_ADDR_UNASSIGNED && addr >= light.unicast && addr < light.unicast + light.elements)
+            return &light;
+    }
+    return nullptr;
+}
+
+void mesh_sim_beacon(size_t index)
+{
+    sim_light &light = lights[index];
+    if (!prov_enabled || !light.powered || light.unicast != ESP_BLE_MESH_ADDR_UNASSIGNED)
+        return;
+
+    esp_ble_mesh_prov_cb_param_t param = {};
+    auto &adv = param.provisioner_recv_unprov_adv_pkt;
+    memcpy(adv.dev_uuid, light.uuid, 16);
+    memcpy(adv.addr, light.mac, BD_ADDR_LEN);
+    adv.addr_type = BLE_MESH_ADDR_PUBLIC;
+    adv.bearer = ESP_BLE_MESH_PROV_ADV;
+    adv.rssi = -60 - 10 * light.config.hops;
+    post_prov_event(ESP_BLE_MESH_PROVISIONER_RECV_UNPROV_ADV_PKT_EVT, param);
+}
+
+void mesh_sim_set_power(size_t index, bool powered)
+{
+    sim_light &light = lights[index];
+    if (powered && !light.powered)
+    {
+        // Bulbs come back on at their last level
+        set_lightness(light.state, light.state.last_lightness);
+    }
+    light.powered = powered;
+}
+
+const sim_radio_counters &mesh_sim_get_counters()
+{
+    return counters;
+}
+
+extern "C" {
+
+esp_err_t esp_ble_mesh_init(esp_ble_mesh_prov_t *prov, esp_ble_mesh_comp_t *comp)
+{
+    // The stack binds each client context to its model
+    for (size_t e = 0; e < comp->element_count; e++)
+    {
+        esp_ble_mesh_elem_t &element = comp->elements[e];
+        for (size_t m = 0; m < element.sig_model_count; m++)
+        {
+            esp_ble_mesh_model_t &model = element.sig_models[m];
+            if (model.model_id != ESP_BLE_MESH_MODEL_ID_CONFIG_SRV && model.user_data)
+                static_cast<esp_ble_mesh_client_t *>(model.user_data)->model = &model;
+        }
+    }
+    next_unicast = prov->prov_start_address;
+
+    esp_ble_mesh_prov_cb_param_t param = {};
+    post_prov_event(ESP_BLE_MESH_PROV_REGISTER_COMP_EVT, param);
+    return ESP_OK;
+}
+
+esp_err_t esp_ble_mesh_register_prov_callback(esp_ble_mesh_prov_cb_t callback)
+{
+    prov_cb = callback;
+    return ESP_OK;
+}
+
+esp_err_t esp_ble_mesh_register_config_client_callback(esp_ble_mesh_cfg_client_cb_t callback)
+{
+    config_cb = callback;
+    return ESP_OK;
+}
+
+esp_err_t esp_ble_mesh_register_generic_client_callback(esp_ble_mesh_generic_client_cb_t callback)
+{
+    generic_cb = callback;
+    return ESP_OK;
+}
+
+esp_err_t esp_ble_mesh_register_light_client_callback(esp_ble_mesh_light_client_cb_t callback)
+{
+    light_cb = callback;
+    return ESP_OK;
+}
+
+esp_err_t esp_ble_mesh_provisioner_prov_enable(esp_ble_mesh_prov_bearer_t bearers)
+{
+    esp_ble_mesh_prov_cb_param_t param = {};
+    param.provisioner_prov_enable_comp.err_code = prov_enabled ? -EALREADY : 0;
+    prov_enabled = true;
+    post_prov_event(ESP_BLE_MESH_PROVISIONER_PROV_ENABLE_COMP_EVT, param);
+    return ESP_OK;
+}
+
+esp_err_t esp_ble_mesh_provisioner_prov_disable(esp_ble_mesh_prov_bearer_t bearers)
+{
+    esp_ble_mesh_prov_cb_param_t param = {};
+    param.provisioner_prov_disable_comp.err_code = prov_enabled ? 0 : -EALREADY;
+    prov_enabled = false;
+    post_prov_event(ESP_BLE_MESH_PROVISIONER_PROV_DISABLE_COMP_EVT, param);
+    return ESP_OK;
+}
+
+esp_err_t esp_ble_mesh_provisioner_add_unprov_dev(esp_ble_mesh_unprov_dev_add_t *add_dev, esp_ble_mesh_dev_add_flag_t flags)
+{
+    sim_light *light = nullptr;
+    for (sim_light &candidate : lights)
+    {
+        if (memcmp(candidate.uuid, add_dev->uuid, 16) == 0)
+            light = &candidate;
+    }
+
+    esp_ble_mesh_prov_cb_param_t param = {};
+    param.provisioner_add_unprov_dev_comp.err_code = (!light || light->provisioning) ? -EALREADY : 0;
+    post_prov_event(ESP_BLE_MESH_PROVISIONER_ADD_UNPROV_DEV_COMP_EVT, param);
+    if (!light || light->provisioning || light->unicast != ESP_BLE_MESH_ADDR_UNASSIGNED)
+        return ESP_OK;
+
+    light->provisioning = true;
+    esp_ble_mesh_prov_cb_param_t link = {};
+    link.provisioner_prov_link_open.bearer = ESP_BLE_MESH_PROV_ADV;
+    post_prov_event(ESP_BLE_MESH_PROVISIONER_PROV_LINK_OPEN_EVT, link, 100000);
+
+    sim_schedule_in(radio.provisioning_us, [light]()
+                    {
+        light->provisioning = false;
+        int slot = -1;
+        for (int i = 0; i < CONFIG_BLE_MESH_MAX_PROV_NODES && slot < 0; i++)
+        {
+            if (!node_table[i])
+                slot = i;
+        }
+
+        esp_ble_mesh_prov_cb_param_t close = {};
+        close.provisioner_prov_link_close.bearer = ESP_BLE_MESH_PROV_ADV;
+        close.provisioner_prov_link_close.reason = (slot < 0 || !light->powered) ? 0x01 : 0x00;
+        post_prov_event(ESP_BLE_MESH_PROVISIONER_PROV_LINK_CLOSE_EVT, close);
+        if (close.provisioner_prov_link_close.reason)
+            return;
+
+        light->unicast = next_unicast;
+        next_unicast += light->elements;
+
+        esp_ble_mesh_node_t &node = node_storage[slot];
+        node = {};
+        memcpy(node.addr, light->mac, BD_ADDR_LEN);
+        memcpy(node.dev_uuid, light->uuid, 16);
+        node.unicast_addr = light->unicast;
+        node.element_num = light->elements;
+        node_table[slot] = &node;
+
+        esp_ble_mesh_prov_cb_param_t complete = {};
+        complete.provisioner_prov_complete.node_idx = slot;
+        memcpy(complete.provisioner_prov_complete.device_uuid, light->uuid, 16);
+        complete.provisioner_prov_complete.unicast_addr = light->unicast;
+        complete.provisioner_prov_complete.element_num = light->elements;
+        complete.provisioner_prov_complete.netkey_idx = 0;
+        post_prov_event(ESP_BLE_MESH_PROVISIONER_PROV_COMPLETE_EVT, complete); });
+    return ESP_OK;
+}
+
+esp_err_t esp_ble_mesh_provisioner_set_node_name(uint16_t index, const char *name)
+{
+    if (index >= CONFIG_BLE_MESH_MAX_PROV_NODES || !node_table[index])
+        return ESP_ERR_INVALID_ARG;
+    strncpy(node_table[index]->name, name, sizeof(node_table[index]->name) - 1);
+
+    esp_ble_mesh_prov_cb_param_t param = {};
+    param.provisioner_set_node_name_comp.node_index = index;
+    post_prov_event(ESP_BLE_MESH_PROVISIONER_SET_NODE_NAME_COMP_EVT, param);
+    return ESP_OK;
+}
+
+const char *esp_ble_mesh_provisioner_get_node_name(uint16_t index)
+{
+    if (index >= CONFIG_BLE_MESH_MAX_PROV_NODES || !node_table[index])
+        return nullptr;
+    return node_table[index]->name;
+}
+
+esp_ble_mesh_node_t *esp_ble_mesh_provisioner_get_node_with_uuid(const uint8_t uuid[16])
+{
+    for (esp_ble_mesh_node_t *node : node_table)
+    {
+        if (node && memcmp(node->dev_uuid, uuid, 16) == 0)
+            return node;
+    }
+    return nullptr;
+}
+
+esp_ble_mesh_node_t *esp_ble_mesh_provisioner_get_node_with_addr(uint16_t unicast_addr)
+{
+    for (esp_ble_mesh_node_t *node : node_table)
+    {
+        if (node && unicast_addr >= node->unicast_addr && unicast_addr < node->unicast_addr + node->element_num)
+            return node;
+    }
+    return nullptr;
+}
+
+esp_ble_mesh_node_t **esp_ble_mesh_provisioner_get_node_table_entry(void)
+{
+    return node_table;
+}
+
+uint16_t esp_ble_mesh_provisioner_get_prov_node_count(void)
+{
+    uint16_t count = 0;
+    for (esp_ble_mesh_node_t *node : node_table)
+    {
+        count += node != nullptr;
+    }
+    return count;
+}
+
+esp_err_t esp_ble_mesh_provisioner_delete_node_with_uuid(const uint8_t uuid[16])
+{
+    for (esp_ble_mesh_node_t *&node : node_table)
+    {
+        if (node && memcmp(node->dev_uuid, uuid, 16) == 0)
+        {
+            node = nullptr;
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_NOT_FOUND;
+}
+
+esp_err_t esp_ble_mesh_provisioner_add_local_app_key(const uint8_t app_key[16], uint16_t net_idx, uint16_t app_idx)
+{
+    esp_ble_mesh_prov_cb_param_t param = {};
+    param.provisioner_add_app_key_comp.net_idx = net_idx;
+    param.provisioner_add_app_key_comp.app_idx = app_idx;
+    post_prov_event(ESP_BLE_MESH_PROVISIONER_ADD_LOCAL_APP_KEY_COMP_EVT, param);
+    return ESP_OK;
+}
+
+esp_err_t esp_ble_mesh_provisioner_bind_app_key_to_local_model(uint16_t element_addr, uint16_t app_idx, uint16_t model_id, uint16_t company_id)
+{
+    esp_ble_mesh_prov_cb_param_t param = {};
+    post_prov_event(ESP_BLE_MESH_PROVISIONER_BIND_APP_KEY_TO_MODEL_COMP_EVT, param);
+    return ESP_OK;
+}
+
+esp_err_t esp_ble_mesh_config_client_get_state(esp_ble_mesh_client_common_param_t *params, esp_ble_mesh_cfg_client_get_state_t *get_state)
+{
+    return send_message(new_exchange(client_kind::config, true, params));
+}
+
+esp_err_t esp_ble_mesh_config_client_set_state(esp_ble_mesh_client_common_param_t *params, esp_ble_mesh_cfg_client_set_state_t *set_state)
+{
+    auto message = new_exchange(client_kind::config, false, params);
+    message->cfg_set = *set_state;
+    return send_message(message);
+}
+
+esp_err_t esp_ble_mesh_generic_client_get_state(esp_ble_mesh_client_common_param_t *params, esp_ble_mesh_generic_client_get_state_t *get_state)
+{
+    return send_message(new_exchange(client_kind::generic, true, params));
+}
+
+esp_err_t esp_ble_mesh_generic_client_set_state(esp_ble_mesh_client_common_param_t *params, esp_ble_mesh_generic_client_set_state_t *set_state)
+{
+    auto message = new_exchange(client_kind::generic, false, params);
+    message->gen_set = *set_state;
+    return send_message(message);
+}
+
+esp_err_t esp_ble_mesh_light_client_get_state(esp_ble_mesh_client_common_param_t *params, esp_ble_mesh_light_client_get_state_t *get_state)
+{
+    return send_message(new_exchange(client_kind::light, true, params));
+}
+
+esp_err_t esp_ble_mesh_light_client_set_state(esp_ble_mesh_client_common_param_t *params, esp_ble_mesh_light_client_set_state_t *set_state)
+{
+    auto message = new_exchange(client_kind::light, false, params);
+    message->light_set = *set_state;
+    return send_message(message);
+}
+}
@@ -0,0 +1,76 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include "esp_ble_mesh_defs.h"
+
+// Fake esp_ble_mesh provisioner and client models. The bridge's messages go through a
+// shared advertising bearer (one PDU at a time, CONFIG_BLE_MESH_ADV_BUF_COUNT buffers), then
+// reach simulated lights over a number of hops with latency, jitter and loss. Lights keep
+// their OnOff/Lightness/HSL/CTL state, only answer on models they have and the bridge bound,
+// and report through the callbacks the firmware registered, on the virtual clock.
+struct sim_radio_config
+{
+    uint32_t pdu_airtime_us = 40000;     // Bearer time of one network PDU sent by the bridge
+    uint32_t hop_latency_us = 30000;     // Per hop, relays included
+    uint32_t jitter_us = 20000;          // Uniform, drawn per hop
+    uint32_t ack_delay_us = 20000;       // Light processing before its status goes out
+    double loss = 0.0;                   // Per PDU and per hop, both directions
+    uint32_t provisioning_us = 4000000;  // PB-ADV link open to provisioning complete
+};
+
+struct sim_light_config
+{
+    uint16_t features = 0; // node_supported_features_t
+    uint8_t hops = 1;
+    double loss = -1; // Negative: the radio default
+};
+
+struct sim_light_state
+{
+    uint8_t onoff = 0;
+    uint16_t lightness = 0; // Light Lightness Actual, 0 while off
+    uint16_t last_lightness = 0xFFFF;
+    uint16_t hue = 0;
+    uint16_t saturation = 0;
+    uint16_t temperature = 4000;
+};
+
+struct sim_light
+{
+    sim_light_config config;
+    uint8_t uuid[16];
+    esp_ble_mesh_bd_addr_t mac;
+    uint16_t unicast = ESP_BLE_MESH_ADDR_UNASSIGNED;
+    uint8_t elements = 1;
+    bool powered = true;
+    bool provisioning = false;
+    bool app_key = false;
+    uint32_t bound_models = 0; // Bit per bindable model, see mesh_sim.cpp
+    sim_light_state state;
+    uint32_t received = 0;
+};
+
+struct sim_radio_counters
+{
+    uint32_t messages = 0;     // Acknowledged messages handed to the stack
+    uint32_t pdus = 0;         // Network PDUs put on the bearer
+    uint32_t lost = 0;         // Requests or replies lost on the way
+    uint32_t replies = 0;      // Statuses delivered before the client timeout
+    uint32_t late_replies = 0; // Statuses arriving after it, dropped by the stack
+    uint32_t timeouts = 0;
+    uint32_t busy = 0;         // Rejected, the client model already waits on that element
+    uint32_t no_buffers = 0;   // Rejected, advertising buffers exhausted
+    uint32_t ignored = 0;      // Not answered: unknown address, model not bound, light off
+    uint32_t max_bearer_backlog = 0; // PDUs waiting for the bearer, high watermark
+};
+
+void mesh_sim_configure(uint64_t seed, const sim_radio_config &config);
+size_t mesh_sim_add_light(const sim_light_config &config);
+size_t mesh_sim_light_count();
+sim_light &mesh_sim_get_light(size_t index);
+// Light owning an element address, nullptr if none
+sim_light *mesh_sim_find_light(uint16_t addr);
+// Sends the unprovisioned device beacon, the provisioner reports it if provisioning is enabled
+void mesh_sim_beacon(size_t index);
+void mesh_sim_set_power(size_t index, bool powered);
+const sim_radio_counters &mesh_sim_get_counters();
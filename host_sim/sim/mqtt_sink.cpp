@@ -0,0 +1,59 @@
+#include "mqtt_sink.h"
+
+#include "mqtt/mqtt_bridge.h"
+#include "mqtt/mqtt_control.h"
+
+static mqtt_sink_counters counters;
+static std::map<uint16_t, bm2mqtt_node_info> published;
+static std::function<void(const bm2mqtt_node_info *)> status_hook;
+static std::function<void(const bm2mqtt_node_info *, bool)> availability_hook;
+
+const mqtt_sink_counters &mqtt_sink_get_counters()
+{
+    return counters;
+}
+
+const std::map<uint16_t, bm2mqtt_node_info> &mqtt_sink_get_published()
+{
+    return published;
+}
+
+void mqtt_sink_on_status(std::function<void(const bm2mqtt_node_info *)> hook)
+{
+    status_hook = std::move(hook);
+}
+
+void mqtt_sink_on_availability(std::function<void(const bm2mqtt_node_info *, bool)> hook)
+{
+    availability_hook = std::move(hook);
+}
+
+void mqtt_node_send_status(const bm2mqtt_node_info *node_info)
+{
+    counters.status++;
+    published[node_info->unicast] = *node_info;
+    if (status_hook)
+        status_hook(node_info);
+}
+
+void mqtt_node_send_availability(const bm2mqtt_node_info *node_info, bool available)
+{
+    (available ? counters.online : counters.offline)++;
+    if (availability_hook)
+        availability_hook(node_info, available);
+}
+
+void mqtt_send_discovery(const bm2mqtt_node_info *node_info)
+{
+    counters.discovery++;
+}
+
+const std::string &get_bridge_base_topic()
+{
+    static const std::string topic{"blemesh2mqtt_24dcc3a1b2c4"};
+    return topic;
+}
+
+void mqtt_publish_provisioning_enabled(bool enable_provisioning)
+{
+}
@@ -0,0 +1,22 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <map>
+#include "ble_mesh/ble_mesh_node.h"
+
+// Stands in for the MQTT publishers the mesh pipeline calls (mqtt_control, mqtt_bridge).
+// Publishes are counted and the node state of each status publish is kept, which is what
+// Home Assistant would display.
+struct mqtt_sink_counters
+{
+    uint32_t status = 0;
+    uint32_t discovery = 0;
+    uint32_t online = 0;
+    uint32_t offline = 0;
+};
+
+const mqtt_sink_counters &mqtt_sink_get_counters();
+// Last published state per primary unicast address
+const std::map<uint16_t, bm2mqtt_node_info> &mqtt_sink_get_published();
+void mqtt_sink_on_status(std::function<void(const bm2mqtt_node_info *)> hook);
+void mqtt_sink_on_availability(std::function<void(const bm2mqtt_node_info *, bool)> hook);
@@ -0,0 +1,13 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+
+// Virtual time of the simulation, in microseconds. Nothing runs on its own: esp_timer
+// callbacks, radio deliveries and bench commands are events executed in time order (ties in
+// scheduling order) by sim_run_until, so a run only depends on the scenario and the seed.
+int64_t sim_now_us();
+void sim_schedule(int64_t at_us, std::function<void()> fn);
+void sim_schedule_in(int64_t delay_us, std::function<void()> fn);
+// Runs every event due up to at_us, then leaves the clock at at_us
+void sim_run_until(int64_t at_us);
+size_t sim_pending_events();
@@ -0,0 +1,10 @@
+#pragma once
+#include <string>
+#include "esp_err.h"
+#include "esp_log.h"
+
+// Host side of the fake ESP-IDF layer. Logs are printed with the virtual time like the
+// firmware console, filtered by the esp_log_level_set("*") level (ESP_LOG_NONE by default).
+
+// Runs a command registered through esp_console_cmd_register, as typed on the firmware console
+esp_err_t sim_console_run(const std::string &line, int *ret);
@@ -30,34 +30,14 @@ long map(long x, long in_min, long in_max, long out_min, long out_max)
 
 void ble_mesh_ctl_set(bm2mqtt_node_info *node_info)
 {
-    node_info->color_mode = color_mode_t::color_temp;
-    message_queue().enqueue(node_info,
-                            message_payload{
-                                .send = [node_info]()
-                                {
-                                    ESP_LOGW(TAG, "[ble_mesh_ctl_set] Setting CTL for node 0x%04X", __func__, node_info->unicast);
-                                    esp_ble_mesh_client_common_param_t common = {0};
-                                    esp_ble_mesh_light_client_set_state_t set_state_light = {0};
-
-                                    node_manager().example_ble_mesh_set_msg_common(&common, node_info, ctl_cli.model, ESP_BLE_MESH_MODEL_OP_LIGHT_CTL_SET);
-
-                                    set_state_light.ctl_set.ctl_temperature = node_info->curr_temp;
-                                    set_state_light.ctl_set.ctl_lightness = node_info->hsl_l;
-                                    set_state_light.ctl_set.ctl_delta_uv = 0;
-                                    set_state_light.ctl_set.op_en = false;
-                                    set_state_light.ctl_set.delay = 0;
-                                    set_state_light.ctl_set.tid = store.tid++; // Transaction ID (should increment on each new transaction)
-                                    int err = esp_ble_mesh_light_client_set_state(&common, &set_state_light);
-                                },
-                                .opcode = ESP_BLE_MESH_MODEL_OP_LIGHT_CTL_SET,
-                                .retries_left = 3,
-                            });
+    update_node_field(node_info, &bm2mqtt_node_info::color_mode, color_mode_t::color_temp, FIELD_COLOR_MODE, state_source::assumed);
+    message_queue().enqueue(node_info, make_ctl_set(node_info->unicast, node_info->curr_temp, node_info->hsl_l));
 }
 
 void ble_mesh_ctl_temperature_set(bm2mqtt_node_info *node_info)
 {
     ESP_LOGI(TAG, "[%s] Setting CTL Temperature for node 0x%04X", __func__, node_info->unicast);
-    node_info->color_mode = color_mode_t::color_temp;
+    update_node_field(node_info, &bm2mqtt_node_info::color_mode, color_mode_t::color_temp, FIELD_COLOR_MODE, state_source::assumed);
 
     esp_ble_mesh_client_common_param_t common = {0};
     esp_ble_mesh_light_client_set_state_t set_state_light = {0};
@@ -79,57 +59,13 @@ void ble_mesh_ctl_temperature_set(bm2mqtt_node_info *node_info)
 
 void light_hsl_set(bm2mqtt_node_info *node_info)
 {
-    message_queue().enqueue(node_info,
-                            message_payload{
-                                .send = [node_info]()
-                                {
-                                    ESP_LOGW(TAG, "[light_hsl_set] Setting HSL for node 0x%04X", __func__, node_info->unicast);
-                                    esp_ble_mesh_client_common_param_t common = {0};
-                                    esp_ble_mesh_light_client_set_state_t set_state = {0};
-
-                                    node_manager().example_ble_mesh_set_msg_common(&common, node_info, hsl_cli.model, ESP_BLE_MESH_MODEL_OP_LIGHT_HSL_SET);
-
-                                    node_info->color_mode = color_mode_t::hs;
-                                    set_state.hsl_set.hsl_hue = node_info->hsl_h;
-                                    set_state.hsl_set.hsl_saturation = node_info->hsl_s;
-                                    set_state.hsl_set.hsl_lightness = node_info->hsl_l;
-                                    set_state.hsl_set.op_en = false;
-                                    set_state.hsl_set.delay = 0;
-                                    set_state.hsl_set.tid = store.tid++; // Transaction ID (should increment on each new transaction)
-                                    esp_err_t err = esp_ble_mesh_light_client_set_state(&common, &set_state);
-                                    if (err)
-                                    {
-                                        ESP_LOGE(TAG, "%s: call to esp_ble_mesh_light_client_set_state failed", __func__);
-                                    }
-                                },
-                                .opcode = ESP_BLE_MESH_MODEL_OP_LIGHT_HSL_SET,
-                                .retries_left = 3,
-                            });
+    update_node_field(node_info, &bm2mqtt_node_info::color_mode, color_mode_t::hs, FIELD_COLOR_MODE, state_source::assumed);
+    message_queue().enqueue(node_info, make_hsl_set(node_info->unicast, node_info->hsl_h, node_info->hsl_s, node_info->hsl_l));
 }
 
 void gen_onoff_set(bm2mqtt_node_info *node_info)
 {
-    message_queue().enqueue(node_info,
-                            message_payload{
-                                .send = [node_info]()
-                                {
-                                    ESP_LOGW(TAG, "[gen_onoff_set] Generic on/off model for node 0x%04X", node_info->unicast);
-                                    esp_ble_mesh_client_common_param_t common = {0};
-                                    esp_ble_mesh_generic_client_set_state_t set_state = {0};
-
-                                    node_manager().example_ble_mesh_set_msg_common(&common, node_info, onoff_client.model, ESP_BLE_MESH_MODEL_OP_GEN_ONOFF_SET);
-                                    set_state.onoff_set.op_en = false;
-                                    set_state.onoff_set.onoff = node_info->onoff;
-                                    set_state.onoff_set.tid = store.tid++;
-                                    esp_err_t err = esp_ble_mesh_generic_client_set_state(&common, &set_state);
-                                    if (err)
-                                    {
-                                        ESP_LOGE(TAG, "%s: call to esp_ble_mesh_config_client_set_state failed", __func__);
-                                    }
-                                },
-                                .opcode = ESP_BLE_MESH_MODEL_OP_GEN_ONOFF_SET,
-                                .retries_left = 3,
-                            });
+    message_queue().enqueue(node_info, make_onoff_set(node_info->unicast, node_info->onoff));
 }
 
 typedef struct
@@ -305,9 +241,9 @@ int ble_mesh_ctl_lightness_set(int argc, char **argv)
         return 1;
     }
 
-    if (bm2mqtt_node_info *node_info = node_manager().get_node(0); node_info->unicast != ESP_BLE_MESH_ADDR_UNASSIGNED)
+    if (bm2mqtt_node_info *node_info = node_manager().get_node(0); node_info && node_info->unicast != ESP_BLE_MESH_ADDR_UNASSIGNED)
     {
-            node_info->hsl_l = ctl_lightness_set_args.lightness->ival[0];
+            update_node_field(node_info, &bm2mqtt_node_info::hsl_l, ctl_lightness_set_args.lightness->ival[0], FIELD_LIGHTNESS, state_source::assumed);
             ble_mesh_lightness_set(node_info);     
     }
     return 0;
@@ -318,37 +254,14 @@ void ble_mesh_ctl_lightness_set(int lightness_value, const Uuid128& uuid)
 {
     if (bm2mqtt_node_info *node_info = node_manager().get_node(uuid); node_info && node_info->unicast != ESP_BLE_MESH_ADDR_UNASSIGNED)
     {
-        node_info->hsl_l = lightness_value;
+        update_node_field(node_info, &bm2mqtt_node_info::hsl_l, lightness_value, FIELD_LIGHTNESS, state_source::assumed);
         ble_mesh_lightness_set(node_info);    
     }
 }
 
 void ble_mesh_lightness_set(bm2mqtt_node_info *node_info)
 {
-    message_queue().enqueue(node_info,
-                            message_payload{
-                                .send = [node_info]()
-                                {
-                                    ESP_LOGW(TAG, "[ble_mesh_ctl_lightness_set] Setting Lightness for node 0x%04X", __func__, node_info->unicast);
-                                    esp_ble_mesh_client_common_param_t common = {0};
-                                    esp_ble_mesh_light_client_set_state_t set_state_light = {0};
-
-                                    node_manager().example_ble_mesh_set_msg_common(&common, node_info, lightness_cli.model, ESP_BLE_MESH_MODEL_OP_LIGHT_LIGHTNESS_SET);
-                                    common.ctx.addr = node_info->unicast;
-
-                                    set_state_light.lightness_set.lightness = node_info->hsl_l;
-                                    set_state_light.lightness_set.op_en = false;
-                                    set_state_light.lightness_set.delay = 0;
-                                    set_state_light.lightness_set.tid = store.tid++;
-                                    int err = esp_ble_mesh_light_client_set_state(&common, &set_state_light);
-                                    if (err)
-                                    {
-                                        ESP_LOGE(TAG, "%s: ESP_BLE_MESH_MODEL_OP_LIGHT_LIGHTNESS_SET Set failed", __func__);
-                                    }
-                                },
-                                .opcode = ESP_BLE_MESH_MODEL_OP_LIGHT_LIGHTNESS_SET,
-                                .retries_left = 3,
-                            });
+    message_queue().enqueue(node_info, make_lightness_set(node_info->unicast, node_info->hsl_l));
 }
 
 int ble_mesh_ctl_temperature_set(int argc, char **argv)
@@ -361,7 +274,7 @@ int ble_mesh_ctl_temperature_set(int argc, char **argv)
         return 1;
     }
 
-    if (bm2mqtt_node_info *node_info = node_manager().get_node(0); node_info->unicast != ESP_BLE_MESH_ADDR_UNASSIGNED)
+    if (bm2mqtt_node_info *node_info = node_manager().get_node(0); node_info && node_info->unicast != ESP_BLE_MESH_ADDR_UNASSIGNED)
     {
         esp_ble_mesh_client_common_param_t common = {0};
         esp_ble_mesh_light_client_set_state_t set_state_light = {0};
@@ -50,6 +50,11 @@ static struct esp_ble_mesh_key
     uint8_t app_key[16];
 } prov_key;
 
+const uint8_t *ble_mesh_get_app_key()
+{
+    return prov_key.app_key;
+}
+
 static esp_ble_mesh_cfg_srv_t config_server = {
     /* 3 transmissions with 20ms interval */
     .net_transmit = ESP_BLE_MESH_TRANSMIT(2, 20),
@@ -222,148 +227,47 @@ void Bind_App_Key_queue(bm2mqtt_node_info *node)
     if ((node->features_to_bind & FEATURE_GENERIC_ONOFF) != 0)
     {
         node->features_to_bind &= ~FEATURE_GENERIC_ONOFF; // Clear the feature to avoid rebinding
-
-        message_queue().enqueue(node, message_payload{
-                                          .send = [node]()
-                                          {
-                                              ESP_LOGW(TAG, "[%s] Generic on/off model for node 0x%04X", __func__, node->unicast);
-                                              esp_ble_mesh_client_common_param_t common = {0};
-                                              esp_ble_mesh_cfg_client_set_state_t set_state = {0};
-                                              node_manager().example_ble_mesh_set_msg_common(&common, node, config_client.model, ESP_BLE_MESH_MODEL_OP_MODEL_APP_BIND);
-                                              set_state.model_app_bind.element_addr = node->unicast;
-                                              set_state.model_app_bind.model_app_idx = store.app_idx;
-                                              set_state.model_app_bind.model_id = ESP_BLE_MESH_MODEL_ID_GEN_ONOFF_SRV;
-                                              set_state.model_app_bind.company_id = ESP_BLE_MESH_CID_NVAL;
-                                              esp_err_t err = esp_ble_mesh_config_client_set_state(&common, &set_state);
-                                              if (err)
-                                              {
-                                                  ESP_LOGE(TAG, "%s: call to esp_ble_mesh_config_client_set_state failed", __func__);
-                                              }
-                                          },
-                                          .opcode = ESP_BLE_MESH_MODEL_OP_MODEL_APP_BIND,
-                                          .retries_left = 3,
-                                      });
+        message_queue().enqueue(node, make_model_app_bind(node->unicast, node->unicast, ESP_BLE_MESH_MODEL_ID_GEN_ONOFF_SRV));
     }
 
     if ((node->features_to_bind & FEATURE_LIGHT_HSL) != 0)
     {
         node->features_to_bind &= ~FEATURE_LIGHT_HSL; // Clear the feature to avoid rebinding
-        message_queue().enqueue(node, message_payload{
-                                          .send = [node]()
-                                          {
-                                              ESP_LOGW(TAG, "[%s] Light hsl model for node 0x%04X", __func__, node->unicast);
-                                              esp_ble_mesh_client_common_param_t common = {0};
-                                              esp_ble_mesh_cfg_client_set_state_t set_state = {0};
-                                              node_manager().example_ble_mesh_set_msg_common(&common, node, config_client.model, ESP_BLE_MESH_MODEL_OP_MODEL_APP_BIND);
-                                              common.ctx.addr = node->unicast;
-                                              set_state.model_app_bind.element_addr = node->unicast;
-                                              set_state.model_app_bind.model_app_idx = store.app_idx;
-                                              set_state.model_app_bind.model_id = ESP_BLE_MESH_MODEL_ID_LIGHT_HSL_SRV;
-                                              set_state.model_app_bind.company_id = ESP_BLE_MESH_CID_NVAL;
-                                              esp_err_t err = esp_ble_mesh_config_client_set_state(&common, &set_state);
-                                              if (err)
-                                              {
-                                                  ESP_LOGE(TAG, "%s: call to esp_ble_mesh_config_client_set_state failed", __func__);
-                                              }
-                                          },
-                                          .opcode = ESP_BLE_MESH_MODEL_OP_MODEL_APP_BIND,
-                                          .retries_left = 3,
-                                      });
+        message_queue().enqueue(node, make_model_app_bind(node->unicast, node->unicast, ESP_BLE_MESH_MODEL_ID_LIGHT_HSL_SRV));
     }
 
     if ((node->features_to_bind & FEATURE_LIGHT_LIGHTNESS) != 0)
     {
         node->features_to_bind &= ~FEATURE_LIGHT_LIGHTNESS; // Clear the feature to avoid rebinding
-        message_queue().enqueue(node, message_payload{
-                                          .send = [node]()
-                                          {
-                                              ESP_LOGW(TAG, "[%s] Light lightness model for node 0x%04X", __func__, node->unicast);
-                                              esp_ble_mesh_client_common_param_t common = {0};
-                                              esp_ble_mesh_cfg_client_set_state_t set_state = {0};
-                                              node_manager().example_ble_mesh_set_msg_common(&common, node, config_client.model, ESP_BLE_MESH_MODEL_OP_MODEL_APP_BIND);
-                                              common.ctx.addr = node->unicast;
-                                              set_state.model_app_bind.element_addr = node->unicast;
-                                              set_state.model_app_bind.model_app_idx = store.app_idx;
-                                              set_state.model_app_bind.model_id = ESP_BLE_MESH_MODEL_ID_LIGHT_LIGHTNESS_SRV;
-                                              set_state.model_app_bind.company_id = ESP_BLE_MESH_CID_NVAL;
-                                              esp_err_t err = esp_ble_mesh_config_client_set_state(&common, &set_state);
-                                              if (err)
-                                              {
-                                                  ESP_LOGE(TAG, "%s: call to esp_ble_mesh_config_client_set_state failed", __func__);
-                                              }
-                                          },
-                                          .opcode = ESP_BLE_MESH_MODEL_OP_MODEL_APP_BIND,
-                                          .retries_left = 3,
-                                      });
+        message_queue().enqueue(node, make_model_app_bind(node->unicast, node->unicast, ESP_BLE_MESH_MODEL_ID_LIGHT_LIGHTNESS_SRV));
     }
 
     if ((node->features_to_bind & FEATURE_LIGHT_CTL) != 0)
     {
         node->features_to_bind &= ~FEATURE_LIGHT_CTL; // Clear the feature to avoid rebinding
-        message_queue().enqueue(node, message_payload{
-                                          .send = [node]()
-                                          {
-                                              ESP_LOGW(TAG, "[%s] Light CTL temperature model for node 0x%04X", __func__, node->unicast);
-                                              esp_ble_mesh_client_common_param_t common = {0};
-                                              esp_ble_mesh_cfg_client_set_state_t set_state = {0};
-                                              node_manager().example_ble_mesh_set_msg_common(&common, node, config_client.model, ESP_BLE_MESH_MODEL_OP_MODEL_APP_BIND);
-                                              common.ctx.addr = node->unicast;
-                                              set_state.model_app_bind.element_addr = node->unicast + 1;
-                                              set_state.model_app_bind.model_app_idx = store.app_idx;
-                                              set_state.model_app_bind.model_id = ESP_BLE_MESH_MODEL_ID_LIGHT_CTL_TEMP_SRV;
-                                              set_state.model_app_bind.company_id = ESP_BLE_MESH_CID_NVAL;
-                                              esp_err_t err = esp_ble_mesh_config_client_set_state(&common, &set_state);
-                                              if (err)
-                                              {
-                                                  ESP_LOGE(TAG, "%s: call to esp_ble_mesh_config_client_set_state failed", __func__);
-                                              }
-                                          },
-                                          .opcode = ESP_BLE_MESH_MODEL_OP_MODEL_APP_BIND,
-                                          .retries_left = 3,
-                                      });
-
-        message_queue().enqueue(node, message_payload{
-                                          .send = [node]()
-                                          {
-                                              ESP_LOGW(TAG, "[%s] Light CTL model for node 0x%04X", __func__, node->unicast);
-                                              esp_ble_mesh_client_common_param_t common = {0};
-                                              esp_ble_mesh_cfg_client_set_state_t set_state = {0};
-                                              node_manager().example_ble_mesh_set_msg_common(&common, node, config_client.model, ESP_BLE_MESH_MODEL_OP_MODEL_APP_BIND);
-                                              common.ctx.addr = node->unicast;
-                                              set_state.model_app_bind.element_addr = node->unicast;
-                                              set_state.model_app_bind.model_app_idx = store.app_idx;
-                                              set_state.model_app_bind.model_id = ESP_BLE_MESH_MODEL_ID_LIGHT_CTL_SRV;
-                                              set_state.model_app_bind.company_id = ESP_BLE_MESH_CID_NVAL;
-                                              esp_err_t err = esp_ble_mesh_config_client_set_state(&common, &set_state);
-                                              if (err)
-                                              {
-                                                  ESP_LOGE(TAG, "%s: call to esp_ble_mesh_config_client_set_state failed", __func__);
-                                              }
-                                          },
-                                          .opcode = ESP_BLE_MESH_MODEL_OP_MODEL_APP_BIND,
-                                          .retries_left = 3,
-                                      });
+        message_queue().enqueue(node, make_model_app_bind(node->unicast, node->unicast + 1, ESP_BLE_MESH_MODEL_ID_LIGHT_CTL_TEMP_SRV));
+        message_queue().enqueue(node, make_model_app_bind(node->unicast, node->unicast, ESP_BLE_MESH_MODEL_ID_LIGHT_CTL_SRV));
     }
 
     if (node->features_to_bind == 0)
     {
         ESP_LOGW(TAG, "[%s] All features bound, no more binding needed", __func__);
-        refresh_node(node, nullptr);
-
-        message_queue().enqueue(node, message_payload{
-                                          .send = [node]()
-                                          {
-                                              mqtt_send_discovery(node);
-                                              mqtt_node_send_status(node);
-                                          },
-                                          .opcode = 0x0000, // No specific opcode, just a marker
-                                          .retries_left = 0,
-                                          .type = message_type_t::mqtt_message, // Indicate this is a MQTT message
-                                      });
+        refresh_node(node);
+
+        message_queue().enqueue(node, make_mqtt_marker(node->unicast, mqtt_action_t::discovery_and_status, command_priority_t::configuration));
     }
 }
 
 ////////////////////////////////////////////////////////
+// Statuses the lights publish on their own reach Home Assistant like any other change
+static void publish_if_changed(bm2mqtt_node_info *node)
+{
+    if (node->unpublished != 0)
+    {
+        message_queue().enqueue(node, make_mqtt_marker(node->unicast, mqtt_action_t::status, command_priority_t::background));
+    }
+}
+
 static void ble_mesh_config_client_cb(esp_ble_mesh_cfg_client_cb_event_t event,
                                       esp_ble_mesh_cfg_client_cb_param_t *param)
 {
@@ -389,7 +293,7 @@ static void ble_mesh_config_client_cb(esp_ble_mesh_cfg_client_cb_event_t event,
     switch (event)
     {
     case ESP_BLE_MESH_CFG_CLIENT_GET_STATE_EVT:
-        message_queue().handle_ack(node, opcode);
+        message_queue().handle_ack(node, opcode, addr);
 
         switch (opcode)
         {
@@ -406,7 +310,7 @@ static void ble_mesh_config_client_cb(esp_ble_mesh_cfg_client_cb_event_t event,
         }
         break;
     case ESP_BLE_MESH_CFG_CLIENT_SET_STATE_EVT:
-        message_queue().handle_ack(node, opcode);
+        message_queue().handle_ack(node, opcode, addr);
 
         switch (opcode)
         {
@@ -464,7 +368,7 @@ static void ble_mesh_config_client_cb(esp_ble_mesh_cfg_client_cb_event_t event,
         break;
     case ESP_BLE_MESH_CFG_CLIENT_TIMEOUT_EVT:
 
-        message_queue().handle_timeout(node, opcode);
+        message_queue().handle_timeout(node, opcode, addr);
         // switch (opcode)
         // {
         // case ESP_BLE_MESH_MODEL_OP_COMPOSITION_DATA_GET:
@@ -506,42 +410,24 @@ void on_composition_received(esp_ble_mesh_cfg_client_cb_param_t *param, bm2mqtt_
     if(node->features & FEATURE_LIGHT_LIGHTNESS)
     {
         ESP_LOGW(TAG, "[on_composition_received] Light Lightness feature supported");
-        node->color_mode = color_mode_t::brightness;
+        update_node_field(node, &bm2mqtt_node_info::color_mode, color_mode_t::brightness, FIELD_COLOR_MODE, state_source::assumed);
     }
     
     if(node->features & FEATURE_LIGHT_HSL)
     {
         ESP_LOGW(TAG, "[on_composition_received] Light HSL feature supported");
-        node->color_mode = color_mode_t::hs;
+        update_node_field(node, &bm2mqtt_node_info::color_mode, color_mode_t::hs, FIELD_COLOR_MODE, state_source::assumed);
     }
 
     if(node->features & FEATURE_LIGHT_CTL)
     {
         ESP_LOGW(TAG, "[on_composition_received] Light CTL feature supported");
-        node->color_mode = color_mode_t::color_temp;
+        update_node_field(node, &bm2mqtt_node_info::color_mode, color_mode_t::color_temp, FIELD_COLOR_MODE, state_source::assumed);
     }
 
     if (!get_composition_data_debug)
     {
-        message_queue().enqueue(node, message_payload{
-                                          .send = [node]()
-                                          {
-                                              ESP_LOGW(TAG, "[on_composition_received] Requesting composition for node 0x%04X", node->unicast);
-                                              esp_ble_mesh_client_common_param_t common = {0};
-                                              esp_ble_mesh_cfg_client_set_state_t set_state = {0};
-                                              node_manager().example_ble_mesh_set_msg_common(&common, node, config_client.model, ESP_BLE_MESH_MODEL_OP_APP_KEY_ADD);
-                                              set_state.app_key_add.net_idx = store.net_idx;
-                                              set_state.app_key_add.app_idx = store.app_idx;
-                                              memcpy(set_state.app_key_add.app_key, prov_key.app_key, 16);
-                                              esp_err_t err = esp_ble_mesh_config_client_set_state(&common, &set_state);
-                                              if (err)
-                                              {
-                                                  ESP_LOGE(TAG, "[on_composition_received] Requesting composition failed");
-                                              }
-                                          },
-                                          .opcode = ESP_BLE_MESH_MODEL_OP_APP_KEY_ADD,
-                                          .retries_left = 3,
-                                      });
+        message_queue().enqueue(node, make_app_key_add(node->unicast));
     }
     get_composition_data_debug = false;
 
@@ -578,14 +464,12 @@ static void ble_mesh_generic_client_cb(esp_ble_mesh_generic_client_cb_event_t ev
     {
     case ESP_BLE_MESH_GENERIC_CLIENT_GET_STATE_EVT:
 
-        message_queue().handle_ack(node, opcode);
-
         switch (opcode)
         {
         case ESP_BLE_MESH_MODEL_OP_GEN_ONOFF_GET:
         {
             // esp_ble_mesh_generic_client_set_state_t set_state = {0};
-            node->onoff = param->status_cb.onoff_status.present_onoff;
+            update_node_field(node, &bm2mqtt_node_info::onoff, param->status_cb.onoff_status.present_onoff, FIELD_ONOFF, state_source::ack);
             ESP_LOGI(TAG, "ESP_BLE_MESH_MODEL_OP_GEN_ONOFF_GET onoff: 0x%02x", node->onoff);
         }
         break;
@@ -599,35 +483,42 @@ static void ble_mesh_generic_client_cb(esp_ble_mesh_generic_client_cb_event_t ev
         default:
             break;
         }
+        // After the state update, so the status publish it releases carries the new values
+        message_queue().handle_ack(node, opcode, addr);
         break;
     case ESP_BLE_MESH_GENERIC_CLIENT_SET_STATE_EVT:
-        message_queue().handle_ack(node, opcode);
 
         switch (opcode)
         {
         case ESP_BLE_MESH_MODEL_OP_GEN_ONOFF_SET:
         {
-            node->onoff = param->status_cb.onoff_status.present_onoff;
+            update_node_field(node, &bm2mqtt_node_info::onoff, param->status_cb.onoff_status.present_onoff, FIELD_ONOFF, state_source::ack);
             ESP_LOGI(TAG, "[Ack] OnOff set: 0x%02x", node->onoff);
         }
         break;
         case ESP_BLE_MESH_MODEL_OP_GEN_LEVEL_SET:
         {
-            node->level = param->status_cb.level_status.present_level;
+            update_node_field(node, &bm2mqtt_node_info::level, param->status_cb.level_status.present_level, FIELD_LEVEL, state_source::ack);
             ESP_LOGI(TAG, "[Ack] Level Set: %d", param->status_cb.level_status.present_level);
         }
         break;
         default:
             break;
         }
+        message_queue().handle_ack(node, opcode, addr);
         break;
     case ESP_BLE_MESH_GENERIC_CLIENT_PUBLISH_EVT:
         ESP_LOGI(TAG, "ESP_BLE_MESH_GENERIC_CLIENT_PUBLISH_EVT");
+        if (opcode == ESP_BLE_MESH_MODEL_OP_GEN_ONOFF_STATUS)
+        {
+            update_node_field(node, &bm2mqtt_node_info::onoff, param->status_cb.onoff_status.present_onoff, FIELD_ONOFF, state_source::publish);
+            publish_if_changed(node);
+        }
         break;
     case ESP_BLE_MESH_GENERIC_CLIENT_TIMEOUT_EVT:
         /* If failed to receive the responses, these messages will be resend */
 
-        message_queue().handle_timeout(node, opcode);
+        message_queue().handle_timeout(node, opcode, addr);
         switch (opcode)
         {
         case ESP_BLE_MESH_MODEL_OP_GEN_ONOFF_GET:
@@ -638,7 +529,8 @@ static void ble_mesh_generic_client_cb(esp_ble_mesh_generic_client_cb_event_t ev
         }
         case ESP_BLE_MESH_MODEL_OP_GEN_ONOFF_SET:
         {
-            node->onoff = param->status_cb.onoff_status.present_onoff;
+            // No status came with the timeout, keep the value and let the next refresh poll it
+            confirm_node_fields(node, FIELD_ONOFF, state_source::assumed);
             ESP_LOGW(TAG, "TIMEOUT: OnOFF Set: 0x%02x", node->onoff);
 
             break;
@@ -692,15 +584,13 @@ void ble_mesh_light_client_cb(esp_ble_mesh_light_client_cb_event_t event,
     switch (event)
     {
     case ESP_BLE_MESH_LIGHT_CLIENT_GET_STATE_EVT:
-        message_queue().handle_ack(node, opcode);
-
         switch (opcode)
         {
         case ESP_BLE_MESH_MODEL_OP_LIGHT_HSL_GET:
         {
-            node->hsl_h = param->status_cb.hsl_status.hsl_hue;
-            node->hsl_l = param->status_cb.hsl_status.hsl_lightness;
-            node->hsl_s = param->status_cb.hsl_status.hsl_saturation;
+            update_node_field(node, &bm2mqtt_node_info::hsl_h, param->status_cb.hsl_status.hsl_hue, FIELD_HUE_SATURATION, state_source::ack);
+            update_node_field(node, &bm2mqtt_node_info::hsl_l, param->status_cb.hsl_status.hsl_lightness, FIELD_LIGHTNESS, state_source::ack);
+            update_node_field(node, &bm2mqtt_node_info::hsl_s, param->status_cb.hsl_status.hsl_saturation, FIELD_HUE_SATURATION, state_source::ack);
             ESP_LOGI(TAG, "ESP_BLE_MESH_MODEL_OP_LIGHT_HSL_STATUS h=%d s=%d l=%d", node->hsl_h, node->hsl_s, node->hsl_l);
         }
         break;
@@ -712,10 +602,10 @@ void ble_mesh_light_client_cb(esp_ble_mesh_light_client_cb_event_t event,
                      param->status_cb.hsl_range_status.hue_range_min, param->status_cb.hsl_range_status.hue_range_max,
                      param->status_cb.hsl_range_status.saturation_range_min, param->status_cb.hsl_range_status.saturation_range_max);
 
-                     node->min_hue = param->status_cb.hsl_range_status.hue_range_min;
-                     node->max_hue = param->status_cb.hsl_range_status.hue_range_max;
-                     node->min_saturation = param->status_cb.hsl_range_status.saturation_range_min;
-                     node->max_saturation = param->status_cb.hsl_range_status.saturation_range_max;
+            update_node_field(node, &bm2mqtt_node_info::min_hue, param->status_cb.hsl_range_status.hue_range_min, FIELD_RANGES, state_source::ack);
+            update_node_field(node, &bm2mqtt_node_info::max_hue, param->status_cb.hsl_range_status.hue_range_max, FIELD_RANGES, state_source::ack);
+            update_node_field(node, &bm2mqtt_node_info::min_saturation, param->status_cb.hsl_range_status.saturation_range_min, FIELD_RANGES, state_source::ack);
+            update_node_field(node, &bm2mqtt_node_info::max_saturation, param->status_cb.hsl_range_status.saturation_range_max, FIELD_RANGES, state_source::ack);
         }
         break;
 
@@ -725,7 +615,7 @@ void ble_mesh_light_client_cb(esp_ble_mesh_light_client_cb_event_t event,
                      param->status_cb.lightness_status.present_lightness,
                      param->status_cb.lightness_status.target_lightness,
                      param->status_cb.lightness_status.remain_time);
-            node->hsl_l = param->status_cb.lightness_status.present_lightness;
+            update_node_field(node, &bm2mqtt_node_info::hsl_l, param->status_cb.lightness_status.present_lightness, FIELD_LIGHTNESS, state_source::ack);
         }
         break;
 
@@ -735,14 +625,14 @@ void ble_mesh_light_client_cb(esp_ble_mesh_light_client_cb_event_t event,
             ESP_LOGI(TAG, "ESP_BLE_MESH_MODEL_OP_LIGHT_LIGHTNESS_RANGE_GET lightness_min=%u lightness_max=%u",
                      param->status_cb.lightness_range_status.range_min, param->status_cb.lightness_range_status.range_max);
 
-            node->min_lightness = param->status_cb.lightness_range_status.range_min;
-            node->max_lightness = param->status_cb.lightness_range_status.range_max;
-
+            uint16_t max_lightness = param->status_cb.lightness_range_status.range_max;
             if((node->features & FEATURE_LIGHT_HSL) || (node->features & FEATURE_LIGHT_CTL))
             {
                 // FIX-ME : this is the case for my sengled bulb.
-                node->max_lightness /= 2; // HSL and CTL use half of the lightness range
+                max_lightness /= 2; // HSL and CTL use half of the lightness range
             }
+            update_node_field(node, &bm2mqtt_node_info::min_lightness, param->status_cb.lightness_range_status.range_min, FIELD_RANGES, state_source::ack);
+            update_node_field(node, &bm2mqtt_node_info::max_lightness, max_lightness, FIELD_RANGES, state_source::ack);
         }
         break;
 
@@ -751,7 +641,7 @@ void ble_mesh_light_client_cb(esp_ble_mesh_light_client_cb_event_t event,
             ESP_LOGI(TAG, "ESP_BLE_MESH_MODEL_OP_LIGHT_CTL_TEMPERATURE_GET temp=%u delta_uv=%u",
                      param->status_cb.ctl_temperature_status.present_ctl_temperature, param->status_cb.ctl_temperature_status.present_ctl_delta_uv);
 
-            node->curr_temp = param->status_cb.ctl_temperature_status.present_ctl_temperature;
+            update_node_field(node, &bm2mqtt_node_info::curr_temp, param->status_cb.ctl_temperature_status.present_ctl_temperature, FIELD_TEMPERATURE, state_source::ack);
         }
         break;
 
@@ -760,8 +650,8 @@ void ble_mesh_light_client_cb(esp_ble_mesh_light_client_cb_event_t event,
             ESP_LOGI(TAG, "ESP_BLE_MESH_MODEL_OP_LIGHT_CTL_TEMPERATURE_RANGE_GET range_min=%u range_max=%u",
                      param->status_cb.ctl_temperature_range_status.range_min, param->status_cb.ctl_temperature_range_status.range_max);
 
-            node->min_temp = param->status_cb.ctl_temperature_range_status.range_min;
-            node->max_temp = param->status_cb.ctl_temperature_range_status.range_max;
+            update_node_field(node, &bm2mqtt_node_info::min_temp, param->status_cb.ctl_temperature_range_status.range_min, FIELD_RANGES, state_source::ack);
+            update_node_field(node, &bm2mqtt_node_info::max_temp, param->status_cb.ctl_temperature_range_status.range_max, FIELD_RANGES, state_source::ack);
         }
         break;
 
@@ -780,6 +670,7 @@ void ble_mesh_light_client_cb(esp_ble_mesh_light_client_cb_event_t event,
             break;
         }
 
+        message_queue().handle_ack(node, opcode, addr);
         break;
 
     case ESP_BLE_MESH_LIGHT_CLIENT_SET_STATE_EVT:
@@ -788,10 +679,20 @@ void ble_mesh_light_client_cb(esp_ble_mesh_light_client_cb_event_t event,
             ESP_LOGI("[ble_mesh_light_client_cb] [ESP_BLE_MESH_LIGHT_CLIENT_SET_STATE_EVT]", "Set state response: Error Code : %i", param->error_code);
         }
     
-        message_queue().handle_ack(node, opcode);
+        message_queue().handle_ack(node, opcode, addr);
 
         switch (opcode)
         {
+        // The light took the values the set carried
+        case ESP_BLE_MESH_MODEL_OP_LIGHT_LIGHTNESS_SET:
+            confirm_node_fields(node, FIELD_LIGHTNESS, state_source::ack);
+            break;
+        case ESP_BLE_MESH_MODEL_OP_LIGHT_HSL_SET:
+            confirm_node_fields(node, FIELD_HUE_SATURATION | FIELD_LIGHTNESS, state_source::ack);
+            break;
+        case ESP_BLE_MESH_MODEL_OP_LIGHT_CTL_SET:
+            confirm_node_fields(node, FIELD_TEMPERATURE | FIELD_LIGHTNESS, state_source::ack);
+            break;
         case ESP_BLE_MESH_MODEL_OP_LIGHT_CTL_TEMPERATURE_SET:
         {
             // node->hsl_h = param->status_cb.hsl_status.hsl_hue;
@@ -805,12 +706,29 @@ void ble_mesh_light_client_cb(esp_ble_mesh_light_client_cb_event_t event,
 
     case ESP_BLE_MESH_LIGHT_CLIENT_PUBLISH_EVT:
         ESP_LOGI("LIGHT_CLI", "Publish received");
+        switch (opcode)
+        {
+        case ESP_BLE_MESH_MODEL_OP_LIGHT_LIGHTNESS_STATUS:
+            update_node_field(node, &bm2mqtt_node_info::hsl_l, param->status_cb.lightness_status.present_lightness, FIELD_LIGHTNESS, state_source::publish);
+            break;
+        case ESP_BLE_MESH_MODEL_OP_LIGHT_HSL_STATUS:
+            update_node_field(node, &bm2mqtt_node_info::hsl_h, param->status_cb.hsl_status.hsl_hue, FIELD_HUE_SATURATION, state_source::publish);
+            update_node_field(node, &bm2mqtt_node_info::hsl_s, param->status_cb.hsl_status.hsl_saturation, FIELD_HUE_SATURATION, state_source::publish);
+            update_node_field(node, &bm2mqtt_node_info::hsl_l, param->status_cb.hsl_status.hsl_lightness, FIELD_LIGHTNESS, state_source::publish);
+            break;
+        case ESP_BLE_MESH_MODEL_OP_LIGHT_CTL_TEMPERATURE_STATUS:
+            update_node_field(node, &bm2mqtt_node_info::curr_temp, param->status_cb.ctl_temperature_status.present_ctl_temperature, FIELD_TEMPERATURE, state_source::publish);
+            break;
+        default:
+            break;
+        }
+        publish_if_changed(node);
         break;
 
     case ESP_BLE_MESH_LIGHT_CLIENT_TIMEOUT_EVT:
         ESP_LOGE("LIGHT_CLI", "Timeout event received for opcode 0x%04" PRIx32, opcode);
 
-        message_queue().handle_timeout(node, opcode);
+        message_queue().handle_timeout(node, opcode, addr);
         break;
 
     default:
@@ -874,141 +792,132 @@ void refresh_all_nodes()
     {
         if (bm2mqtt_node_info *node_info = node_manager().get_or_create(node->dev_uuid))
         {
-            refresh_node(node_info, node);
+            node_manager().update_address(node_info, node, node_index);
+            refresh_node(node_info);
         }
     });
 }
 
-void refresh_node(bm2mqtt_node_info *node_info, const esp_ble_mesh_node_t *node)
+// GETs for the stale attributes among fields the node has, then its status once they are answered
+static size_t poll_node_fields(bm2mqtt_node_info *node_info, uint8_t stale)
 {
-    ESP_LOGI(TAG, "[%s] Refreshing node 0x%04X", __func__, node_info->unicast);
-    if (node != nullptr)
+    size_t gets = 0;
+    const auto get = [node_info, &gets](uint16_t addr, uint32_t opcode)
     {
-        node_info->uuid = Uuid128{node->dev_uuid};
-        node_info->unicast = node->unicast_addr;
-        node_info->elem_num = node->element_num;
-    }
+        message_queue().enqueue(node_info, make_mesh_get(addr, opcode));
+        gets++;
+    };
 
-    if (node_info->features & FEATURE_GENERIC_ONOFF)
+    if ((node_info->features & FEATURE_GENERIC_ONOFF) && (stale & FIELD_ONOFF))
     {
         ESP_LOGI(TAG, "[%s] Refreshing ON/OFF for node 0x%04X", __func__, node_info->unicast);
-
-        message_queue().enqueue(node_info, message_payload{
-                                               .send = [node_info]()
-                                               {
-                                                   ESP_LOGW(TAG, "[%s] Generic on/off model for node 0x%04X", __func__, node_info->unicast);
-                                                   esp_ble_mesh_client_common_param_t common = {0};
-                                                   esp_ble_mesh_generic_client_get_state_t get_state = {0};
-                                                   node_manager().example_ble_mesh_set_msg_common(&common, node_info, onoff_client.model, ESP_BLE_MESH_MODEL_OP_GEN_ONOFF_GET);
-                                                   int err = esp_ble_mesh_generic_client_get_state(&common, &get_state);
-                                                   if (err)
-                                                   {
-                                                       ESP_LOGE(TAG, "%s: Generic OnOff Get failed", __func__);
-                                                       return;
-                                                   }
-                                               },
-                                               .opcode = ESP_BLE_MESH_MODEL_OP_GEN_ONOFF_GET,
-                                               .retries_left = 3,
-                                           });
+        get(node_info->unicast, ESP_BLE_MESH_MODEL_OP_GEN_ONOFF_GET);
     }
 
     if (node_info->features & FEATURE_LIGHT_HSL)
     {
+        // The HSL status carries the lightness as well
+        if (stale & (FIELD_HUE_SATURATION | FIELD_LIGHTNESS))
         {
-            message_queue().enqueue(node_info, message_payload{
-                                                   .send = [node_info]()
-                                                   {
-                                                       ESP_LOGW(TAG, "[%s] Light HSL model for node 0x%04X", __func__, node_info->unicast);
-                                                       esp_ble_mesh_client_common_param_t common = {0};
-                                                       esp_ble_mesh_light_client_get_state_t get_state_light = {0};
-                                                       node_manager().example_ble_mesh_set_msg_common(&common, node_info, hsl_cli.model, ESP_BLE_MESH_MODEL_OP_LIGHT_HSL_GET);
-                                                       int err = esp_ble_mesh_light_client_get_state(&common, &get_state_light);
-                                                       if (err)
-                                                       {
-                                                           ESP_LOGE(TAG, "%s: Refreshing HSL failed", __func__);
-                                                           return;
-                                                       }
-                                                   },
-                                                   .opcode = ESP_BLE_MESH_MODEL_OP_LIGHT_HSL_GET,
-                                                   .retries_left = 3,
-                                               });
-        }
-        {
-            message_queue().enqueue(node_info, message_payload{
-                                                   .send = [node_info]()
-                                                   {
-                                                       ESP_LOGW(TAG, "[%s] HSL range for node 0x%04X", __func__, node_info->unicast);
-                                                       ble_mesh_hsl_range_get(node_info);
-                                                   },
-                                                   .opcode = ESP_BLE_MESH_MODEL_OP_LIGHT_HSL_RANGE_GET,
-                                                   .retries_left = 3,
-                                               });
+            get(node_info->unicast, ESP_BLE_MESH_MODEL_OP_LIGHT_HSL_GET);
+            stale &= ~FIELD_LIGHTNESS;
         }
+        if (stale & FIELD_RANGES)
+            get(node_info->unicast, ESP_BLE_MESH_MODEL_OP_LIGHT_HSL_RANGE_GET);
     }
-    
-    if(node_info->features & FEATURE_LIGHT_LIGHTNESS)
+
+    if (node_info->features & FEATURE_LIGHT_LIGHTNESS)
     {
-        message_queue().enqueue(node_info, message_payload{
-                                                   .send = [node_info]()
-                                                   {
-                                                       ESP_LOGW(TAG, "[%s] Light lightness model for node 0x%04X", __func__, node_info->unicast);
-                                                       esp_ble_mesh_client_common_param_t common = {0};
-                                                       esp_ble_mesh_light_client_get_state_t get_state_light = {0};
-                                                       node_manager().example_ble_mesh_set_msg_common(&common, node_info, lightness_cli.model, ESP_BLE_MESH_MODEL_OP_LIGHT_LIGHTNESS_GET);
-                                                       int err = esp_ble_mesh_light_client_get_state(&common, &get_state_light);
-                                                       if (err)
-                                                       {
-                                                           ESP_LOGE(TAG, "%s: Refreshing Lightness failed", __func__);
-                                                           return;
-                                                       }
-                                                   },
-                                                   .opcode = ESP_BLE_MESH_MODEL_OP_LIGHT_LIGHTNESS_GET,
-                                                   .retries_left = 3,
-                                               });
-        message_queue().enqueue(node_info, message_payload{
-                                                   .send = [node_info]()
-                                                   {
-                                                       ESP_LOGW(TAG, "[%s] Light lightness range for node 0x%04X", __func__, node_info->unicast);
-                                                       ble_mesh_lightness_range_get(node_info);
-                                                   },
-                                                   .opcode = ESP_BLE_MESH_MODEL_OP_LIGHT_LIGHTNESS_RANGE_GET,
-                                                   .retries_left = 3,
-                                               });
+        if (stale & FIELD_LIGHTNESS)
+            get(node_info->unicast, ESP_BLE_MESH_MODEL_OP_LIGHT_LIGHTNESS_GET);
+        if (stale & FIELD_RANGES)
+            get(node_info->unicast, ESP_BLE_MESH_MODEL_OP_LIGHT_LIGHTNESS_RANGE_GET);
     }
 
     if (node_info->features & FEATURE_LIGHT_CTL)
     {
-        message_queue().enqueue(node_info, message_payload{
-                                               .send = [node_info]()
-                                               {
-                                                   ESP_LOGW(TAG, "[%s] Refreshing Temperature Range for node 0x%04X", __func__, node_info->unicast);
-                                                   ble_mesh_ctl_temperature_range_get(node_info);
-                                               },
-                                               .opcode = ESP_BLE_MESH_MODEL_OP_LIGHT_CTL_TEMPERATURE_RANGE_GET,
-                                               .retries_left = 3,
-                                           });
-
-        message_queue().enqueue(node_info, message_payload{
-                                               .send = [node_info]()
-                                               {
-                                                   ESP_LOGI(TAG, "[%s] Refreshing CTL Temperature for node 0x%04X", __func__, node_info->unicast);
-
-                                                   ble_mesh_ctl_temperature_get(node_info);
-                                               },
-                                               .opcode = ESP_BLE_MESH_MODEL_OP_LIGHT_CTL_TEMPERATURE_GET,
-                                               .retries_left = 3,
-                                           });
+        if (stale & FIELD_RANGES)
+            get(node_info->unicast, ESP_BLE_MESH_MODEL_OP_LIGHT_CTL_TEMPERATURE_RANGE_GET);
+        if (stale & FIELD_TEMPERATURE)
+            get(node_info->unicast + node_info->light_ctl_temp_offset, ESP_BLE_MESH_MODEL_OP_LIGHT_CTL_TEMPERATURE_GET);
     }
 
-    message_queue().enqueue(node_info, message_payload{
-                                           .send = [node_info]()
-                                           {
-                                               mqtt_node_send_status(node_info);
-                                           },
-                                           .opcode = 0x0000, // No specific opcode, just a marker
-                                           .retries_left = 0,
-                                           .type = message_type_t::mqtt_message, // Indicate this is a MQTT message
-                                       });
+    message_queue().enqueue(node_info, make_mqtt_marker(node_info->unicast, mqtt_action_t::status, command_priority_t::background));
+    return gets;
+}
+
+size_t request_node_state(bm2mqtt_node_info *node_info, uint8_t fields, uint32_t max_age_s)
+{
+    return poll_node_fields(node_info, stale_node_fields(node_info, fields, max_age_s));
+}
+
+size_t refresh_node(bm2mqtt_node_info *node_info)
+{
+    ESP_LOGI(TAG, "[%s] Refreshing node 0x%04X", __func__, node_info->unicast);
+
+    // Ranges do not change once received
+    const uint8_t stale = stale_node_fields(node_info, FIELD_LIGHT_STATE, CONFIG_BM2MQTT_STATE_MAX_AGE_S) |
+                          stale_node_fields(node_info, FIELD_RANGES, UINT32_MAX);
+    const size_t gets = poll_node_fields(node_info, stale);
+    ESP_LOGI(TAG, "[%s] Node 0x%04X: %zu GETs for stale attributes 0x%02X", __func__, node_info->unicast, gets, stale);
+    return gets;
+}
+
+void publish_all_node_status()
+{
+    node_manager().mark_all_unpublished();
+    for_each_provisioned_node([](const esp_ble_mesh_node_t *node, int node_index)
+    {
+        bm2mqtt_node_info *node_info = node_manager().get_node(Uuid128(node->dev_uuid));
+        if (node_info && get_field_source(node_info, FIELD_ONOFF) != state_source::none)
+        {
+            message_queue().enqueue(node_info, make_mqtt_marker(node_info->unicast, mqtt_action_t::status, command_priority_t::interactive));
+        }
+    });
+}
+
+#if CONFIG_BM2MQTT_WARM_START
+static wheel_timer warm_start_timer;
+static uint16_t warm_start_cursor = 0;
+
+// Refreshes the next node of the provisioner table with something stale, one per tick
+static void warm_start_sweep_callback(void *arg)
+{
+    while (warm_start_cursor < CONFIG_BLE_MESH_MAX_PROV_NODES)
+    {
+        const esp_ble_mesh_node_t *entry = esp_ble_mesh_provisioner_get_node_table_entry()[warm_start_cursor++];
+        bm2mqtt_node_info *node_info = entry ? node_manager().get_node(Uuid128(entry->dev_uuid)) : nullptr;
+        if (node_info && refresh_node(node_info) > 0)
+        {
+            return;
+        }
+    }
+    timer_wheel().stop(warm_start_timer);
+    ESP_LOGI(TAG, "[%s] Warm start sweep done", __func__);
+}
+#endif
+
+void start_nodes()
+{
+#if CONFIG_BM2MQTT_WARM_START
+    // The state restored from NVS is published once MQTT connects, the lights only confirm it
+    ESP_LOGI(TAG, "[%s] Warm start, verifying one node every %d ms", __func__, CONFIG_BM2MQTT_WARM_START_SWEEP_MS);
+    for_each_provisioned_node([](const esp_ble_mesh_node_t *node, int node_index)
+    {
+        if (bm2mqtt_node_info *node_info = node_manager().get_or_create(node->dev_uuid))
+        {
+            node_manager().update_address(node_info, node, node_index);
+        }
+    });
+    warm_start_cursor = 0;
+    if (!warm_start_timer.callback)
+    {
+        timer_wheel().init_timer(warm_start_timer, &warm_start_sweep_callback, nullptr, "warm_start_sweep");
+    }
+    timer_wheel().start_periodic(warm_start_timer, CONFIG_BM2MQTT_WARM_START_SWEEP_MS * 1000ull);
+#else
+    refresh_all_nodes();
+#endif
 }
 
 typedef struct
@@ -1067,6 +976,40 @@ int print_registered_nodes(int argc, char **argv)
     return 0;
 }
 
+static struct
+{
+    struct arg_int *node_index;
+    struct arg_int *max_age;
+    struct arg_end *end;
+} request_state_args;
+
+int request_state_cmd(int argc, char **argv)
+{
+    int nerrors = arg_parse(argc, argv, (void **)&request_state_args);
+    if (nerrors != 0)
+    {
+        arg_print_errors(stderr, request_state_args.end, argv[0]);
+        return 1;
+    }
+
+    bm2mqtt_node_info *node_info = node_manager().get_node(request_state_args.node_index->ival[0]);
+    if (!node_info || node_info->unicast == ESP_BLE_MESH_ADDR_UNASSIGNED)
+    {
+        return 1;
+    }
+
+    const uint32_t max_age_s = request_state_args.max_age->count > 0 ? request_state_args.max_age->ival[0] : CONFIG_BM2MQTT_STATE_MAX_AGE_S;
+    const size_t gets = request_node_state(node_info, FIELD_ALL, max_age_s);
+    ESP_LOGI(TAG, "Node 0x%04X: %zu GETs for state older than %" PRIu32 " s", node_info->unicast, gets, max_age_s);
+    return 0;
+}
+
+int print_node_store_stats(int argc, char **argv)
+{
+    node_manager().print_store_stats();
+    return 0;
+}
+
 void RegisterBleMeshDebugCommands()
 {
     /* Register commands */
@@ -1091,6 +1034,27 @@ void RegisterBleMeshDebugCommands()
         .argtable = &ctl_bool_set_args,
     };
     ESP_ERROR_CHECK(register_console_command(&print_nodes_cmd));
+
+    const esp_console_cmd_t node_store_stats_cmd = {
+        .command = "node_store_stats",
+        .help = "Print the NVS writes of the node records and what whole table rewrites would have cost",
+        .hint = NULL,
+        .func = &print_node_store_stats,
+    };
+    ESP_ERROR_CHECK(register_console_command(&node_store_stats_cmd));
+
+    request_state_args.node_index = arg_int1("n", "node", "<node_index>", "Node index as reported by prov_list_nodes command");
+    request_state_args.max_age = arg_int0("a", "age", "<max_age_s>", "Oldest confirmation accepted, CONFIG_BM2MQTT_STATE_MAX_AGE_S by default");
+    request_state_args.end = arg_end(2);
+
+    const esp_console_cmd_t request_state_cmd_def = {
+        .command = "ble_mesh_request_state",
+        .help = "Poll the attributes of a node not confirmed within an age, then publish its status",
+        .hint = NULL,
+        .func = &request_state_cmd,
+        .argtable = &request_state_args,
+    };
+    ESP_ERROR_CHECK(register_console_command(&request_state_cmd_def));
 }
 
 REGISTER_DEBUG_COMMAND(RegisterBleMeshDebugCommands);
\ No newline at end of file
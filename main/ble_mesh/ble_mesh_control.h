@@ -14,9 +14,18 @@ long map(long x, long in_min, long in_max, long out_min, long out_max);
 
 
 esp_err_t ble_mesh_init(void);
+const uint8_t *ble_mesh_get_app_key();
 void on_composition_received(esp_ble_mesh_cfg_client_cb_param_t *param, bm2mqtt_node_info *node);
 void refresh_all_nodes();
-void refresh_node(bm2mqtt_node_info *node_info, const esp_ble_mesh_node_t *node);
+// Boot: warm start from the stored state (CONFIG_BM2MQTT_WARM_START) or a refresh of every node
+void start_nodes();
+// Publishes the cached state of every node with a known one, after a reboot or a broker reconnect
+void publish_all_node_status();
+// Polls what is stale of the node's light state and ranges, returns the GETs queued
+size_t refresh_node(bm2mqtt_node_info *node_info);
+// Polls the attributes of fields (FIELD_*) the light has not confirmed in the last max_age_s and
+// publishes its status once they are answered. Returns the GETs queued, 0 when all are fresh.
+size_t request_node_state(bm2mqtt_node_info *node_info, uint8_t fields, uint32_t max_age_s);
 void RegisterBleMeshDebugCommands();
 
 void ble_mesh_set_provisioning_enabled(bool enabled_value);
\ No newline at end of file
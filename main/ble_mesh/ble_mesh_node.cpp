@@ -14,6 +14,10 @@
 #include "ble_mesh_example_init.h"
 
 #include "ble_mesh_provisioning.h"
+#include "message_queue.h"
+#include "mqtt/mqtt_bridge.h"
+#include <algorithm>
+#include <bit>
 #include <mutex>
 
 #define TAG "NODE_MANAGER"
@@ -35,18 +39,82 @@ const char *get_color_mode_string(color_mode_t mode)
     }
 }
 
-uint16_t get_node_index(Uuid128 uuid)
+const char *get_state_source_string(state_source source)
 {
-    for (int i = 0; i < CONFIG_BLE_MESH_MAX_PROV_NODES; i++)
+    switch (source)
     {
-        const esp_ble_mesh_node_t *node = esp_ble_mesh_provisioner_get_node_table_entry()[i];
-        if (node != nullptr && Uuid128(node->dev_uuid) == uuid)
-        {
-            return i;
-        }
+    case state_source::none:
+        return "none";
+    case state_source::stored:
+        return "stored";
+    case state_source::assumed:
+        return "assumed";
+    case state_source::ack:
+        return "ack";
+    case state_source::publish:
+        return "publish";
+    default:
+        return "unknown";
+    }
+}
+
+static uint32_t uptime_s()
+{
+    return esp_timer_get_time() / 1000000;
+}
+
+state_source get_field_source(const bm2mqtt_node_info *node, node_field_t field)
+{
+    return node->confirmed_by[std::countr_zero(static_cast<unsigned>(field))];
+}
+
+void confirm_node_fields(bm2mqtt_node_info *node, uint8_t fields, state_source source)
+{
+    const uint32_t now_s = uptime_s();
+    for (uint8_t bits = fields & FIELD_ALL; bits != 0; bits &= bits - 1)
+    {
+        const int field = std::countr_zero(bits);
+        node->confirmed_s[field] = now_s;
+        node->confirmed_by[field] = source;
+    }
+}
+
+uint8_t stale_node_fields(const bm2mqtt_node_info *node, uint8_t fields, uint32_t max_age_s)
+{
+    const uint32_t now_s = uptime_s();
+    uint8_t stale = 0;
+    for (uint8_t bits = fields & FIELD_ALL; bits != 0; bits &= bits - 1)
+    {
+        const int field = std::countr_zero(bits);
+        const state_source source = node->confirmed_by[field];
+        if (source == state_source::none || source == state_source::assumed || now_s - node->confirmed_s[field] >= max_age_s)
+            stale |= 1 << field;
+    }
+    return stale;
+}
+
+// Provisioner table entry at the node's node_index, nullptr if it holds another node
+static const esp_ble_mesh_node_t *indexed_prov_node(const bm2mqtt_node_info *node)
+{
+    if (node->node_index >= CONFIG_BLE_MESH_MAX_PROV_NODES)
+        return nullptr;
+
+    const esp_ble_mesh_node_t *entry = esp_ble_mesh_provisioner_get_node_table_entry()[node->node_index];
+    return entry != nullptr && Uuid128(entry->dev_uuid) == node->uuid ? entry : nullptr;
+}
+
+const esp_ble_mesh_node_t *get_prov_node(const bm2mqtt_node_info *node)
+{
+    if (const esp_ble_mesh_node_t *entry = indexed_prov_node(node))
+    {
+        return entry;
     }
+    return esp_ble_mesh_provisioner_get_node_with_uuid(node->uuid.raw());
+}
 
-    return std::numeric_limits<uint16_t>::max(); // Return max value if not found
+const char *get_prov_node_name(const bm2mqtt_node_info *node)
+{
+    return indexed_prov_node(node) ? esp_ble_mesh_provisioner_get_node_name(node->node_index) : nullptr;
 }
 
 ble2mqtt_node_manager &node_manager()
@@ -57,44 +125,51 @@ ble2mqtt_node_manager &node_manager()
 
 extern struct example_info_store store;
 
-void ble2mqtt_node_manager::for_each_node(std::function<void(const bm2mqtt_node_info *)> func)
+bm2mqtt_node_info *ble2mqtt_node_manager::next_node(size_t &index, bool provisioned_only)
 {
     std::lock_guard<std::mutex> lock(tn_mutex);
-    for (auto i = 0; i < tracked_nodes.size(); i++)
+    for (index = tracked_nodes.next_used(index); index < tracked_nodes.capacity(); index = tracked_nodes.next_used(index + 1))
     {
-        if (tracked_nodes[i].unicast != ESP_BLE_MESH_ADDR_UNASSIGNED)
-        {
-            func(&tracked_nodes[i]);
-        }
+        bm2mqtt_node_info *node = tracked_nodes.at(index);
+        if (!provisioned_only || node->unicast != ESP_BLE_MESH_ADDR_UNASSIGNED)
+            return node;
     }
+    return nullptr;
 }
 
-bm2mqtt_node_info *ble2mqtt_node_manager::get_node(const Uuid128 &uuid)
+void ble2mqtt_node_manager::for_each_node(std::function<void(const bm2mqtt_node_info *)> func)
 {
-    std::lock_guard<std::mutex> lock(tn_mutex);
-    for (auto i = 0; i < tracked_nodes.size(); i++)
+    size_t index = 0;
+    while (const bm2mqtt_node_info *node = next_node(index, true))
     {
-        if (tracked_nodes[i].uuid == uuid)
-        {
-            return &tracked_nodes[i];
-        }
+        func(node);
+        index++;
     }
-    return nullptr;
+}
+
+bm2mqtt_node_info *ble2mqtt_node_manager::get_node(const Uuid128 &uuid)
+{
+    std::lock_guard<std::mutex> lock(tn_mutex);
+    return tracked_nodes.at(index.find(uuid));
 }
 bm2mqtt_node_info *ble2mqtt_node_manager::get_or_create(const Uuid128 &uuid)
 {
     std::lock_guard<std::mutex> lock(tn_mutex);
-    for (auto i = 0; i < tracked_nodes.size(); i++)
+    if (bm2mqtt_node_info *node = tracked_nodes.at(index.find(uuid)))
     {
-        if (tracked_nodes[i].uuid == uuid)
-        {
-            return &tracked_nodes[i];
-        }
+        return node;
     }
 
-    tracked_nodes.emplace_back().uuid = uuid;
+    bm2mqtt_node_info *node = tracked_nodes.allocate();
+    if (!node)
+    {
+        ESP_LOGE(TAG, "%s: No room for node %s, %zu nodes tracked", __func__, uuid.to_string().c_str(), tracked_nodes.size());
+        return nullptr;
+    }
+    node->uuid = uuid;
+    index.insert(tracked_nodes.handle_of(node).index, uuid);
 
-    return &tracked_nodes.back();
+    return node;
 }
 
 bm2mqtt_node_info *ble2mqtt_node_manager::get_or_create(const uint8_t uuid[16])
@@ -105,47 +180,98 @@ bm2mqtt_node_info *ble2mqtt_node_manager::get_or_create(const uint8_t uuid[16])
 
 bm2mqtt_node_info *ble2mqtt_node_manager::get_node(int nodeIndex)
 {
-    return &tracked_nodes[nodeIndex];
+    std::lock_guard<std::mutex> lock(tn_mutex);
+    return tracked_nodes.at(nodeIndex);
 }
 
-bm2mqtt_node_info *ble2mqtt_node_manager::get_node(const std::string &mac)
+bm2mqtt_node_info *ble2mqtt_node_manager::get_node(node_handle handle)
 {
-    bm2mqtt_node_info *result = nullptr;
-    for_each_provisioned_node([&mac, &result, this](const esp_ble_mesh_node_t *node, int node_index)
-                              {
-            const std::string inAddr {bt_hex(node->addr, BD_ADDR_LEN)};
-            if (inAddr == mac)
-            {
-                std::lock_guard<std::mutex> lock(tn_mutex);
-                for (auto i = 0; i < tracked_nodes.size(); i++)
-                {
-                    if (memcmp(tracked_nodes[i].uuid.raw(), node->dev_uuid, 16) == 0)
-                    {
-                        result =  &tracked_nodes[i];
-                    }
-                }
-            } });
+    std::lock_guard<std::mutex> lock(tn_mutex);
+    return tracked_nodes.get(handle);
+}
 
-    return result;
+node_handle ble2mqtt_node_manager::get_handle(const bm2mqtt_node_info *node)
+{
+    std::lock_guard<std::mutex> lock(tn_mutex);
+    return tracked_nodes.handle_of(node);
+}
+
+bm2mqtt_node_info *ble2mqtt_node_manager::get_node(std::string_view mac)
+{
+    uint64_t key;
+    if (!mac_key_from_hex(mac, &key))
+    {
+        return nullptr;
+    }
+
+    std::lock_guard<std::mutex> lock(tn_mutex);
+    return tracked_nodes.at(index.find_mac(key));
 }
 
 void ble2mqtt_node_manager::remove_node(const Uuid128 &uuid)
 {
     ESP_LOGW(TAG, "%s: Removing node with UUID %s", __func__, uuid.to_string().c_str());
     std::lock_guard<std::mutex> lock(tn_mutex);
-    for (std::vector<bm2mqtt_node_info>::iterator it = tracked_nodes.begin(); it != tracked_nodes.end(); ++it)
+    const uint16_t slot = index.find(uuid);
+    if (const bm2mqtt_node_info *node = tracked_nodes.at(slot))
     {
-        if ((it->uuid) == uuid)
+        ESP_LOGW(TAG, "%s: Remove unprovisioned device 0x%04x", __func__, node->unicast);
+        index.erase(slot);
+        if (persisted_node &p = persisted[slot]; p.id != persisted_node::no_id)
         {
-            ESP_LOGW(TAG, "%s: Remove unprovisioned device 0x%04x", __func__, it->unicast);
-            it = tracked_nodes.erase(it);
-            break;
+            removed_record_ids.push_back(p.id);
+            record_ids_changed = true;
+        }
+        persisted[slot] = persisted_node{};
+        if (slot < topics.size())
+        {
+            topics[slot] = node_topics{};
         }
+        tracked_nodes.release(node);
     }
 
     mark_node_info_dirty();
 }
 
+void ble2mqtt_node_manager::update_address(bm2mqtt_node_info *node, const esp_ble_mesh_node_t *prov_node, uint16_t node_index)
+{
+    std::lock_guard<std::mutex> lock(tn_mutex);
+    node->unicast = prov_node->unicast_addr;
+    node->elem_num = prov_node->element_num;
+    node->node_index = node_index;
+    index_node(node);
+}
+
+void ble2mqtt_node_manager::index_node(const bm2mqtt_node_info *node)
+{
+    const uint16_t slot = tracked_nodes.handle_of(node).index;
+    index.set_address(slot, node->unicast, node->elem_num);
+    if (const esp_ble_mesh_node_t *prov_node = get_prov_node(node))
+    {
+        index.set_mac(slot, mac_key(prov_node->addr));
+        if (slot < topics.size() && topics[slot].empty())
+        {
+            topics[slot] = make_node_topics(get_bridge_base_topic(), prov_node->addr);
+        }
+    }
+}
+
+node_topics ble2mqtt_node_manager::get_topics(const bm2mqtt_node_info *node)
+{
+    std::lock_guard<std::mutex> lock(tn_mutex);
+    const slab_handle handle = tracked_nodes.handle_of(node);
+    return handle.valid() && handle.index < topics.size() ? topics[handle.index] : node_topics{};
+}
+
+void ble2mqtt_node_manager::rebuild_index()
+{
+    index.clear();
+    tracked_nodes.for_each([this](const bm2mqtt_node_info &node)
+                           {
+        index.insert(tracked_nodes.handle_of(&node).index, node.uuid);
+        index_node(&node); });
+}
+
 esp_err_t ble2mqtt_node_manager::example_ble_mesh_set_msg_common(esp_ble_mesh_client_common_param_t *common,
                                                                  bm2mqtt_node_info *node,
                                                                  esp_ble_mesh_model_t *model, uint32_t opcode)
@@ -161,7 +287,7 @@ esp_err_t ble2mqtt_node_manager::example_ble_mesh_set_msg_common(esp_ble_mesh_cl
     common->ctx.app_idx = store.app_idx;
     common->ctx.addr = node->unicast;
     common->ctx.send_ttl = MSG_SEND_TTL;
-    common->msg_timeout = MSG_TIMEOUT;
+    common->msg_timeout = message_queue().get_msg_timeout_ms(node);
 
     return ESP_OK;
 }
@@ -175,44 +301,42 @@ esp_err_t ble2mqtt_node_manager::store_node_info(const Uuid128 &uuid, uint16_t u
     }
 
     bm2mqtt_node_info *node = get_or_create(uuid);
-    node->unicast = unicast;
-    node->elem_num = elem_num;
-    save_node_info_vector();
+    if (!node)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    {
+        std::lock_guard<std::mutex> lock(tn_mutex);
+        node->unicast = unicast;
+        node->elem_num = elem_num;
+        node->node_index = node_index;
+        index_node(node);
+    }
+    save_node_records(false);
 
     return ESP_OK;
 }
 
 bm2mqtt_node_info *ble2mqtt_node_manager::get_node(uint16_t unicast)
 {
-    int i;
-
     if (!ESP_BLE_MESH_ADDR_IS_UNICAST(unicast))
     {
         return nullptr;
     }
 
     std::lock_guard<std::mutex> lock(tn_mutex);
-    for (i = 0; i < tracked_nodes.size(); i++)
-    {
-        if (tracked_nodes[i].unicast <= unicast &&
-            tracked_nodes[i].unicast + tracked_nodes[i].elem_num > unicast)
-        {
-            return &tracked_nodes[i];
-        }
-    }
-
-    return nullptr;
+    return tracked_nodes.at(index.find_unicast(unicast));
 }
 
 void ble2mqtt_node_manager::print_registered_nodes()
 {
-    std::lock_guard<std::mutex> lock(tn_mutex);
-    ESP_LOGI(TAG, "Provisioned nodes: %d", tracked_nodes.size());
-    for (const auto &node : tracked_nodes)
+    ESP_LOGI(TAG, "Provisioned nodes: %zu", tracked_nodes.size());
+    size_t index = 0;
+    for (const bm2mqtt_node_info *node_ptr; (node_ptr = next_node(index, false)) != nullptr; index++)
     {
+        const bm2mqtt_node_info &node = *node_ptr;
         // Get the node name from the provisioner
-        uint16_t node_index = get_node_index(node.uuid); // Ensure node_index is set
-        const char* node_name = esp_ble_mesh_provisioner_get_node_name(node_index);
+        const char* node_name = get_prov_node_name(&node);
         if (!node_name) {
             node_name = "Unknown";
         }
@@ -232,39 +356,269 @@ void ble2mqtt_node_manager::print_registered_nodes()
         ESP_LOGI(TAG, "  Light CTL Temp Offset: %d", node.light_ctl_temp_offset);
         ESP_LOGI(TAG, "  Features: 0x%04X", node.features);
         ESP_LOGI(TAG, "  Features to Bind: 0x%04X", node.features_to_bind);
+        static constexpr const char *field_names[NODE_FIELD_COUNT] = {"onoff", "lightness", "hue/sat", "temperature", "level", "color mode", "ranges"};
+        for (size_t field = 0; field < NODE_FIELD_COUNT; field++)
+        {
+            if (node.confirmed_by[field] != state_source::none)
+                ESP_LOGI(TAG, "  Confirmed %s: %" PRIu32 " s ago (%s)", field_names[field],
+                         uptime_s() - node.confirmed_s[field], get_state_source_string(node.confirmed_by[field]));
+        }
     }
 }
 
-esp_err_t ble2mqtt_node_manager::save_node_info_vector()
+// Layouts of the schema 1 and 2 blobs, only read to migrate them to records
+struct legacy_node_blob_v1
 {
-    nvs_handle_t handle;
-    esp_err_t err = nvs_open("ble_mesh", NVS_READWRITE, &handle);
+    Uuid128 uuid;
+    uint16_t unicast, hsl_h, min_hue, max_hue, hsl_s, min_saturation, max_saturation;
+    uint16_t hsl_l, min_lightness, max_lightness, curr_temp, min_temp, max_temp;
+    int16_t level;
+    uint16_t features, features_to_bind;
+    uint8_t elem_num, onoff, light_ctl_temp_offset;
+    color_mode_t color_mode;
+};
+
+struct legacy_node_blob_v2
+{
+    Uuid128 uuid;
+    uint16_t unicast, hsl_h, min_hue, max_hue, hsl_s, min_saturation, max_saturation;
+    uint16_t hsl_l, min_lightness, max_lightness, curr_temp, min_temp, max_temp;
+    int16_t level;
+    uint16_t features, features_to_bind, node_index;
+    uint8_t elem_num, onoff, light_ctl_temp_offset;
+    color_mode_t color_mode;
+};
+
+static_assert(sizeof(legacy_node_blob_v1) == 52 && sizeof(legacy_node_blob_v2) == 54, "legacy layouts are frozen");
+
+template <typename Blob>
+static void convert_legacy_blob(const Blob &blob, bm2mqtt_node_info &node)
+{
+    node.uuid = blob.uuid;
+    node.unicast = blob.unicast;
+    node.hsl_h = blob.hsl_h;
+    node.min_hue = blob.min_hue;
+    node.max_hue = blob.max_hue;
+    node.hsl_s = blob.hsl_s;
+    node.min_saturation = blob.min_saturation;
+    node.max_saturation = blob.max_saturation;
+    node.hsl_l = blob.hsl_l;
+    node.min_lightness = blob.min_lightness;
+    node.max_lightness = blob.max_lightness;
+    node.curr_temp = blob.curr_temp;
+    node.min_temp = blob.min_temp;
+    node.max_temp = blob.max_temp;
+    node.level = blob.level;
+    node.features = blob.features;
+    node.features_to_bind = blob.features_to_bind;
+    node.elem_num = blob.elem_num;
+    node.onoff = blob.onoff;
+    node.light_ctl_temp_offset = blob.light_ctl_temp_offset;
+    node.color_mode = blob.color_mode;
+}
+
+template <typename Blob>
+static esp_err_t read_legacy_blob(nvs_handle_t handle, size_t size, std::vector<bm2mqtt_node_info> &nodes)
+{
+    std::vector<Blob> blobs(size / sizeof(Blob));
+    esp_err_t err = nvs_get_blob(handle, "nodes", blobs.data(), &size);
     if (err != ESP_OK)
-    {
-        ESP_LOGE(TAG, "Failed to open NVS handle: %s", esp_err_to_name(err));
         return err;
+
+    nodes.resize(blobs.size());
+    for (size_t i = 0; i < blobs.size(); i++)
+    {
+        convert_legacy_blob(blobs[i], nodes[i]);
+        ESP_LOGI(TAG, "Converted node %zu: UUID=%s, Unicast=0x%04X, ElemNum=%d",
+                 i, nodes[i].uuid.to_string().c_str(), nodes[i].unicast, nodes[i].elem_num);
     }
-    nvs_set_u32(handle, "version", NODE_INFO_SCHEMA_VERSION);
+    return ESP_OK;
+}
 
+// "nc0003" holds the configuration of node record 3, "ns0003" its light state
+static void make_record_key(char (&key)[16], char kind, uint16_t id)
+{
+    snprintf(key, sizeof(key), "n%c%04x", kind, id);
+}
+
+static std::mutex nvs_save_mutex;
+
+uint16_t ble2mqtt_node_manager::allocate_record_id() const
+{
+    for (uint16_t id = 0;; id++)
     {
+        if (std::none_of(persisted.begin(), persisted.end(), [id](const persisted_node &p)
+                         { return p.id == id; }))
+        {
+            return id;
+        }
+    }
+}
+
+esp_err_t ble2mqtt_node_manager::save_node_records(bool include_state)
+{
+    struct record_write
+    {
+        char key[16];
+        node_record record;
+    };
+
+    // One save at a time, so records reach NVS in the order their digests were updated
+    std::lock_guard<std::mutex> save_lock(nvs_save_mutex);
+
+    std::vector<record_write> writes;
+    std::vector<uint16_t> erased_ids;
+    std::vector<uint16_t> record_ids;
+    bool write_ids = false;
+    bool erase_legacy_blob = false;
+    bool write_version = false;
+    {
+        // Only the diff is taken under the node lock, NVS is written without it
         std::lock_guard<std::mutex> lock(tn_mutex);
-        size_t total_size = tracked_nodes.size() * sizeof(bm2mqtt_node_info);
-        err = nvs_set_blob(handle, "nodes", tracked_nodes.data(), total_size);
+        erased_ids.swap(removed_record_ids);
+        tracked_nodes.for_each([&](bm2mqtt_node_info &node)
+                               {
+            persisted_node &p = persisted[tracked_nodes.handle_of(&node).index];
+            if (p.id == persisted_node::no_id)
+            {
+                p.id = allocate_record_id();
+                record_ids_changed = true;
+            }
+
+            const node_record config = encode_node_config(node);
+            if (const uint32_t digest = config.digest(); p.config_digest != digest)
+            {
+                record_write &write = writes.emplace_back();
+                make_record_key(write.key, 'c', p.id);
+                write.record = config;
+                p.config_digest = digest;
+            }
+
+            // Light state is only encoded for nodes a status changed since the last save
+            if (!include_state || (p.state_digest != 0 && node.unsaved == 0))
+                return;
+            node.unsaved = 0;
+            const node_record state = encode_node_state(node);
+            if (const uint32_t digest = state.digest(); p.state_digest != digest)
+            {
+                record_write &write = writes.emplace_back();
+                make_record_key(write.key, 's', p.id);
+                write.record = state;
+                p.state_digest = digest;
+            } });
+
+        if (record_ids_changed)
+        {
+            for (const persisted_node &p : persisted)
+            {
+                if (p.id != persisted_node::no_id)
+                    record_ids.push_back(p.id);
+            }
+            record_ids_changed = false;
+            write_ids = true;
+        }
+        erase_legacy_blob = legacy_blob_present;
+        write_version = !schema_version_stored;
+        if (!include_state)
+            stats.whole_table_bytes += tracked_nodes.size() * sizeof(legacy_node_blob_v2);
+    }
+
+    if (writes.empty() && erased_ids.empty() && !write_ids && !erase_legacy_blob && !write_version)
+    {
+        return ESP_OK;
+    }
+
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open("ble_mesh", NVS_READWRITE, &handle);
+    if (err == ESP_OK)
+    {
+        uint64_t bytes = 0;
+        for (uint16_t id : erased_ids)
+        {
+            char key[16];
+            for (char kind : {'c', 's'})
+            {
+                make_record_key(key, kind, id);
+                if (const esp_err_t erase_err = nvs_erase_key(handle, key); erase_err != ESP_OK && erase_err != ESP_ERR_NVS_NOT_FOUND)
+                    err = erase_err;
+            }
+        }
+        for (const record_write &write : writes)
+        {
+            if (err == ESP_OK)
+                err = nvs_set_blob(handle, write.key, write.record.data.data(), write.record.size);
+            bytes += write.record.size;
+        }
+        if (err == ESP_OK && write_ids)
+        {
+            err = nvs_set_blob(handle, "node_ids", record_ids.data(), record_ids.size() * sizeof(uint16_t));
+            bytes += record_ids.size() * sizeof(uint16_t);
+        }
+        if (err == ESP_OK && write_version)
+        {
+            err = nvs_set_u32(handle, "version", NODE_INFO_SCHEMA_VERSION);
+        }
+        if (err == ESP_OK && erase_legacy_blob && nvs_erase_key(handle, "nodes") == ESP_OK)
+        {
+            ESP_LOGI(TAG, "Node table migrated to per-node records");
+        }
         if (err == ESP_OK)
         {
             err = nvs_commit(handle);
         }
-        else
+        nvs_close(handle);
+
+        if (err == ESP_OK)
         {
-            ESP_LOGE(TAG, "Failed to save node info vector to NVS: %s", esp_err_to_name(err));
+            std::lock_guard<std::mutex> lock(tn_mutex);
+            stats.bytes_written += bytes;
+            stats.records_written += writes.size();
+            stats.records_erased += erased_ids.size();
+            stats.saves++;
+            if (erase_legacy_blob)
+                legacy_blob_present = false;
+            if (write_version)
+                schema_version_stored = true;
         }
     }
 
-    nvs_close(handle);
-    return err;
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed to save node records to NVS: %s", esp_err_to_name(err));
+        // Everything is written again by the next save
+        {
+            std::lock_guard<std::mutex> lock(tn_mutex);
+            for (persisted_node &p : persisted)
+            {
+                p.config_digest = 0;
+                p.state_digest = 0;
+            }
+            removed_record_ids.insert(removed_record_ids.end(), erased_ids.begin(), erased_ids.end());
+            record_ids_changed = true;
+        }
+        mark_node_info_dirty();
+        return err;
+    }
+
+    ESP_LOGI(TAG, "Saved %zu node records, erased %zu", writes.size(), erased_ids.size());
+    return ESP_OK;
 }
 
-esp_err_t ble2mqtt_node_manager::load_node_info_vector()
+// Ranges are a property of the light, once stored they are not polled again after a reboot. Ranges
+// still at their defaults were never received.
+static void confirm_stored_ranges(bm2mqtt_node_info *node)
+{
+    const bm2mqtt_node_info defaults{};
+    if (node->min_hue != defaults.min_hue || node->max_hue != defaults.max_hue ||
+        node->min_saturation != defaults.min_saturation || node->max_saturation != defaults.max_saturation ||
+        node->min_lightness != defaults.min_lightness || node->max_lightness != defaults.max_lightness ||
+        node->min_temp != defaults.min_temp || node->max_temp != defaults.max_temp)
+    {
+        confirm_node_fields(node, FIELD_RANGES, state_source::stored);
+    }
+}
+
+esp_err_t ble2mqtt_node_manager::load_node_records()
 {
     nvs_handle_t handle;
     esp_err_t err = nvs_open("ble_mesh", NVS_READONLY, &handle);
@@ -275,71 +629,152 @@ esp_err_t ble2mqtt_node_manager::load_node_info_vector()
     }
 
     uint32_t version;
-    if (nvs_get_u32(handle, "version", &version) != ESP_OK || version > NODE_INFO_SCHEMA_VERSION)
+    if (nvs_get_u32(handle, "version", &version) != ESP_OK)
     {
         nvs_close(handle);
-        ESP_LOGE(TAG, "NVS version mismatch: expected %u, got %u", NODE_INFO_SCHEMA_VERSION, version);
-        // Optionally, you could handle the version mismatch by migrating data or resetting.
-        // For now, we just return an error.
+        ESP_LOGE(TAG, "No node info schema version in NVS");
         return ESP_ERR_INVALID_VERSION;
     }
+    if (version > NODE_INFO_SCHEMA_VERSION)
+    {
+        // Newer firmware still writes records, their fields this one does not know are skipped
+        ESP_LOGW(TAG, "Node info schema version %u is newer than %u, loading known fields", version, NODE_INFO_SCHEMA_VERSION);
+    }
 
-    size_t size = 0;
-    err = nvs_get_blob(handle, "nodes", nullptr, &size);
-    if (err != ESP_OK || size == 0)
+    if (version < NODE_INFO_SCHEMA_VERSION)
     {
+        err = load_legacy_node_blob(handle, version);
         nvs_close(handle);
-        ESP_LOGE(TAG, "Failed to load node info vector to NVS: %s", esp_err_to_name(err));
         return err;
     }
-    if (version == 1)
+
+    size_t size = 0;
+    err = nvs_get_blob(handle, "node_ids", nullptr, &size);
+    std::vector<uint16_t> record_ids(size / sizeof(uint16_t));
+    if (err == ESP_OK)
+    {
+        err = nvs_get_blob(handle, "node_ids", record_ids.data(), &size);
+    }
+    if (err != ESP_OK)
     {
-        ESP_LOGW(TAG, "Detected old node info schema version 1, converting to version 2");
+        nvs_close(handle);
+        ESP_LOGE(TAG, "Failed to load node record ids from NVS: %s", esp_err_to_name(err));
+        return err;
+    }
 
-        size_t count = size / sizeof(bm2mqtt_node_info_v1);
-        
-        std::vector<bm2mqtt_node_info_v1> tracked_nodes_v1(count);
-        tracked_nodes_v1.resize(count);
-        err = nvs_get_blob(handle, "nodes", tracked_nodes_v1.data(), &size);
-        if (err != ESP_OK)
-        {
-            ESP_LOGE(TAG, "Failed to read node info vector from NVS: %s", esp_err_to_name(err));
-        }
-        else
+    std::lock_guard<std::mutex> lock(tn_mutex);
+    schema_version_stored = true;
+    tracked_nodes.clear();
+    persisted.fill(persisted_node{});
+    std::vector<uint8_t> buffer;
+    const auto read_record = [&handle, &buffer](const char *key) -> bool
+    {
+        size_t size = 0;
+        if (nvs_get_blob(handle, key, nullptr, &size) != ESP_OK)
+            return false;
+        buffer.resize(size);
+        return nvs_get_blob(handle, key, buffer.data(), &size) == ESP_OK;
+    };
+
+    for (uint16_t id : record_ids)
+    {
+        char key[16];
+        make_record_key(key, 'c', id);
+        bm2mqtt_node_info decoded{};
+        if (!read_record(key) || !decode_node_config(buffer.data(), buffer.size(), decoded))
         {
-            ESP_LOGI(TAG, "Loaded %zu nodes from NVS", tracked_nodes_v1.size());
+            ESP_LOGE(TAG, "Node record %u is missing or corrupted, skipping it", id);
+            record_ids_changed = true;
+            continue;
         }
 
-        std::lock_guard<std::mutex> lock(tn_mutex);
-        tracked_nodes.resize(count);
-        for (size_t i = 0; i < count; i++)
+        bm2mqtt_node_info *node = tracked_nodes.allocate();
+        if (!node)
         {
-            tracked_nodes[i].convert_from_v1(tracked_nodes_v1[i]);
-            ESP_LOGI(TAG, "Converted node %zu: UUID=%s, Unicast=0x%04X, ElemNum=%d",
-                     i, tracked_nodes[i].uuid.to_string().c_str(),
-                     tracked_nodes[i].unicast, tracked_nodes[i].elem_num);
+            ESP_LOGE(TAG, "No room for the %zu nodes stored in NVS, keeping %zu", record_ids.size(), tracked_nodes.size());
+            break;
         }
-        mark_node_info_dirty();
-    } 
-    else if (version == NODE_INFO_SCHEMA_VERSION)
-    {
-        size_t count = size / sizeof(bm2mqtt_node_info);
-        std::lock_guard<std::mutex> lock(tn_mutex);
-        tracked_nodes.resize(count);
-        err = nvs_get_blob(handle, "nodes", tracked_nodes.data(), &size);
-        if (err != ESP_OK)
+        make_record_key(key, 's', id);
+        bool state_restored = false;
+        if (read_record(key))
         {
-            ESP_LOGE(TAG, "Failed to read node info vector from NVS: %s", esp_err_to_name(err));
-            tracked_nodes.clear();
+            state_restored = decode_node_state(buffer.data(), buffer.size(), decoded);
+            if (!state_restored)
+                ESP_LOGW(TAG, "Light state of node record %u is corrupted, using defaults", id);
         }
-        else
+        *node = decoded;
+
+        // Digests are of what this firmware would write, so records from another version are
+        // rewritten in the current encoding by the next save
+        persisted_node &p = persisted[tracked_nodes.handle_of(node).index];
+        p.id = id;
+        p.config_digest = encode_node_config(*node).digest();
+        p.state_digest = encode_node_state(*node).digest();
+        confirm_stored_ranges(node);
+        // Last known state, published at start and verified by the warm start sweep
+        if (state_restored)
+            confirm_node_fields(node, FIELD_LIGHT_STATE, state_source::assumed);
+    }
+    ESP_LOGI(TAG, "Loaded %zu nodes from NVS", tracked_nodes.size());
+
+    nvs_close(handle);
+    return ESP_OK;
+}
+
+esp_err_t ble2mqtt_node_manager::load_legacy_node_blob(nvs_handle_t handle, uint32_t version)
+{
+    size_t size = 0;
+    esp_err_t err = nvs_get_blob(handle, "nodes", nullptr, &size);
+    if (err != ESP_OK || size == 0)
+    {
+        ESP_LOGE(TAG, "Failed to load node info vector to NVS: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    ESP_LOGW(TAG, "Detected node info schema version %u, converting to per-node records", version);
+    std::vector<bm2mqtt_node_info> nodes;
+    if (version == 1)
+        err = read_legacy_blob<legacy_node_blob_v1>(handle, size, nodes);
+    else
+        err = read_legacy_blob<legacy_node_blob_v2>(handle, size, nodes);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed to read node info vector from NVS: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    std::lock_guard<std::mutex> lock(tn_mutex);
+    tracked_nodes.clear();
+    persisted.fill(persisted_node{});
+    for (const bm2mqtt_node_info &stored : nodes)
+    {
+        bm2mqtt_node_info *node = tracked_nodes.allocate();
+        if (!node)
         {
-            ESP_LOGI(TAG, "Loaded %zu nodes from NVS", tracked_nodes.size());
+            ESP_LOGE(TAG, "No room for the %zu nodes stored in NVS, keeping %zu", nodes.size(), tracked_nodes.size());
+            break;
         }
+        *node = stored;
+        confirm_stored_ranges(node);
+        confirm_node_fields(node, FIELD_LIGHT_STATE, state_source::assumed);
     }
+    ESP_LOGI(TAG, "Loaded %zu nodes from NVS", tracked_nodes.size());
 
-    nvs_close(handle);
-    return err;
+    // Nothing has a record yet, the next save writes them all and drops the blob
+    legacy_blob_present = true;
+    record_ids_changed = true;
+    mark_node_info_dirty();
+    return ESP_OK;
+}
+
+void ble2mqtt_node_manager::print_store_stats()
+{
+    std::lock_guard<std::mutex> lock(tn_mutex);
+    const double hours = std::max<int64_t>(esp_timer_get_time() - stats.since_us, 1) / 3600e6;
+    ESP_LOGI(TAG, "Node store: %" PRIu32 " saves, %" PRIu32 " records written, %" PRIu32 " erased",
+             stats.saves, stats.records_written, stats.records_erased);
+    ESP_LOGI(TAG, "  Bytes written: %" PRIu64 " (%.0f per hour), whole table rewrites: %" PRIu64 " (%.0f per hour)",
+             stats.bytes_written, stats.bytes_written / hours, stats.whole_table_bytes, stats.whole_table_bytes / hours);
 }
 
 void ble2mqtt_node_manager::save_timer_callback(void *arg)
@@ -350,43 +785,82 @@ void ble2mqtt_node_manager::save_timer_callback(void *arg)
     }
 }
 
+void ble2mqtt_node_manager::state_save_timer_callback(void *arg)
+{
+    if (auto *manager = static_cast<ble2mqtt_node_manager *>(arg))
+    {
+        manager->save_node_records(true);
+    }
+}
+
 void ble2mqtt_node_manager::on_timer_callback()
 {
     if (node_info_dirty)
     {
         ESP_LOGI(TAG, "Saving node info to NVS...");
-        save_node_info_vector();
         node_info_dirty = false;
+        save_node_records(false);
     }
 }
 
 void ble2mqtt_node_manager::mark_node_info_dirty()
 {
     node_info_dirty = true;
-    esp_timer_start_once(save_timer, 10 * 1000000); // 10 seconds in microseconds
+    // Saves at most 10 seconds after the first change, further changes ride along
+    if (!timer_wheel().is_active(save_timer))
+    {
+        timer_wheel().start_once(save_timer, 10 * 1000000); // 10 seconds in microseconds
+    }
+}
+
+void ble2mqtt_node_manager::mark_all_unpublished()
+{
+    std::lock_guard<std::mutex> lock(tn_mutex);
+    tracked_nodes.for_each([](bm2mqtt_node_info &node)
+                           { node.unpublished = FIELD_ALL; });
 }
 
 void ble2mqtt_node_manager::init_node_save_timer()
 {
-    const esp_timer_create_args_t timer_args = {
-        .callback = &save_timer_callback,
-        .arg = this,
-        .name = "node_save_timer"};
-    esp_timer_create(&timer_args, &save_timer);
+    timer_wheel().init_timer(save_timer, &save_timer_callback, this, "node_save_timer");
+    timer_wheel().init_timer(state_save_timer, &state_save_timer_callback, this, "node_state_save_timer");
+#if CONFIG_BM2MQTT_NODE_STATE_SAVE_S > 0
+    timer_wheel().start_periodic(state_save_timer, CONFIG_BM2MQTT_NODE_STATE_SAVE_S * 1000000ull);
+#endif
 }
 
 void ble2mqtt_node_manager::initialize()
 {
+    stats.since_us = esp_timer_get_time();
+    topics.resize(CONFIG_BLE_MESH_MAX_PROV_NODES);
     init_node_save_timer();
-    load_node_info_vector();
+    load_node_records();
+
+    // node_index selects the node's message queue slot, resync it with the provisioner table in
+    // one pass, the UUID index resolving the entries
+    std::lock_guard<std::mutex> lock(tn_mutex);
+    index.clear();
+    tracked_nodes.for_each([this](bm2mqtt_node_info &node)
+                           {
+        node.node_index = std::numeric_limits<uint16_t>::max();
+        index.insert(tracked_nodes.handle_of(&node).index, node.uuid); });
+    for (uint16_t i = 0; i < CONFIG_BLE_MESH_MAX_PROV_NODES; i++)
+    {
+        const esp_ble_mesh_node_t *entry = esp_ble_mesh_provisioner_get_node_table_entry()[i];
+        if (bm2mqtt_node_info *node = entry ? tracked_nodes.at(index.find(Uuid128(entry->dev_uuid))) : nullptr)
+        {
+            node->node_index = std::min(node->node_index, i);
+        }
+    }
+    rebuild_index();
 }
 
 void ble2mqtt_node_manager::set_node_name(const Uuid128& uuid, const char* name)
 {
-    if (bm2mqtt_node_info *node = get_node(uuid))
+    bm2mqtt_node_info *node = get_node(uuid);
+    if (node && indexed_prov_node(node))
     {
-        uint16_t node_index = get_node_index(uuid); // Ensure node_index is set
-        esp_ble_mesh_provisioner_set_node_name(node_index, name);
+        esp_ble_mesh_provisioner_set_node_name(node->node_index, name);
         mark_node_info_dirty();
     }
     else{
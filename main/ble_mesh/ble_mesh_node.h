@@ -3,6 +3,8 @@
 #include <string>
 #include <inttypes.h>
 #include <functional>
+#include <array>
+#include <vector>
 
 #include "esp_log.h"
 #include "nvs_flash.h"
@@ -22,12 +24,16 @@
 
 #include "esp_ble_mesh_defs.h"
 #include <esp_timer.h>
+#include "timer/timer_wheel.h"
 #include "Uui128.h"
+#include "node_index.h"
+#include "slab.h"
+#include "node_record.h"
+#include "mqtt/node_topics.h"
 
 #define LED_OFF 0x0
 #define LED_ON 0x1
 #define MSG_SEND_TTL 3
-#define MSG_TIMEOUT 4000
 
 enum class color_mode_t : uint8_t
 {
@@ -38,102 +44,106 @@ enum class color_mode_t : uint8_t
 
 const char* get_color_mode_string(color_mode_t mode);
 
-uint16_t get_node_index(Uuid128 uuid);
 
-typedef struct
+// Light attributes whose changes are tracked, bits of bm2mqtt_node_info::unpublished and ::unsaved
+typedef enum
 {
-    Uuid128 uuid;
+    FIELD_ONOFF = 1 << 0,
+    FIELD_LIGHTNESS = 1 << 1,
+    FIELD_HUE_SATURATION = 1 << 2,
+    FIELD_TEMPERATURE = 1 << 3,
+    FIELD_LEVEL = 1 << 4,
+    FIELD_COLOR_MODE = 1 << 5,
+    FIELD_RANGES = 1 << 6,
+    FIELD_ALL = 0x7F,
+    FIELD_LIGHT_STATE = FIELD_ONOFF | FIELD_LIGHTNESS | FIELD_HUE_SATURATION | FIELD_TEMPERATURE, // What a refresh polls
+} node_field_t;
+
+constexpr size_t NODE_FIELD_COUNT = 7;
+
+// Where the cached value of an attribute comes from
+enum class state_source : uint8_t
+{
+    none,    // Never confirmed since boot
+    stored,  // Loaded from NVS, confirmed before the reboot
+    assumed, // Set by the bridge, the light did not answer yet
+    ack,     // Status answering a GET or a SET
+    publish, // Status the light published on its own
+};
+
+const char *get_state_source_string(state_source source);
+
+// Members read on every status and command come first and share a cache line; the UUID and the
+// ranges that only change with configuration trail. NVS stores encoded records, not this layout.
+struct bm2mqtt_node_info
+{
+    // Hot
     uint16_t unicast{0};
+    uint16_t node_index{0}; // Node index in the provisioning table
     uint16_t hsl_h{0};
-    uint16_t min_hue{0};
-    uint16_t max_hue{std::numeric_limits<uint16_t>::max()};  
     uint16_t hsl_s{0};
-    uint16_t min_saturation{0};
-    uint16_t max_saturation{std::numeric_limits<uint16_t>::max()};
     uint16_t hsl_l{0};
-    uint16_t min_lightness{0};
-    uint16_t max_lightness{std::numeric_limits<uint16_t>::max()};
     uint16_t curr_temp{0};
-    uint16_t min_temp{0};
-    uint16_t max_temp{std::numeric_limits<uint16_t>::max()};
     int16_t level{0};
     uint16_t features{0};
-    uint16_t features_to_bind{0};
     uint8_t elem_num{0};
     uint8_t onoff{0};
     uint8_t light_ctl_temp_offset{0}; // Element index for Light CTL Temperature
     color_mode_t color_mode = color_mode_t::brightness;
+    uint8_t unpublished{FIELD_ALL}; // Changed since the last status publish, all until the first
+    uint8_t unsaved{0};             // Changed since the last state save
 
-} bm2mqtt_node_info_v1;
-
-typedef struct
-{
-    Uuid128 uuid;
-    uint16_t unicast{0};
-    uint16_t hsl_h{0};
+    // Cold
+    uint16_t features_to_bind{0};
     uint16_t min_hue{0};
-    uint16_t max_hue{std::numeric_limits<uint16_t>::max()};  
-    uint16_t hsl_s{0};
+    uint16_t max_hue{std::numeric_limits<uint16_t>::max()};
     uint16_t min_saturation{0};
     uint16_t max_saturation{std::numeric_limits<uint16_t>::max()};
-    uint16_t hsl_l{0};
     uint16_t min_lightness{0};
     uint16_t max_lightness{std::numeric_limits<uint16_t>::max()};
-    uint16_t curr_temp{0};
     uint16_t min_temp{0};
     uint16_t max_temp{std::numeric_limits<uint16_t>::max()};
-    int16_t level{0};
-    uint16_t features{0};
-    uint16_t features_to_bind{0};
-    uint16_t node_index{0}; // Node index in the provisioning table
-    uint8_t elem_num{0};
-    uint8_t onoff{0};
-    uint8_t light_ctl_temp_offset{0}; // Element index for Light CTL Temperature
-    color_mode_t color_mode = color_mode_t::brightness;
-
-    void operator=(const bm2mqtt_node_info_v1& other)
-    {
-        uuid = other.uuid;
-        unicast = other.unicast;
-        hsl_h = other.hsl_h;
-        min_hue = other.min_hue;
-        max_hue = other.max_hue;
-        hsl_s = other.hsl_s;
-        min_saturation = other.min_saturation;
-        max_saturation = other.max_saturation;
-        hsl_l = other.hsl_l;
-        min_lightness = other.min_lightness;
-        max_lightness = other.max_lightness;
-        curr_temp = other.curr_temp;
-        min_temp = other.min_temp;
-        max_temp = other.max_temp;
-        level = other.level;
-        features = other.features;
-        features_to_bind = other.features_to_bind;
-        elem_num = other.elem_num;
-        onoff = other.onoff;
-        light_ctl_temp_offset = other.light_ctl_temp_offset;
-        color_mode = other.color_mode;
-    }
-
-    void convert_from_v1(const bm2mqtt_node_info_v1& v1)
-    {
-        *this = v1; // Use the assignment operator to copy data
-
-        // node_index = get_node_index(uuid);
-        // if (node_index == std::numeric_limits<uint16_t>::max())
-        // {
-        //     ESP_LOGW("bm2mqtt_node_info_v2", "Node with UUID %s not found in provisioning table",
-        //              uuid.to_string().c_str());
-        // }
-    }
-
-} bm2mqtt_node_info_v2;
-
+    Uuid128 uuid;
 
-constexpr uint32_t NODE_INFO_SCHEMA_VERSION = 2;
+    // When each FIELD_* attribute was last confirmed, seconds since boot, by bit position
+    std::array<uint32_t, NODE_FIELD_COUNT> confirmed_s{};
+    std::array<state_source, NODE_FIELD_COUNT> confirmed_by{};
+};
 
-using bm2mqtt_node_info = bm2mqtt_node_info_v2;
+state_source get_field_source(const bm2mqtt_node_info *node, node_field_t field);
+// Records when and how the attributes of fields were last confirmed
+void confirm_node_fields(bm2mqtt_node_info *node, uint8_t fields, state_source source);
+// Attributes of fields the light has not confirmed in the last max_age_s, 0 making them all stale.
+// Assumed values are stale.
+uint8_t stale_node_fields(const bm2mqtt_node_info *node, uint8_t fields, uint32_t max_age_s);
+
+// Sets a light attribute and flags it for the next status publish and state save. A value equal
+// to the current one only refreshes its confirmation, so repeated mesh statuses cause no MQTT or
+// NVS traffic.
+template <typename T, typename V>
+bool update_node_field(bm2mqtt_node_info *node, T bm2mqtt_node_info::*member, V value, node_field_t field, state_source source)
+{
+    confirm_node_fields(node, field, source);
+    const T converted = static_cast<T>(value);
+    if (node->*member == converted)
+        return false;
+    node->*member = converted;
+    node->unpublished |= field;
+    node->unsaved |= field;
+    return true;
+}
+
+// Provisioner table entry of a tracked node, direct through its node_index, by UUID if stale
+const esp_ble_mesh_node_t *get_prov_node(const bm2mqtt_node_info *node);
+// Name the provisioner has for the node, nullptr if unnamed or if its node_index is stale
+const char *get_prov_node_name(const bm2mqtt_node_info *node);
+
+// Version 3 stores one encoded record per node (node_record.h) instead of a blob of structs.
+// Record fields evolve without a version change.
+constexpr uint32_t NODE_INFO_SCHEMA_VERSION = 3;
+
+// Refers to a tracked node across tasks and callbacks, stops resolving once the node is removed
+using node_handle = slab_handle;
 
 class ble2mqtt_node_manager final
 {
@@ -143,29 +153,42 @@ public:
 
     bm2mqtt_node_info *get_node(int nodeIndex);
     bm2mqtt_node_info *get_node(const Uuid128& uuid);
-    bm2mqtt_node_info *get_node(const std::string &mac);
+    bm2mqtt_node_info *get_node(std::string_view mac);
     bm2mqtt_node_info *get_node(uint16_t unicast);
+    bm2mqtt_node_info *get_node(node_handle handle);
+    node_handle get_handle(const bm2mqtt_node_info *node);
+    // Slab slot of a tracked node, CONFIG_BLE_MESH_MAX_PROV_NODES for anything else. Lock free.
+    uint16_t get_slot(const bm2mqtt_node_info *node) const { return tracked_nodes.slot_of(node); }
     bm2mqtt_node_info* get_or_create(const uint8_t uuid[16]);
     bm2mqtt_node_info* get_or_create(const Uuid128& uuid);
 
-    
+
+    // Runs func on every provisioned node. The lock is only held to find the next node, so callbacks
+    // can do I/O or call back into the manager. Nodes are the tracked ones, like get_node() returns.
     void for_each_node(std::function<void(const bm2mqtt_node_info *)> func);
 
     esp_err_t store_node_info(const Uuid128& uuid, uint16_t unicast,
                                                uint8_t elem_num, uint16_t node_index);
 
     void remove_node(const Uuid128& uuid);
+    // Takes the address, element count and table index the provisioner has for the node
+    void update_address(bm2mqtt_node_info *node, const esp_ble_mesh_node_t *prov_node, uint16_t node_index);
 
     esp_err_t example_ble_mesh_set_msg_common(esp_ble_mesh_client_common_param_t *common,
                                               bm2mqtt_node_info *node,
                                               esp_ble_mesh_model_t *model, uint32_t opcode);
 
     void print_registered_nodes();
+    void print_store_stats();
 
     void initialize();
     void mark_node_info_dirty();
+    // The next status of every node is published whole, after the broker lost what it had
+    void mark_all_unpublished();
 
     void set_node_name(const Uuid128& uuid, const char* name);
+    // Copy of the node's MQTT topics, empty until its MAC is known or for a node that is not tracked
+    node_topics get_topics(const bm2mqtt_node_info *node);
 private:
     // Disable copy and move constructors and assignment operators
     ble2mqtt_node_manager(const ble2mqtt_node_manager &) = delete;
@@ -174,16 +197,61 @@ private:
     ble2mqtt_node_manager &operator=(ble2mqtt_node_manager &&) = delete;
 
     static void save_timer_callback(void* arg);
+    static void state_save_timer_callback(void* arg);
     void on_timer_callback();
     
     void init_node_save_timer();
 
-    esp_err_t save_node_info_vector();
-    esp_err_t load_node_info_vector();
+    // Writes the records that differ from what was last written, light state included or not
+    esp_err_t save_node_records(bool include_state);
+    esp_err_t load_node_records();
+    // Schema 1 and 2 blobs, rewritten as records by the next save
+    esp_err_t load_legacy_node_blob(nvs_handle_t handle, uint32_t version);
+    uint16_t allocate_record_id() const;
+
+    // Tracked node in the first used slot at or after index, which is moved to it. Nothing is
+    // copied and the lock is released before returning.
+    bm2mqtt_node_info *next_node(size_t &index, bool provisioned_only);
+
+    // Called with tn_mutex held
+    void index_node(const bm2mqtt_node_info *node);
+    void rebuild_index();
 
-    std::vector<bm2mqtt_node_info> tracked_nodes{};
+    // Nodes never move: pointers handed out stay valid until the node is removed
+    slab<bm2mqtt_node_info, CONFIG_BLE_MESH_MAX_PROV_NODES> tracked_nodes;
 
-    esp_timer_handle_t save_timer;
+    // NVS side of each slab slot: record id and digests of the records as last written, 0 until
+    // written. Digests rather than copies keep this at a few bytes per node.
+    struct persisted_node
+    {
+        static constexpr uint16_t no_id = 0xFFFF;
+
+        uint16_t id = no_id;
+        uint32_t config_digest = 0;
+        uint32_t state_digest = 0;
+    };
+    std::array<persisted_node, CONFIG_BLE_MESH_MAX_PROV_NODES> persisted{};
+    // MQTT side of each slab slot, built when the node is indexed with its MAC, reset on removal.
+    // Allocated by initialize(), PSRAM on large fleets.
+    std::vector<node_topics> topics;
+    std::vector<uint16_t> removed_record_ids; // Records to erase at the next save
+    bool record_ids_changed = false;
+    bool legacy_blob_present = false;
+    bool schema_version_stored = false;
+
+    struct store_stats
+    {
+        int64_t since_us = 0;
+        uint64_t bytes_written = 0;
+        uint32_t records_written = 0;
+        uint32_t records_erased = 0;
+        uint32_t saves = 0;
+        uint64_t whole_table_bytes = 0; // What rewriting the whole table at each save would have cost
+    } stats;
+    node_index index;
+
+    wheel_timer save_timer;
+    wheel_timer state_save_timer;
     bool node_info_dirty = false;
 };
 
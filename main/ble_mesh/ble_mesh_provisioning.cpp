@@ -125,26 +125,7 @@ esp_err_t prov_complete(esp_ble_mesh_prov_cb_param_t::ble_mesh_provisioner_prov_
         return ESP_FAIL;
     }
 
-    message_queue().enqueue(node,
-                            message_payload{
-                                .send = [node]()
-                                {
-                                    esp_ble_mesh_client_common_param_t common = {0};
-                                    esp_ble_mesh_cfg_client_get_state_t get_state = {0};
-                                    ESP_LOGW(TAG, "[ble_mesh_ctl_set] Setting CTL for node 0x%04X", __func__, node->unicast);
-                                    node_manager().example_ble_mesh_set_msg_common(&common, node, config_client.model, ESP_BLE_MESH_MODEL_OP_COMPOSITION_DATA_GET);
-                                    get_state.comp_data_get.page = COMP_DATA_PAGE_0;
-                                    esp_err_t err = esp_ble_mesh_config_client_get_state(&common, &get_state);
-                                    if (err)
-                                    {
-                                        ESP_LOGE(TAG, "%s: Send config comp data get failed", __func__);
-                                    }
-                                },
-                                .opcode = ESP_BLE_MESH_MODEL_OP_COMPOSITION_DATA_GET,
-                                .retries_left = 3,
-                            });
-
-    
+    message_queue().enqueue(node, make_mesh_get(node->unicast, ESP_BLE_MESH_MODEL_OP_COMPOSITION_DATA_GET));
 
     store.net_idx = net_idx;
     /* mesh_example_info_store() shall not be invoked here, because if the device
@@ -413,24 +394,7 @@ void unprovision_device(const Uuid128& uuid)
 {
     if (bm2mqtt_node_info *node_info = node_manager().get_node(uuid))
     {
-        message_queue().enqueue(node_info,
-                                message_payload{
-                                    .send = [node_info]()
-                                    {
-                                        ESP_LOGW(TAG, "unprovision_device for node 0x%04X", __func__, node_info->unicast);
-                                        esp_ble_mesh_client_common_param_t common = {0};
-                                        esp_ble_mesh_cfg_client_set_state_t set_state = {0};
-                                        node_manager().example_ble_mesh_set_msg_common(&common, node_info, config_client.model, ESP_BLE_MESH_MODEL_OP_NODE_RESET);
-
-                                        int err = esp_ble_mesh_config_client_set_state(&common, &set_state);
-                                        if (err != ESP_OK)
-                                        {
-                                            ESP_LOGE(TAG, "Failed to delete node [err=%d] [Node=%s]", err, bt_hex(node_info->uuid.raw(), 16));
-                                        }
-                                    },
-                                    .opcode = ESP_BLE_MESH_MODEL_OP_NODE_RESET,
-                                    .retries_left = 2,
-                                });
+        message_queue().enqueue(node_info, make_node_reset(node_info->unicast, 2));
     }
     else
     {
@@ -460,24 +424,7 @@ int unprovision_all_nodes(int argc, char **argv)
     {
         if (bm2mqtt_node_info *node_info = node_manager().get_node(bla) )
         {
-            message_queue().enqueue(node_info, message_payload{
-                                   .send = [node_info]()
-                                   {
-                                        esp_ble_mesh_client_common_param_t common = {0};
-                                        esp_ble_mesh_cfg_client_set_state_t set_state = {0};
-                                        node_manager().example_ble_mesh_set_msg_common(&common, node_info, config_client.model, ESP_BLE_MESH_MODEL_OP_NODE_RESET);
-
-                                        int err = esp_ble_mesh_config_client_set_state(&common, &set_state);
-                                        if (err != ESP_OK)
-                                        {
-                                            ESP_LOGE(TAG, "Failed to delete node [err=%d] [Node=5s]", err, bt_hex(node_info->uuid.raw(), 16));
-                                        }
-                                   },
-                                   .opcode = ESP_BLE_MESH_MODEL_OP_NODE_RESET,
-                                   .retries_left = 3,
-                               });
-
-           
+            message_queue().enqueue(node_info, make_node_reset(node_info->unicast, 3));
         }
 
         esp_ble_mesh_provisioner_delete_node_with_uuid(bla.raw());
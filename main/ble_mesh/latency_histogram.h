@@ -0,0 +1,52 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <algorithm>
+
+// Log2 histogram of latencies in milliseconds. Bucket 0 holds samples under 1 ms,
+// bucket i holds [2^(i-1), 2^i) ms, the last one everything above.
+class latency_histogram
+{
+public:
+    static constexpr size_t bucket_count = 20;
+
+    void record(int64_t latency_us)
+    {
+        const uint32_t ms = latency_us > 0 ? latency_us / 1000 : 0;
+        size_t bucket = 0;
+        while (bucket + 1 < bucket_count && (ms >> bucket) != 0)
+        {
+            bucket++;
+        }
+        buckets[bucket]++;
+        samples++;
+        max_ms = std::max(max_ms, ms);
+    }
+
+    uint32_t count() const { return samples; }
+    uint32_t max() const { return max_ms; }
+
+    // Upper bound of the bucket holding the given percentile, capped by the largest sample
+    uint32_t percentile(uint32_t percent) const
+    {
+        if (samples == 0)
+            return 0;
+
+        const uint64_t rank = ((uint64_t)samples * percent + 99) / 100;
+        uint64_t seen = 0;
+        for (size_t i = 0; i < bucket_count; i++)
+        {
+            seen += buckets[i];
+            if (seen >= rank)
+                return std::min<uint32_t>((1u << i) - 1, max_ms);
+        }
+        return max_ms;
+    }
+
+    void reset() { *this = latency_histogram{}; }
+
+private:
+    std::array<uint32_t, bucket_count> buckets{};
+    uint32_t samples = 0;
+    uint32_t max_ms = 0;
+};
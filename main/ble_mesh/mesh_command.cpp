@@ -0,0 +1,373 @@
+#include "mesh_command.h"
+#include <string.h>
+#include "esp_log.h"
+#include "esp_ble_mesh_config_model_api.h"
+#include "esp_ble_mesh_generic_model_api.h"
+#include "esp_ble_mesh_lighting_model_api.h"
+
+#include "ble_mesh_node.h"
+#include "ble_mesh_control.h"
+#include "ble_mesh_provisioning.h"
+#include "message_queue.h"
+#include <mqtt/mqtt_control.h>
+
+#define TAG "MESH_COMMAND"
+
+extern esp_ble_mesh_client_t config_client;
+extern esp_ble_mesh_client_t onoff_client;
+extern esp_ble_mesh_client_t level_client;
+extern esp_ble_mesh_client_t lightness_cli;
+extern esp_ble_mesh_client_t hsl_cli;
+extern esp_ble_mesh_client_t ctl_cli;
+
+extern struct example_info_store store;
+
+mesh_client_t get_mesh_client(uint32_t opcode)
+{
+    switch (opcode)
+    {
+    case ESP_BLE_MESH_MODEL_OP_APP_KEY_ADD:
+    case ESP_BLE_MESH_MODEL_OP_COMPOSITION_DATA_GET:
+    case ESP_BLE_MESH_MODEL_OP_MODEL_APP_BIND:
+    case ESP_BLE_MESH_MODEL_OP_NODE_RESET:
+        return mesh_client_t::config;
+    case ESP_BLE_MESH_MODEL_OP_GEN_ONOFF_GET:
+    case ESP_BLE_MESH_MODEL_OP_GEN_ONOFF_SET:
+        return mesh_client_t::generic_onoff;
+    case ESP_BLE_MESH_MODEL_OP_GEN_LEVEL_GET:
+    case ESP_BLE_MESH_MODEL_OP_GEN_LEVEL_SET:
+        return mesh_client_t::generic_level;
+    case ESP_BLE_MESH_MODEL_OP_LIGHT_LIGHTNESS_GET:
+    case ESP_BLE_MESH_MODEL_OP_LIGHT_LIGHTNESS_SET:
+    case ESP_BLE_MESH_MODEL_OP_LIGHT_LIGHTNESS_RANGE_GET:
+        return mesh_client_t::light_lightness;
+    case ESP_BLE_MESH_MODEL_OP_LIGHT_HSL_GET:
+    case ESP_BLE_MESH_MODEL_OP_LIGHT_HSL_SET:
+    case ESP_BLE_MESH_MODEL_OP_LIGHT_HSL_RANGE_GET:
+        return mesh_client_t::light_hsl;
+    case ESP_BLE_MESH_MODEL_OP_LIGHT_CTL_GET:
+    case ESP_BLE_MESH_MODEL_OP_LIGHT_CTL_SET:
+    case ESP_BLE_MESH_MODEL_OP_LIGHT_CTL_TEMPERATURE_GET:
+    case ESP_BLE_MESH_MODEL_OP_LIGHT_CTL_TEMPERATURE_SET:
+    case ESP_BLE_MESH_MODEL_OP_LIGHT_CTL_TEMPERATURE_RANGE_GET:
+        return mesh_client_t::light_ctl;
+    default:
+        return mesh_client_t::none;
+    }
+}
+
+static mesh_command make_command(uint16_t dst, uint32_t opcode, command_kind_t kind)
+{
+    mesh_command cmd = {};
+    cmd.opcode = opcode;
+    cmd.dst = dst;
+    cmd.client = get_mesh_client(opcode);
+    cmd.kind = kind;
+    cmd.type = message_type_t::ble_mesh_message;
+    cmd.retries_left = 3;
+    if (kind != command_kind_t::none)
+        cmd.priority = command_priority_t::interactive;
+    else if (cmd.client == mesh_client_t::config)
+        cmd.priority = command_priority_t::configuration;
+    else
+        cmd.priority = command_priority_t::background;
+    return cmd;
+}
+
+mesh_command make_mesh_get(uint16_t dst, uint32_t opcode)
+{
+    return make_command(dst, opcode, command_kind_t::none);
+}
+
+mesh_command make_onoff_set(uint16_t dst, uint8_t onoff)
+{
+    mesh_command cmd = make_command(dst, ESP_BLE_MESH_MODEL_OP_GEN_ONOFF_SET, command_kind_t::onoff_set);
+    cmd.params.onoff = onoff;
+    return cmd;
+}
+
+mesh_command make_lightness_set(uint16_t dst, uint16_t lightness)
+{
+    mesh_command cmd = make_command(dst, ESP_BLE_MESH_MODEL_OP_LIGHT_LIGHTNESS_SET, command_kind_t::lightness_set);
+    cmd.params.lightness = lightness;
+    return cmd;
+}
+
+mesh_command make_hsl_set(uint16_t dst, uint16_t hue, uint16_t saturation, uint16_t lightness)
+{
+    mesh_command cmd = make_command(dst, ESP_BLE_MESH_MODEL_OP_LIGHT_HSL_SET, command_kind_t::hsl_set);
+    cmd.params.hsl.hue = hue;
+    cmd.params.hsl.saturation = saturation;
+    cmd.params.hsl.lightness = lightness;
+    return cmd;
+}
+
+mesh_command make_ctl_set(uint16_t dst, uint16_t temperature, uint16_t lightness)
+{
+    mesh_command cmd = make_command(dst, ESP_BLE_MESH_MODEL_OP_LIGHT_CTL_SET, command_kind_t::ctl_set);
+    cmd.params.ctl.temperature = temperature;
+    cmd.params.ctl.lightness = lightness;
+    return cmd;
+}
+
+mesh_command make_app_key_add(uint16_t dst)
+{
+    return make_command(dst, ESP_BLE_MESH_MODEL_OP_APP_KEY_ADD, command_kind_t::none);
+}
+
+mesh_command make_model_app_bind(uint16_t dst, uint16_t element_addr, uint16_t model_id)
+{
+    mesh_command cmd = make_command(dst, ESP_BLE_MESH_MODEL_OP_MODEL_APP_BIND, command_kind_t::none);
+    cmd.params.bind.element_addr = element_addr;
+    cmd.params.bind.model_id = model_id;
+    return cmd;
+}
+
+mesh_command make_node_reset(uint16_t dst, uint8_t retries)
+{
+    mesh_command cmd = make_command(dst, ESP_BLE_MESH_MODEL_OP_NODE_RESET, command_kind_t::none);
+    cmd.retries_left = retries;
+    return cmd;
+}
+
+mesh_command make_mqtt_marker(uint16_t dst, mqtt_action_t action, command_priority_t priority)
+{
+    mesh_command cmd = make_command(dst, 0x0000, action == mqtt_action_t::status ? command_kind_t::status_publish : command_kind_t::none);
+    cmd.client = mesh_client_t::none;
+    cmd.type = message_type_t::mqtt_message;
+    cmd.retries_left = 0;
+    cmd.priority = priority;
+    cmd.params.mqtt = action;
+    return cmd;
+}
+
+static size_t opcode_size(uint32_t opcode)
+{
+    if (opcode < 0x7F)
+        return 1;
+    return opcode < 0x10000 ? 2 : 3;
+}
+
+static size_t parameters_size(const mesh_command &cmd)
+{
+    switch (cmd.opcode)
+    {
+    case ESP_BLE_MESH_MODEL_OP_COMPOSITION_DATA_GET:
+        return 1;
+    case ESP_BLE_MESH_MODEL_OP_APP_KEY_ADD:
+        return 3 + 16;
+    case ESP_BLE_MESH_MODEL_OP_MODEL_APP_BIND:
+        return 6;
+    case ESP_BLE_MESH_MODEL_OP_GEN_ONOFF_SET:
+        return 2;
+    case ESP_BLE_MESH_MODEL_OP_LIGHT_LIGHTNESS_SET:
+        return 3;
+    case ESP_BLE_MESH_MODEL_OP_LIGHT_HSL_SET:
+        return 7;
+    case ESP_BLE_MESH_MODEL_OP_LIGHT_CTL_SET:
+        return 7;
+    default:
+        return 0;
+    }
+}
+
+uint8_t mesh_command_airtime(const mesh_command &cmd)
+{
+    if (cmd.type == message_type_t::mqtt_message)
+        return 0;
+
+    // Access payload plus the 4 byte TransMIC: 15 bytes fit in one unsegmented PDU,
+    // longer messages are split in 12 byte segments.
+    const size_t length = opcode_size(cmd.opcode) + parameters_size(cmd) + 4;
+    if (length <= 15)
+        return 1;
+    return (length + 11) / 12;
+}
+
+static esp_ble_mesh_model_t *get_client_model(mesh_client_t client)
+{
+    switch (client)
+    {
+    case mesh_client_t::config:
+        return config_client.model;
+    case mesh_client_t::generic_onoff:
+        return onoff_client.model;
+    case mesh_client_t::generic_level:
+        return level_client.model;
+    case mesh_client_t::light_lightness:
+        return lightness_cli.model;
+    case mesh_client_t::light_hsl:
+        return hsl_cli.model;
+    case mesh_client_t::light_ctl:
+        return ctl_cli.model;
+    default:
+        return nullptr;
+    }
+}
+
+static esp_err_t send_config_command(esp_ble_mesh_client_common_param_t &common, const mesh_command &cmd)
+{
+    if (cmd.opcode == ESP_BLE_MESH_MODEL_OP_COMPOSITION_DATA_GET)
+    {
+        esp_ble_mesh_cfg_client_get_state_t get_state = {0};
+        get_state.comp_data_get.page = COMP_DATA_PAGE_0;
+        return esp_ble_mesh_config_client_get_state(&common, &get_state);
+    }
+
+    esp_ble_mesh_cfg_client_set_state_t set_state = {0};
+    switch (cmd.opcode)
+    {
+    case ESP_BLE_MESH_MODEL_OP_APP_KEY_ADD:
+        set_state.app_key_add.net_idx = store.net_idx;
+        set_state.app_key_add.app_idx = store.app_idx;
+        memcpy(set_state.app_key_add.app_key, ble_mesh_get_app_key(), 16);
+        break;
+    case ESP_BLE_MESH_MODEL_OP_MODEL_APP_BIND:
+        set_state.model_app_bind.element_addr = cmd.params.bind.element_addr;
+        set_state.model_app_bind.model_app_idx = store.app_idx;
+        set_state.model_app_bind.model_id = cmd.params.bind.model_id;
+        set_state.model_app_bind.company_id = ESP_BLE_MESH_CID_NVAL;
+        break;
+    case ESP_BLE_MESH_MODEL_OP_NODE_RESET:
+        break;
+    default:
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    return esp_ble_mesh_config_client_set_state(&common, &set_state);
+}
+
+static esp_err_t send_generic_command(esp_ble_mesh_client_common_param_t &common, const mesh_command &cmd)
+{
+    switch (cmd.opcode)
+    {
+    case ESP_BLE_MESH_MODEL_OP_GEN_ONOFF_GET:
+    case ESP_BLE_MESH_MODEL_OP_GEN_LEVEL_GET:
+    {
+        esp_ble_mesh_generic_client_get_state_t get_state = {0};
+        return esp_ble_mesh_generic_client_get_state(&common, &get_state);
+    }
+    case ESP_BLE_MESH_MODEL_OP_GEN_ONOFF_SET:
+    {
+        esp_ble_mesh_generic_client_set_state_t set_state = {0};
+        set_state.onoff_set.op_en = false;
+        set_state.onoff_set.onoff = cmd.params.onoff;
+        set_state.onoff_set.tid = store.tid++;
+        return esp_ble_mesh_generic_client_set_state(&common, &set_state);
+    }
+    default:
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+}
+
+static esp_err_t send_light_command(esp_ble_mesh_client_common_param_t &common, const mesh_command &cmd)
+{
+    esp_ble_mesh_light_client_set_state_t set_state = {0};
+    switch (cmd.opcode)
+    {
+    case ESP_BLE_MESH_MODEL_OP_LIGHT_LIGHTNESS_SET:
+        set_state.lightness_set.lightness = cmd.params.lightness;
+        set_state.lightness_set.op_en = false;
+        set_state.lightness_set.delay = 0;
+        set_state.lightness_set.tid = store.tid++;
+        break;
+    case ESP_BLE_MESH_MODEL_OP_LIGHT_HSL_SET:
+        set_state.hsl_set.hsl_hue = cmd.params.hsl.hue;
+        set_state.hsl_set.hsl_saturation = cmd.params.hsl.saturation;
+        set_state.hsl_set.hsl_lightness = cmd.params.hsl.lightness;
+        set_state.hsl_set.op_en = false;
+        set_state.hsl_set.delay = 0;
+        set_state.hsl_set.tid = store.tid++;
+        break;
+    case ESP_BLE_MESH_MODEL_OP_LIGHT_CTL_SET:
+        set_state.ctl_set.ctl_temperature = cmd.params.ctl.temperature;
+        set_state.ctl_set.ctl_lightness = cmd.params.ctl.lightness;
+        set_state.ctl_set.ctl_delta_uv = 0;
+        set_state.ctl_set.op_en = false;
+        set_state.ctl_set.delay = 0;
+        set_state.ctl_set.tid = store.tid++;
+        break;
+    case ESP_BLE_MESH_MODEL_OP_LIGHT_LIGHTNESS_GET:
+    case ESP_BLE_MESH_MODEL_OP_LIGHT_LIGHTNESS_RANGE_GET:
+    case ESP_BLE_MESH_MODEL_OP_LIGHT_HSL_GET:
+    case ESP_BLE_MESH_MODEL_OP_LIGHT_HSL_RANGE_GET:
+    case ESP_BLE_MESH_MODEL_OP_LIGHT_CTL_GET:
+    case ESP_BLE_MESH_MODEL_OP_LIGHT_CTL_TEMPERATURE_GET:
+    case ESP_BLE_MESH_MODEL_OP_LIGHT_CTL_TEMPERATURE_RANGE_GET:
+    {
+        esp_ble_mesh_light_client_get_state_t get_state = {0};
+        return esp_ble_mesh_light_client_get_state(&common, &get_state);
+    }
+    default:
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    return esp_ble_mesh_light_client_set_state(&common, &set_state);
+}
+
+esp_err_t dispatch_mesh_command(const mesh_command &cmd, uint32_t timeout_ms)
+{
+    bm2mqtt_node_info *node = node_manager().get_node(cmd.dst);
+    if (!node)
+    {
+        ESP_LOGE(TAG, "[%s] No node owns address 0x%04X", __func__, cmd.dst);
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    if (cmd.type == message_type_t::mqtt_message)
+    {
+        if (cmd.params.mqtt == mqtt_action_t::discovery_and_status)
+        {
+            mqtt_send_discovery(node);
+            mqtt_node_send_availability(node, message_queue().is_reachable(node));
+            node->unpublished = FIELD_ALL;
+        }
+        // Home Assistant already has this state when nothing changed since the last publish
+        if (node->unpublished == 0)
+        {
+            ESP_LOGD(TAG, "[%s] Status of 0x%04X unchanged, not publishing", __func__, node->unicast);
+            return ESP_OK;
+        }
+        node->unpublished = 0;
+        mqtt_node_send_status(node);
+        return ESP_OK;
+    }
+
+    esp_ble_mesh_model_t *model = get_client_model(cmd.client);
+    if (!model)
+    {
+        ESP_LOGE(TAG, "[%s] No client model for opcode 0x%08" PRIX32, __func__, cmd.opcode);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    esp_ble_mesh_client_common_param_t common = {0};
+    node_manager().example_ble_mesh_set_msg_common(&common, node, model, cmd.opcode);
+    common.ctx.addr = cmd.dst;
+    if (timeout_ms > 0)
+    {
+        common.msg_timeout = timeout_ms;
+    }
+
+    esp_err_t err = ESP_ERR_NOT_SUPPORTED;
+    switch (cmd.client)
+    {
+    case mesh_client_t::config:
+        err = send_config_command(common, cmd);
+        break;
+    case mesh_client_t::generic_onoff:
+    case mesh_client_t::generic_level:
+        err = send_generic_command(common, cmd);
+        break;
+    case mesh_client_t::light_lightness:
+    case mesh_client_t::light_hsl:
+    case mesh_client_t::light_ctl:
+        err = send_light_command(common, cmd);
+        break;
+    default:
+        break;
+    }
+
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "[%s] Sending opcode 0x%08" PRIX32 " to 0x%04X failed (err %d)", __func__, cmd.opcode, cmd.dst, err);
+    }
+    return err;
+}
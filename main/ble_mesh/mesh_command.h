@@ -0,0 +1,109 @@
+#pragma once
+#include <cstdint>
+#include <type_traits>
+#include "esp_err.h"
+#include "esp_ble_mesh_defs.h"
+
+enum class message_type_t : uint8_t
+{
+    ble_mesh_message,
+    mqtt_message,
+};
+
+// What a queued command does. Pending commands of the same kind to the same
+// element are superseded by newer ones (latest wins), see message_queue::enqueue.
+enum class command_kind_t : uint8_t
+{
+    none,
+    onoff_set,
+    lightness_set,
+    hsl_set,
+    ctl_set,
+    status_publish,
+};
+
+// Client model a message goes through. The mesh stack only accepts one
+// outstanding acknowledged message per (client model, destination).
+enum class mesh_client_t : uint8_t
+{
+    none,
+    config,
+    generic_onoff,
+    generic_level,
+    light_lightness,
+    light_hsl,
+    light_ctl,
+};
+
+// Scheduling class of a command, lower values go first. Background commands are promoted
+// one class per BM2MQTT_MSG_QUEUE_AGING_MS spent waiting so they cannot starve.
+enum class command_priority_t : uint8_t
+{
+    interactive,   // Sets coming from MQTT, the web UI or the console
+    configuration, // Composition, app key and bindings
+    background,    // Refresh and telemetry gets
+    count,
+};
+
+enum class mqtt_action_t : uint8_t
+{
+    status,
+    discovery_and_status,
+};
+
+union mesh_command_params
+{
+    uint8_t onoff;
+    uint16_t lightness;
+    struct
+    {
+        uint16_t hue;
+        uint16_t saturation;
+        uint16_t lightness;
+    } hsl;
+    struct
+    {
+        uint16_t temperature;
+        uint16_t lightness;
+    } ctl;
+    struct
+    {
+        uint16_t element_addr;
+        uint16_t model_id;
+    } bind;
+    mqtt_action_t mqtt;
+};
+
+// Everything needed to (re)send one queued message, no captures and no heap.
+struct mesh_command
+{
+    uint32_t opcode;
+    uint16_t dst; // Element address
+    mesh_client_t client;
+    command_kind_t kind;
+    message_type_t type;
+    uint8_t retries_left;
+    command_priority_t priority;
+    mesh_command_params params;
+    int64_t enqueued_us; // Set by message_queue::enqueue, kept when a newer command supersedes it
+};
+
+static_assert(std::is_trivially_copyable_v<mesh_command>, "mesh_command must stay POD");
+
+mesh_client_t get_mesh_client(uint32_t opcode);
+
+mesh_command make_mesh_get(uint16_t dst, uint32_t opcode);
+mesh_command make_onoff_set(uint16_t dst, uint8_t onoff);
+mesh_command make_lightness_set(uint16_t dst, uint16_t lightness);
+mesh_command make_hsl_set(uint16_t dst, uint16_t hue, uint16_t saturation, uint16_t lightness);
+mesh_command make_ctl_set(uint16_t dst, uint16_t temperature, uint16_t lightness);
+mesh_command make_app_key_add(uint16_t dst);
+mesh_command make_model_app_bind(uint16_t dst, uint16_t element_addr, uint16_t model_id);
+mesh_command make_node_reset(uint16_t dst, uint8_t retries);
+mesh_command make_mqtt_marker(uint16_t dst, mqtt_action_t action, command_priority_t priority);
+
+// Number of network PDUs the message takes on the advertising bearer (0 for MQTT markers)
+uint8_t mesh_command_airtime(const mesh_command &cmd);
+
+// timeout_ms is the mesh client timeout of acknowledged messages, unused for MQTT markers
+esp_err_t dispatch_mesh_command(const mesh_command &cmd, uint32_t timeout_ms = 0);
@@ -0,0 +1,140 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include "sdkconfig.h"
+#include "latency_histogram.h"
+
+// Counters of acknowledged mesh messages, what a node keeps when its histograms are disabled
+// (CONFIG_BM2MQTT_NODE_LATENCY_HISTOGRAMS) to save RAM on large fleets.
+struct mesh_counter_stats
+{
+    uint32_t sent = 0;
+    uint32_t retries = 0;
+    uint32_t timeouts = 0;
+    uint32_t acked = 0;
+    uint32_t dropped = 0; // Given up after the last retry, or refused by the mesh stack
+
+    void on_send(int64_t /*queued_us*/, bool retry)
+    {
+        if (retry)
+            retries++;
+        else
+            sent++;
+    }
+
+    void on_ack(int64_t /*round_trip_us*/, int64_t /*total_us*/) { acked++; }
+
+    void on_timeout(bool given_up)
+    {
+        timeouts++;
+        if (given_up)
+            dropped++;
+    }
+
+    void on_dispatch_failed() { dropped++; }
+
+    void reset() { *this = mesh_counter_stats{}; }
+};
+
+// Counters and latencies of acknowledged mesh messages. One instance per node and one per
+// opcode, updated by message_queue under its lock with a few increments per message.
+struct mesh_latency_stats : mesh_counter_stats
+{
+    latency_histogram queued;     // Enqueue to first transmission
+    latency_histogram round_trip; // First transmission to ack, retries included
+    latency_histogram total;      // Enqueue to ack
+
+    void on_send(int64_t queued_us, bool retry)
+    {
+        mesh_counter_stats::on_send(queued_us, retry);
+        if (!retry)
+            queued.record(queued_us);
+    }
+
+    void on_ack(int64_t round_trip_us, int64_t total_us)
+    {
+        mesh_counter_stats::on_ack(round_trip_us, total_us);
+        round_trip.record(round_trip_us);
+        total.record(total_us);
+    }
+
+    void reset() { *this = mesh_latency_stats{}; }
+};
+
+#if CONFIG_BM2MQTT_NODE_LATENCY_HISTOGRAMS
+using node_latency_stats = mesh_latency_stats;
+#else
+using node_latency_stats = mesh_counter_stats;
+#endif
+
+// What the stats JSON reports of a histogram and of a message stream, small enough to be copied
+// under the queue lock so the JSON is written once it is released
+struct histogram_summary
+{
+    uint32_t n, p50, p90, p99, max;
+
+    static histogram_summary of(const latency_histogram &histogram)
+    {
+        return {histogram.count(), histogram.percentile(50), histogram.percentile(90), histogram.percentile(99), histogram.max()};
+    }
+};
+
+struct stream_summary
+{
+    mesh_counter_stats counters;
+    bool has_latency;
+    histogram_summary queued, round_trip, total;
+
+    static stream_summary of(const mesh_counter_stats &stats) { return {.counters = stats, .has_latency = false, .queued = {}, .round_trip = {}, .total = {}}; }
+
+    static stream_summary of(const mesh_latency_stats &stats)
+    {
+        return {.counters = stats, .has_latency = true, .queued = histogram_summary::of(stats.queued),
+                .round_trip = histogram_summary::of(stats.round_trip), .total = histogram_summary::of(stats.total)};
+    }
+};
+
+// The bridge only uses a handful of opcodes, they get a slot each in order of first use.
+// Opcodes past the table share the last slot, reported as "other".
+class opcode_stats_table
+{
+public:
+    static constexpr size_t slot_count = 16;
+    static constexpr uint32_t other_opcode = 0xFFFFFFFF;
+
+    mesh_latency_stats &get(uint32_t opcode)
+    {
+        for (size_t i = 0; i < used; i++)
+        {
+            if (opcodes[i] == opcode)
+                return stats[i];
+        }
+        if (used < slot_count - 1)
+        {
+            opcodes[used] = opcode;
+            return stats[used++];
+        }
+        opcodes[slot_count - 1] = other_opcode;
+        return stats[slot_count - 1];
+    }
+
+    template <typename F>
+    void for_each(F &&f) const
+    {
+        for (size_t i = 0; i < used; i++)
+        {
+            f(opcodes[i], stats[i]);
+        }
+        if (opcodes[slot_count - 1] == other_opcode)
+        {
+            f(other_opcode, stats[slot_count - 1]);
+        }
+    }
+
+    void reset() { *this = opcode_stats_table{}; }
+
+private:
+    std::array<uint32_t, slot_count> opcodes{};
+    std::array<mesh_latency_stats, slot_count> stats{};
+    size_t used = 0;
+};
@@ -1,11 +1,19 @@
 #include "message_queue.h"
 #include "esp_log.h"
-#include <map>
 #include <esp_console.h>
+#include <esp_system.h>
+#include <argtable3/argtable3.h>
 #include "debug/debug_commands_registry.h"
 #include "debug/console_cmd.h"
+#include <bit>
 #include <esp_timer.h>
+#include "timer/timer_wheel.h"
+#include "ble_mesh_control.h"
+#include "mqtt/mqtt_control.h"
 #include <esp_ble_mesh_defs.h>
+#include <algorithm>
+#include <cstdarg>
+#include <cstdio>
 
 static const char *TAG = "MessageQueue";
 
@@ -15,188 +23,1052 @@ message_queue_manager &message_queue()
     return instance;
 }
 
-void message_queue::enqueue(const message_payload &msg)
+static constexpr int32_t drr_quantum = 4; // PDUs, at least the longest message we send
+static constexpr int64_t pdu_interval_us = 1000000 / CONFIG_BM2MQTT_MESH_TX_RATE;
+static constexpr int64_t aging_us = CONFIG_BM2MQTT_MSG_QUEUE_AGING_MS * 1000;
+static constexpr uint32_t probe_min_ms = CONFIG_BM2MQTT_NODE_PROBE_MIN_S * 1000;
+static constexpr uint32_t probe_max_ms = std::max(CONFIG_BM2MQTT_NODE_PROBE_MAX_S, CONFIG_BM2MQTT_NODE_PROBE_MIN_S) * 1000;
+
+// Configuration messages change what the node answers to (app keys, bindings),
+// so they are never pipelined: they wait for the node to go idle and nothing of
+// the same or a lower class is sent past them until they complete. MQTT markers
+// keep their place the same way.
+static bool is_barrier(const mesh_command &cmd)
+{
+    if (cmd.type == message_type_t::mqtt_message)
+        return true;
+
+    return cmd.client == mesh_client_t::config || cmd.client == mesh_client_t::none;
+}
+
+static bool is_marker(const mesh_command &cmd)
+{
+    return cmd.type == message_type_t::mqtt_message;
+}
+
+static command_priority_t effective_priority(const mesh_command &cmd, int64_t now)
+{
+    const int64_t promotions = (now - cmd.enqueued_us) / aging_us;
+    return (command_priority_t)std::max<int64_t>(0, (int64_t)cmd.priority - promotions);
+}
+
+bool message_queue::enqueue(const mesh_command &command)
 {
-    queue.push(msg);
-    if (!waiting)
+    mesh_command cmd = command;
+    cmd.enqueued_us = esp_timer_get_time();
+
+    if (cmd.kind != command_kind_t::none)
     {
-        try_send_next();
+        for (size_t i = 0; i < pending.size(); i++)
+        {
+            if (pending[i].kind != cmd.kind || pending[i].dst != cmd.dst || pending[i].priority != cmd.priority)
+                continue;
+
+            coalesced++;
+            ESP_LOGD(TAG, "[%s] Superseding pending opcode 0x%08" PRIX32 " to 0x%04X", __func__, pending[i].opcode, pending[i].dst);
+
+            // Latency and aging count from the first request
+            cmd.enqueued_us = pending[i].enqueued_us;
+
+            // The newer command moves to the tail. Kinds overlap (lightness, HSL and CTL sets all
+            // carry lightness), a set left in the old place would be overridden by the older sets
+            // queued after it. A status publish has to reflect everything queued before it.
+            pending.erase(i);
+            break;
+        }
     }
+
+    if (!pending.push_back(cmd))
+    {
+        dropped++;
+        ESP_LOGE(TAG, "[%s] Queue for node 0x%04X is full, dropping opcode 0x%08" PRIX32, __func__, unicast, cmd.opcode);
+        return false;
+    }
+
+    return true;
 }
 
-void message_queue::try_send_next()
+bool message_queue::can_send(const mesh_command &cmd) const
 {
-    if (queue.empty())
-        return;
+    for (size_t i = 0; i < in_flight.size(); i++)
+    {
+        const mesh_command &flying = in_flight[i].cmd;
+        if (flying.dst == cmd.dst && flying.client == cmd.client)
+            return false;
+    }
+    return true;
+}
 
-    auto &msg = queue.front();
-    msg.send();
-    if (msg.type == message_type_t::ble_mesh_message)
+// A marker is published once nothing of its class or higher is still ahead of it or in flight
+bool message_queue::marker_ready(size_t index) const
+{
+    const mesh_command &marker = pending[index];
+    for (size_t i = 0; i < index; i++)
+    {
+        if (pending[i].priority <= marker.priority)
+            return false;
+    }
+    for (size_t i = 0; i < in_flight.size(); i++)
+    {
+        if (in_flight[i].cmd.priority <= marker.priority)
+            return false;
+    }
+    return true;
+}
+
+void message_queue::flush_markers()
+{
+    size_t i = 0;
+    while (i < pending.size())
     {
-        waiting = true;
+        if (!is_marker(pending[i]) || !marker_ready(i))
+        {
+            i++;
+            continue;
+        }
 
-        ensure_failsafe_timer();
-        esp_timer_start_once(failsafe_timer, 10 * 1000000); // 10 sec
+        ::message_queue().publish_marker(pending[i]);
+        pending.erase(i);
     }
-    else if (msg.type == message_type_t::mqtt_message)
+}
+
+// Highest effective class first, FIFO within a class. Commands held back by a barrier
+// or sharing a client and element with a message in flight are skipped.
+int message_queue::next_sendable() const
+{
+    if (in_flight.full() || (!in_flight.empty() && is_barrier(in_flight.front().cmd)))
+        return -1;
+
+    const int64_t now = esp_timer_get_time();
+    int best = -1;
+    command_priority_t best_priority = command_priority_t::count;
+    command_priority_t barrier_floor = command_priority_t::count; // Classes at or below it are held back
+    for (size_t i = 0; i < pending.size(); i++)
     {
-        // For MQTT messages, we don't need a failsafe timer
-        waiting = false;
-        queue.pop();
-        try_send_next();
+        const mesh_command &cmd = pending[i];
+        const bool blocked = cmd.priority >= barrier_floor;
+        if (is_barrier(cmd))
+        {
+            barrier_floor = std::min(barrier_floor, cmd.priority);
+        }
+        if (blocked || is_marker(cmd))
+            continue;
+
+        if (is_barrier(cmd) ? !in_flight.empty() : !can_send(cmd))
+            continue;
+
+        // On a tie the command promoted by aging gives way to one queued in that class
+        const command_priority_t priority = effective_priority(cmd, now);
+        if (priority < best_priority || (priority == best_priority && cmd.priority < pending[best].priority))
+        {
+            best = i;
+            best_priority = priority;
+        }
     }
+    return best;
+}
 
-    ESP_LOGI(TAG, "[%s] Sent message with opcode 0x%08X, retries left: %u", __func__, msg.opcode, msg.retries_left);
+command_priority_t message_queue::next_priority(size_t index) const
+{
+    return effective_priority(pending[index], esp_timer_get_time());
 }
 
-void message_queue::handle_ack(uint32_t opcode)
+bool message_queue::send_pending(size_t index)
 {
-    ESP_LOGW(TAG, "[%s] Ack received for opcode 0x%08X", __func__, opcode);
-    if (!queue.empty() && queue.front().opcode == opcode)
+    in_flight.push_back(in_flight_entry{.cmd = pending[index], .deadline_us = 0, .sent_us = 0, .first_sent_us = 0, .transmissions = 0});
+    pending.erase(index);
+    if (send(in_flight.back()))
+        return true;
+
+    drop_unsent(in_flight.size() - 1);
+    return false;
+}
+
+// Nothing went on air when the dispatch fails, so no airtime is charged and no deadline armed
+bool message_queue::send(in_flight_entry &entry)
+{
+    const uint32_t timeout_ms = rtt.timeout_ms(entry.transmissions);
+    const esp_err_t err = dispatch_mesh_command(entry.cmd, timeout_ms);
+    if (err != ESP_OK)
     {
-        esp_timer_stop(failsafe_timer);
-        queue.pop();
-        waiting = false;
-        try_send_next();
+        ESP_LOGE(TAG, "[%s] Dispatch of opcode 0x%08" PRIX32 " to 0x%04X failed: %s",
+                 __func__, entry.cmd.opcode, entry.cmd.dst, esp_err_to_name(err));
+        return false;
     }
-    else if (!queue.empty())
+    ::message_queue().consume_airtime(mesh_command_airtime(entry.cmd));
+    entry.sent_us = esp_timer_get_time();
+    if (entry.transmissions == 0)
     {
-        ESP_LOGW(TAG, " [%s]  Opcode 0x%08X not found in the front [0x%08X] of the queue, waiting for next message", __func__, opcode, queue.front().opcode);
+        entry.first_sent_us = entry.sent_us;
     }
+    const bool retry = entry.transmissions > 0;
+    stats.on_send(entry.sent_us - entry.cmd.enqueued_us, retry);
+    ::message_queue().opcode_stats.get(entry.cmd.opcode).on_send(entry.sent_us - entry.cmd.enqueued_us, retry);
+    entry.transmissions++;
+    // The mesh client reports the timeout itself, the failsafe only covers a lost callback
+    entry.deadline_us = entry.sent_us + (2 * (int64_t)timeout_ms + 1000) * 1000;
+    arm_failsafe_timer();
+
+    ESP_LOGI(TAG, "[%s] Sent message with opcode 0x%08" PRIX32 " to 0x%04X, retries left: %u, in flight: %zu",
+             __func__, entry.cmd.opcode, entry.cmd.dst, entry.cmd.retries_left, in_flight.size());
+    return true;
+}
+
+void message_queue::drop_unsent(size_t index)
+{
+    const in_flight_entry &entry = in_flight[index];
+    ESP_LOGE(TAG, "Message dropped: opcode 0x%08" PRIX32 " to 0x%04X", entry.cmd.opcode, entry.cmd.dst);
+    stats.on_dispatch_failed();
+    ::message_queue().opcode_stats.get(entry.cmd.opcode).on_dispatch_failed();
+    in_flight.erase(index);
+    arm_failsafe_timer();
+}
 
-    ESP_LOGW(TAG, "[%s] Current queue size: %zu", __func__, queue.size());
+int message_queue::find_in_flight(uint32_t opcode, uint16_t addr) const
+{
+    for (size_t i = 0; i < in_flight.size(); i++)
+    {
+        if (in_flight[i].cmd.opcode == opcode && in_flight[i].cmd.dst == addr)
+            return i;
+    }
+    return -1;
 }
 
-void message_queue::handle_timeout(uint32_t opcode)
+void message_queue::handle_ack(uint32_t opcode, uint16_t addr)
 {
-    if (queue.empty())
+    ESP_LOGW(TAG, "[%s] Ack received for opcode 0x%08" PRIX32 " from 0x%04X", __func__, opcode, addr);
+    consecutive_timeouts = 0;
+    int index = find_in_flight(opcode, addr);
+    if (index >= 0)
+    {
+        const in_flight_entry &entry = in_flight[index];
+        const int64_t now = esp_timer_get_time();
+        if (entry.transmissions == 1)
+        {
+            // Karn's rule: the ack of a retransmitted message cannot be matched to one send
+            rtt.sample(now - entry.sent_us);
+        }
+        stats.on_ack(now - entry.first_sent_us, now - entry.cmd.enqueued_us);
+        ::message_queue().opcode_stats.get(opcode).on_ack(now - entry.first_sent_us, now - entry.cmd.enqueued_us);
+        ::message_queue().record_latency(entry.cmd);
+        in_flight.erase(index);
+        arm_failsafe_timer();
+    }
+    else
+    {
+        ESP_LOGW(TAG, " [%s]  Opcode 0x%08" PRIX32 " from 0x%04X is not in flight (%zu in flight)", __func__, opcode, addr, in_flight.size());
+    }
+
+    ESP_LOGW(TAG, "[%s] Current queue size: %zu", __func__, size());
+}
+
+void message_queue::handle_timeout(uint32_t opcode, uint16_t addr)
+{
+    int index = find_in_flight(opcode, addr);
+    if (index < 0)
         return;
 
-    auto &msg = queue.front();
-    if (msg.opcode == opcode)
+    in_flight_entry &entry = in_flight[index];
+    rtt.count_timeout();
+    if (consecutive_timeouts < UINT8_MAX)
+        consecutive_timeouts++;
+
+    // Once the node looks down only configuration is worth retrying
+    const bool node_down = !reachable || consecutive_timeouts >= CONFIG_BM2MQTT_NODE_UNREACHABLE_TIMEOUTS;
+    const bool retry = (!node_down || entry.cmd.priority == command_priority_t::configuration) &&
+                       entry.cmd.retries_left > 0 && --entry.cmd.retries_left > 0;
+    stats.on_timeout(!retry);
+    ::message_queue().opcode_stats.get(opcode).on_timeout(!retry);
+    if (retry)
     {
-        if (msg.retries_left > 0 && --msg.retries_left > 0)
+        ESP_LOGW(TAG, "Retrying opcode 0x%08" PRIX32 " to 0x%04X, timeout %" PRIu32 " ms", opcode, addr, rtt.timeout_ms(entry.transmissions));
+        if (!send(entry))
+            drop_unsent(index);
+    }
+    else
+    {
+        ESP_LOGE(TAG, "Message dropped: opcode 0x%08" PRIX32 " to 0x%04X", opcode, addr);
+        in_flight.erase(index);
+        arm_failsafe_timer();
+    }
+
+    ESP_LOGW(TAG, "[%s] Timeout for opcode 0x%08" PRIX32, __func__, opcode);
+    ESP_LOGW(TAG, "[%s] Current queue size: %zu", __func__, size());
+}
+
+void message_queue::clear()
+{
+    timer_wheel().stop(failsafe_timer);
+    pending.clear();
+    in_flight.clear();
+    deficit = 0;
+    quantum_granted = false;
+    rtt.reset();
+    stats.reset();
+    mark_reachable();
+    unicast = ESP_BLE_MESH_ADDR_UNASSIGNED;
+    node = node_handle{};
+}
+
+// Markers are answered with the state we have, once the queue lock is released, and commands
+// that could only time out are rejected. Configuration (bindings, node reset) keeps its place.
+void message_queue::mark_unreachable()
+{
+    reachable = false;
+    probe_delay_ms = probe_min_ms;
+
+    size_t i = 0;
+    while (i < pending.size())
+    {
+        if (pending[i].priority == command_priority_t::configuration)
+        {
+            i++;
+            continue;
+        }
+
+        if (is_marker(pending[i]))
         {
-            ESP_LOGW(TAG, "Retrying opcode 0x%08X", opcode);
-            waiting = false;
-            try_send_next();
+            ::message_queue().publish_marker(pending[i]);
         }
         else
         {
-            ESP_LOGE(TAG, "Message dropped: opcode 0x%08X", opcode);
-            esp_timer_stop(failsafe_timer);
-            queue.pop();
-            waiting = false;
-            try_send_next();
+            rejected++;
         }
+        pending.erase(i);
     }
+}
 
-    ESP_LOGW(TAG, "[%s] Timeout for opcode 0x%08X", __func__, opcode);
-    ESP_LOGW(TAG, "[%s] Current queue size: %zu", __func__, queue.size());
+void message_queue::mark_reachable()
+{
+    reachable = true;
+    consecutive_timeouts = 0;
+    probe_delay_ms = 0;
+    timer_wheel().stop(probe_timer);
 }
 
-void message_queue::ensure_failsafe_timer()
+// Exponential backoff between probes, from NODE_PROBE_MIN_S up to NODE_PROBE_MAX_S
+void message_queue::arm_probe()
 {
-    if (!failsafe_timer)
+    if (!probe_timer.callback)
     {
-        esp_timer_create_args_t args = {
-            .callback = &message_queue::failsafe_callback,
-            .arg = this,
-            .name = "msgqueue_failsafe"};
-        esp_timer_create(&args, &failsafe_timer);
+        timer_wheel().init_timer(probe_timer, &message_queue::probe_callback, this, "node_probe");
     }
-    else
+    if (timer_wheel().is_active(probe_timer))
+        return;
+
+    ESP_LOGI(TAG, "[%s] Probing node 0x%04X in %" PRIu32 " s", __func__, unicast, probe_delay_ms / 1000);
+    timer_wheel().start_once(probe_timer, (uint64_t)probe_delay_ms * 1000);
+    probe_delay_ms = std::min(probe_delay_ms * 2, probe_max_ms);
+}
+
+void message_queue::probe_callback(void *arg)
+{
+    ::message_queue().on_probe(static_cast<message_queue *>(arg));
+}
+
+// One wheel timer per node, armed on the earliest deadline of the messages in flight.
+void message_queue::arm_failsafe_timer()
+{
+    if (in_flight.empty())
     {
-        esp_timer_stop(failsafe_timer);
+        timer_wheel().stop(failsafe_timer);
+        return;
+    }
+
+    if (!failsafe_timer.callback)
+    {
+        timer_wheel().init_timer(failsafe_timer, &message_queue::failsafe_callback, this, "msgqueue_failsafe");
     }
+
+    int64_t earliest = in_flight.front().deadline_us;
+    for (size_t i = 0; i < in_flight.size(); i++)
+    {
+        earliest = std::min(earliest, in_flight[i].deadline_us);
+    }
+
+    const int64_t delay = earliest - esp_timer_get_time();
+    timer_wheel().start_once(failsafe_timer, delay > 0 ? delay : 0);
 }
 
 void message_queue::failsafe_callback(void *arg)
 {
-    auto *self = static_cast<message_queue *>(arg);
-    self->on_failsafe_trigger();
+    ::message_queue().on_failsafe(static_cast<message_queue *>(arg));
 }
 
 void message_queue::on_failsafe_trigger()
 {
-    if (!queue.empty())
+    const int64_t now = esp_timer_get_time();
+    struct expired_entry
+    {
+        uint32_t opcode;
+        uint16_t addr;
+    };
+    static_ring<expired_entry, CONFIG_BM2MQTT_MSG_QUEUE_INFLIGHT_WINDOW> expired;
+    for (size_t i = 0; i < in_flight.size(); i++)
+    {
+        if (in_flight[i].deadline_us <= now)
+            expired.push_back(expired_entry{in_flight[i].cmd.opcode, in_flight[i].cmd.dst});
+    }
+
+    for (size_t i = 0; i < expired.size(); i++)
     {
-        ESP_LOGE(TAG, "Failsafe timeout for opcode 0x%08X", queue.front().opcode);
-        handle_timeout(queue.front().opcode); // acts like timeout handler
+        ESP_LOGE(TAG, "Failsafe timeout for opcode 0x%08" PRIX32 " to 0x%04X", expired[i].opcode, expired[i].addr);
+        handle_timeout(expired[i].opcode, expired[i].addr); // acts like timeout handler
     }
+
+    arm_failsafe_timer();
 }
 
-void message_queue_manager::enqueue(bm2mqtt_node_info *node, const message_payload &msg)
+class message_queue *message_queue_manager::get_queue(const bm2mqtt_node_info *node)
 {
-    ESP_LOGD(TAG, "[%s] Enqueueing message for node 0x%04X, opcode 0x%08X", __func__, node->unicast, msg.opcode);
-    node_queues[node].enqueue(msg);
+    const uint16_t slot = node_manager().get_slot(node);
+    if (slot >= node_queues.size())
+    {
+        ESP_LOGE(TAG, "Node 0x%04X is not tracked by the node manager", node->unicast);
+        return nullptr;
+    }
+    return &node_queues[slot];
 }
 
-void message_queue_manager::handle_ack(bm2mqtt_node_info *node, uint32_t opcode)
+void message_queue_manager::enqueue(bm2mqtt_node_info *node, const mesh_command &cmd)
 {
-    ESP_LOGI(TAG, "[%s] Ack for opcode 0x%08X on node 0x%04X", __func__, opcode, node->unicast);
-    auto it = node_queues.find(node);
-    if (it != node_queues.end())
+    ESP_LOGD(TAG, "[%s] Enqueueing message for node 0x%04X, opcode 0x%08" PRIX32, __func__, node->unicast, cmd.opcode);
+    queue_lock lock(*this);
+    if (class message_queue *queue = get_queue(node))
     {
-        it->second.handle_ack(opcode);
+        queue->set_unicast(node->unicast);
+        queue->set_node(node_manager().get_handle(node));
+        if (!queue->is_reachable() && cmd.priority != command_priority_t::configuration)
+        {
+            // Answered right away, the node is refreshed once a probe gets through
+            if (is_marker(cmd))
+            {
+                publish_marker(cmd);
+            }
+            else
+            {
+                queue->rejected++;
+                ESP_LOGW(TAG, "[%s] Node 0x%04X is unreachable, rejecting opcode 0x%08" PRIX32, __func__, node->unicast, cmd.opcode);
+            }
+            return;
+        }
+        queue->enqueue(cmd);
+        set_active(*queue, true);
+        schedule();
     }
-    else
+}
+
+void message_queue_manager::handle_ack(bm2mqtt_node_info *node, uint32_t opcode, uint16_t addr)
+{
+    ESP_LOGI(TAG, "[%s] Ack for opcode 0x%08" PRIX32 " on node 0x%04X", __func__, opcode, node->unicast);
+    queue_lock lock(*this);
+    class message_queue *queue = get_queue(node);
+    if (!queue)
+        return;
+
+    queue->handle_ack(opcode, addr);
+
+    if (!queue->is_reachable())
     {
-        ESP_LOGE(TAG, "No message queue found for node 0x%04X", node->unicast);
+        ESP_LOGI(TAG, "[%s] Node 0x%04X answered, marking it reachable", __func__, node->unicast);
+        queue->mark_reachable();
+        publish_availability(queue, true);
+        if (opcode != ESP_BLE_MESH_MODEL_OP_NODE_RESET)
+        {
+            refresh_node(node);
+        }
     }
 
-    if (opcode == ESP_BLE_MESH_MODEL_OP_NODE_RESET && it->second.size() == 0)
+    if (opcode == ESP_BLE_MESH_MODEL_OP_NODE_RESET && queue->size() == 0)
     {
         // Special handling for node reset
-        ESP_LOGW(TAG, "[%s] Node reset opcode 0x%08X received, removing node queue", __func__, opcode);
-        node_queues.erase(node);
+        ESP_LOGW(TAG, "[%s] Node reset opcode 0x%08" PRIX32 " received, clearing node queue", __func__, opcode);
+        queue->clear();
     }
+    schedule();
 }
 
-void message_queue_manager::handle_timeout(bm2mqtt_node_info *node, uint32_t opcode)
+void message_queue_manager::handle_timeout(bm2mqtt_node_info *node, uint32_t opcode, uint16_t addr)
 {
-    ESP_LOGW(TAG, "[%s] Timeout for opcode 0x%08X on node 0x%04X", __func__, opcode, node->unicast);
-    auto it = node_queues.find(node);
-    if (it != node_queues.end())
+    ESP_LOGW(TAG, "[%s] Timeout for opcode 0x%08" PRIX32 " on node 0x%04X", __func__, opcode, node->unicast);
+    queue_lock lock(*this);
+    class message_queue *queue = get_queue(node);
+    if (!queue)
+        return;
+
+    queue->handle_timeout(opcode, addr);
+
+    if (opcode == ESP_BLE_MESH_MODEL_OP_NODE_RESET && queue->size() == 0)
     {
-        it->second.handle_timeout(opcode);
+        // Special handling for node reset
+        ESP_LOGW(TAG, "[%s] Node reset opcode 0x%08" PRIX32 " timed out, clearing node queue", __func__, opcode);
+        queue->clear();
     }
-    else
+    update_reachability(queue);
+    schedule();
+}
+
+void message_queue_manager::on_failsafe(class message_queue *queue)
+{
+    queue_lock lock(*this);
+    queue->on_failsafe_trigger();
+    update_reachability(queue);
+    schedule();
+}
+
+void message_queue_manager::on_probe(class message_queue *queue)
+{
+    queue_lock lock(*this);
+    if (queue->is_reachable() || queue->get_unicast() == ESP_BLE_MESH_ADDR_UNASSIGNED)
+        return;
+
+    // A single transmission, enqueued past the breaker
+    mesh_command probe = make_mesh_get(queue->get_unicast(), ESP_BLE_MESH_MODEL_OP_GEN_ONOFF_GET);
+    probe.retries_left = 1;
+    queue->enqueue(probe);
+    set_active(*queue, true);
+    schedule();
+}
+
+void message_queue_manager::update_reachability(class message_queue *queue)
+{
+    if (queue->is_reachable())
+    {
+        if (queue->consecutive_timeouts < CONFIG_BM2MQTT_NODE_UNREACHABLE_TIMEOUTS)
+            return;
+
+        ESP_LOGW(TAG, "[%s] Node 0x%04X missed %u acks in a row, marking it unreachable",
+                 __func__, queue->get_unicast(), queue->consecutive_timeouts);
+        queue->mark_unreachable();
+        publish_availability(queue, false);
+    }
+
+    // Next probe once whatever is still in flight has timed out
+    if (!queue->is_waiting())
     {
-        ESP_LOGE(TAG, "No message queue found for node 0x%04X", node->unicast);
+        queue->arm_probe();
     }
+}
 
-    if (opcode == ESP_BLE_MESH_MODEL_OP_NODE_RESET && it->second.size() == 0)
+message_queue_manager::queue_lock::queue_lock(message_queue_manager &manager) : manager(manager)
+{
+    manager.queue_mutex.lock();
+    manager.lock_depth++;
+}
+
+message_queue_manager::queue_lock::~queue_lock()
+{
+    const bool outermost = --manager.lock_depth == 0;
+    manager.queue_mutex.unlock();
+    if (outermost)
     {
-        // Special handling for node reset
-        ESP_LOGW(TAG, "[%s] Node reset opcode 0x%08X received, removing node queue", __func__, opcode);
-        node_queues.erase(node);
+        manager.send_publishes();
     }
 }
 
+void message_queue_manager::publish_availability(const class message_queue *queue, bool available)
+{
+    outbox.push_back(mqtt_publish{
+        .kind = available ? mqtt_publish::kind_t::online : mqtt_publish::kind_t::offline,
+        .marker = {},
+        .node = queue->get_node()});
+}
+
+void message_queue_manager::publish_marker(const mesh_command &marker)
+{
+    record_latency(marker);
+    outbox.push_back(mqtt_publish{.kind = mqtt_publish::kind_t::marker, .marker = marker, .node = {}});
+}
+
+// A thread finding another one sending leaves its publishes to it, the sender checks the
+// outbox again after letting go of publish_mutex so nothing is left behind.
+void message_queue_manager::send_publishes()
+{
+    while (publish_mutex.try_lock())
+    {
+        while (true)
+        {
+            {
+                std::lock_guard<std::recursive_mutex> lock(queue_mutex);
+                if (outbox.empty())
+                    break;
+                std::swap(outbox, sending);
+            }
+
+            for (const mqtt_publish &publish : sending)
+            {
+                if (publish.kind == mqtt_publish::kind_t::marker)
+                {
+                    dispatch_mesh_command(publish.marker);
+                }
+                else if (const bm2mqtt_node_info *node = node_manager().get_node(publish.node))
+                {
+                    mqtt_node_send_availability(node, publish.kind == mqtt_publish::kind_t::online);
+                }
+            }
+            sending.clear();
+        }
+        publish_mutex.unlock();
+
+        std::lock_guard<std::recursive_mutex> lock(queue_mutex);
+        if (outbox.empty())
+            return;
+    }
+}
+
+bool message_queue_manager::is_reachable(const bm2mqtt_node_info *node)
+{
+    const class message_queue *queue = get_queue(node);
+    return !queue || queue->is_reachable();
+}
+
 void message_queue_manager::clear_queue(bm2mqtt_node_info *node)
 {
-    node_queues.erase(node);
+    queue_lock lock(*this);
+    if (class message_queue *queue = get_queue(node))
+    {
+        queue->clear();
+        schedule();
+    }
+}
+
+int64_t message_queue_manager::airtime_wait_us(uint8_t pdus) const
+{
+    const int64_t now = esp_timer_get_time();
+    const int64_t tat = std::max(airtime_tat_us, now);
+    return tat + (pdus - CONFIG_BM2MQTT_MESH_TX_BURST) * pdu_interval_us - now;
+}
+
+void message_queue_manager::consume_airtime(uint8_t pdus)
+{
+    airtime_tat_us = std::max(airtime_tat_us, esp_timer_get_time()) + pdus * pdu_interval_us;
+}
+
+void message_queue_manager::airtime_timer_callback(void *arg)
+{
+    auto *self = static_cast<message_queue_manager *>(arg);
+    queue_lock lock(*self);
+    self->schedule();
+}
+
+void message_queue_manager::record_latency(const mesh_command &cmd)
+{
+    latency[(size_t)cmd.priority].record(esp_timer_get_time() - cmd.enqueued_us);
+}
+
+void message_queue_manager::set_active(const class message_queue &queue, bool active)
+{
+    const size_t slot = &queue - node_queues.data();
+    const uint32_t bit = 1u << (slot % 32);
+    uint32_t &word = active_words[slot / 32];
+    if (active && !(word & bit))
+    {
+        word |= bit;
+        active_count++;
+    }
+    else if (!active && (word & bit))
+    {
+        word &= ~bit;
+        active_count--;
+    }
+}
+
+size_t message_queue_manager::next_active(size_t from) const
+{
+    for (size_t i = 0; i <= active_words.size(); i++)
+    {
+        const size_t word = (from / 32 + i) % active_words.size();
+        uint32_t bits = active_words[word];
+        if (i == 0)
+            bits &= ~0u << (from % 32);
+        if (bits != 0)
+            return word * 32 + std::countr_zero(bits);
+    }
+    return 0;
+}
+
+void message_queue_manager::schedule()
+{
+    // Only queues holding messages are visited, idle nodes cost nothing on large fleets
+    size_t in_flight_total = 0;
+    for (size_t word = 0; word < active_words.size(); word++)
+    {
+        for (uint32_t bits = active_words[word]; bits != 0; bits &= bits - 1)
+        {
+            class message_queue &queue = node_queues[word * 32 + std::countr_zero(bits)];
+            queue.flush_markers();
+            if (queue.size() == 0)
+            {
+                queue.deficit = 0;
+                queue.quantum_granted = false;
+                set_active(queue, false);
+                continue;
+            }
+            in_flight_total += queue.get_in_flight().size();
+        }
+    }
+
+    for (size_t priority = 0; priority < (size_t)command_priority_t::count; priority++)
+    {
+        if (!schedule_class((command_priority_t)priority, in_flight_total))
+            return;
+    }
+}
+
+// Deficit round robin over the nodes whose next message belongs to the given class. Each visit
+// grants a node drr_quantum PDUs, it sends while its deficit covers the next message, then the
+// next node gets its turn. When the global budget runs out the cursor stays put, so the
+// interrupted node resumes first.
+bool message_queue_manager::schedule_class(command_priority_t priority, size_t &in_flight_total)
+{
+    size_t idle_visits = 0;
+    if (active_count > 0)
+        drr_cursor = next_active(drr_cursor);
+    while (idle_visits < active_count)
+    {
+        class message_queue &queue = node_queues[drr_cursor];
+        const int index = queue.next_sendable();
+        if (index < 0 || queue.next_priority(index) != priority)
+        {
+            if (queue.get_pending().empty())
+            {
+                queue.deficit = 0;
+            }
+            queue.quantum_granted = false;
+            drr_cursor = next_active((drr_cursor + 1) % node_queues.size());
+            idle_visits++;
+            continue;
+        }
+
+        if (!queue.quantum_granted)
+        {
+            queue.deficit += drr_quantum;
+            queue.quantum_granted = true;
+        }
+
+        const uint8_t pdus = mesh_command_airtime(queue.get_pending()[index]);
+        if (pdus > queue.deficit)
+        {
+            // Share used up, it sent since its quantum was granted so this cannot spin
+            queue.quantum_granted = false;
+            drr_cursor = next_active((drr_cursor + 1) % node_queues.size());
+            continue;
+        }
+
+        if (in_flight_total >= CONFIG_BM2MQTT_MESH_MAX_INFLIGHT)
+        {
+            // Resumed by the next ack or timeout
+            deferred_in_flight++;
+            queue.deferred++;
+            return false;
+        }
+
+        const int64_t wait_us = airtime_wait_us(pdus);
+        if (wait_us > 0)
+        {
+            deferred_airtime++;
+            queue.deferred++;
+            if (!airtime_timer.callback)
+            {
+                timer_wheel().init_timer(airtime_timer, &airtime_timer_callback, this, "mesh_airtime");
+            }
+            timer_wheel().start_once(airtime_timer, wait_us);
+            return false;
+        }
+
+        if (queue.send_pending(index))
+        {
+            queue.deficit -= pdus;
+            in_flight_total++;
+        }
+        idle_visits = 0;
+    }
+    return true;
+}
+
+uint32_t message_queue_manager::get_msg_timeout_ms(const bm2mqtt_node_info *node)
+{
+    std::lock_guard<std::recursive_mutex> lock(queue_mutex);
+    if (class message_queue *queue = get_queue(node))
+    {
+        return queue->get_rtt().timeout_ms();
+    }
+    return rtt_estimator::initial_rto_us / 1000;
+}
+
+void message_queue_manager::reset_stats()
+{
+    std::lock_guard<std::recursive_mutex> lock(queue_mutex);
+    for (auto &histogram : latency)
+    {
+        histogram.reset();
+    }
+    deferred_in_flight = 0;
+    deferred_airtime = 0;
+    opcode_stats.reset();
+    for (auto &queue : node_queues)
+    {
+        queue.stats.reset();
+    }
+}
+
+#if !CONFIG_BM2MQTT_NODE_LATENCY_HISTOGRAMS
+// Nodes keep counters only
+static void print_stream(const char *label, const mesh_counter_stats &stats)
+{
+    ESP_LOGI(TAG, "%-14s sent %" PRIu32 ", retries %" PRIu32 ", timeouts %" PRIu32 ", acked %" PRIu32 ", dropped %" PRIu32,
+             label, stats.sent, stats.retries, stats.timeouts, stats.acked, stats.dropped);
+}
+#endif
+
+static void print_stream(const char *label, const mesh_latency_stats &stats)
+{
+    ESP_LOGI(TAG, "%-14s sent %" PRIu32 ", retries %" PRIu32 ", timeouts %" PRIu32 ", acked %" PRIu32 ", dropped %" PRIu32
+                  " | queued p50 %" PRIu32 " p99 %" PRIu32 " | rtt p50 %" PRIu32 " p99 %" PRIu32 " | total p50 %" PRIu32 " p99 %" PRIu32 " max %" PRIu32 " ms",
+             label, stats.sent, stats.retries, stats.timeouts, stats.acked, stats.dropped,
+             stats.queued.percentile(50), stats.queued.percentile(99),
+             stats.round_trip.percentile(50), stats.round_trip.percentile(99),
+             stats.total.percentile(50), stats.total.percentile(99), stats.total.max());
+}
+
+void message_queue_manager::print_stats() const
+{
+    std::lock_guard<std::recursive_mutex> lock(queue_mutex);
+    ESP_LOGI(TAG, "=== Mesh Stats ===");
+    char label[16];
+    for (const auto &queue : node_queues)
+    {
+        if (queue.get_unicast() == ESP_BLE_MESH_ADDR_UNASSIGNED)
+            continue;
+        snprintf(label, sizeof(label), "node 0x%04X", queue.get_unicast());
+        print_stream(label, queue.get_stats());
+    }
+    opcode_stats.for_each([&label](uint32_t opcode, const mesh_latency_stats &stats)
+    {
+        if (opcode == opcode_stats_table::other_opcode)
+            snprintf(label, sizeof(label), "other");
+        else
+            snprintf(label, sizeof(label), "op 0x%04" PRIX32, opcode);
+        print_stream(label, stats);
+    });
+}
+
+namespace
+{
+// Appends to a fixed buffer. A write that does not fit marks the writer full and leaves what was
+// written before it.
+class stats_writer
+{
+public:
+    stats_writer(char *data, size_t capacity) : data(data), capacity(capacity) { data[0] = '\0'; }
+
+    __attribute__((format(printf, 2, 3))) void append(const char *format, ...)
+    {
+        if (full)
+            return;
+
+        va_list args;
+        va_start(args, format);
+        const int written = vsnprintf(data + length, capacity - length, format, args);
+        va_end(args);
+        if (written < 0 || (size_t)written >= capacity - length)
+        {
+            full = true;
+            data[length] = '\0';
+            return;
+        }
+        length += written;
+    }
+
+    void rewind(size_t to)
+    {
+        length = to;
+        data[length] = '\0';
+        full = false;
+    }
+
+    size_t size() const { return length; }
+    size_t remaining() const { return capacity - length; }
+    bool is_full() const { return full; }
+
+private:
+    char *data;
+    size_t capacity;
+    size_t length = 0;
+    bool full = false;
+};
+} // namespace
+
+static void write_histogram(stats_writer &out, const char *key, const histogram_summary &histogram)
+{
+    out.append("\"%s\":{\"n\":%" PRIu32 ",\"p50\":%" PRIu32 ",\"p90\":%" PRIu32 ",\"p99\":%" PRIu32 ",\"max\":%" PRIu32 "}",
+               key, histogram.n, histogram.p50, histogram.p90, histogram.p99, histogram.max);
+}
+
+static void write_stream(stats_writer &out, const stream_summary &stream)
+{
+    const mesh_counter_stats &counters = stream.counters;
+    out.append("\"sent\":%" PRIu32 ",\"retries\":%" PRIu32 ",\"timeouts\":%" PRIu32 ",\"acked\":%" PRIu32 ",\"dropped\":%" PRIu32,
+               counters.sent, counters.retries, counters.timeouts, counters.acked, counters.dropped);
+    if (stream.has_latency)
+    {
+        out.append(",");
+        write_histogram(out, "queued_ms", stream.queued);
+        out.append(",");
+        write_histogram(out, "rtt_ms", stream.round_trip);
+        out.append(",");
+        write_histogram(out, "total_ms", stream.total);
+    }
+}
+
+// The snapshot only holds summaries, the lock is held for a copy per opcode and per node of the
+// page. Nothing is allocated once the buffer exists.
+size_t message_queue_manager::write_stats_json(size_t first_slot) const
+{
+    if (!stats_json)
+    {
+        stats_json = std::make_unique<stats_json_buffer>();
+    }
+    stats_json_buffer &page = *stats_json;
+
+    {
+        std::lock_guard<std::recursive_mutex> lock(queue_mutex);
+        for (size_t priority = 0; priority < latency.size(); priority++)
+        {
+            page.classes[priority] = histogram_summary::of(latency[priority]);
+        }
+        page.deferred_in_flight = deferred_in_flight;
+        page.deferred_airtime = deferred_airtime;
+
+        page.opcode_count = 0;
+        opcode_stats.for_each([&page](uint32_t opcode, const mesh_latency_stats &stats)
+        {
+            page.opcodes[page.opcode_count++] = opcode_stats_row{.opcode = opcode, .stream = stream_summary::of(stats)};
+        });
+
+        page.node_count = 0;
+        page.next_slot = 0;
+        for (size_t slot = first_slot; slot < node_queues.size(); slot++)
+        {
+            const class message_queue &queue = node_queues[slot];
+            if (queue.get_unicast() == ESP_BLE_MESH_ADDR_UNASSIGNED)
+                continue;
+            if (page.node_count == page.nodes.size())
+            {
+                page.next_slot = slot;
+                break;
+            }
+            page.nodes[page.node_count++] = node_stats_row{
+                .unicast = queue.get_unicast(),
+                .reachable = queue.is_reachable(),
+                .queued = (uint32_t)queue.size(),
+                .coalesced = queue.get_coalesced(),
+                .queue_full = queue.get_dropped(),
+                .rejected = queue.get_rejected(),
+                .srtt_ms = queue.get_rtt().srtt() / 1000,
+                .stream = stream_summary::of(queue.get_stats()),
+                .slot = slot};
+        }
+    }
+
+    static const char *class_names[] = {"interactive", "configuration", "background"};
+    stats_writer out(page.text.data(), page.text.size());
+    out.append("{\"classes\":{");
+    for (size_t priority = 0; priority < page.classes.size(); priority++)
+    {
+        out.append(priority > 0 ? "," : "");
+        write_histogram(out, class_names[priority], page.classes[priority]);
+    }
+    out.append("},\"deferred\":{\"in_flight\":%" PRIu32 ",\"airtime\":%" PRIu32 "}", page.deferred_in_flight, page.deferred_airtime);
+
+    out.append(",\"opcodes\":[");
+    for (size_t i = 0; i < page.opcode_count; i++)
+    {
+        const opcode_stats_row &row = page.opcodes[i];
+        if (row.opcode == opcode_stats_table::other_opcode)
+            out.append("%s{\"opcode\":\"other\",", i > 0 ? "," : "");
+        else
+            out.append("%s{\"opcode\":\"0x%04" PRIX32 "\",", i > 0 ? "," : "", row.opcode);
+        write_stream(out, row.stream);
+        out.append("}");
+    }
+
+    // Room for the closing bytes and "next" is kept, a node row that does not fit goes to the next page
+    static constexpr size_t tail_size = 32;
+    out.append("],\"nodes\":[");
+    for (size_t i = 0; i < page.node_count; i++)
+    {
+        const node_stats_row &row = page.nodes[i];
+        const size_t row_start = out.size();
+        out.append("%s{\"unicast\":\"0x%04X\",\"reachable\":%s,\"queued\":%" PRIu32 ",\"coalesced\":%" PRIu32
+                   ",\"queue_full\":%" PRIu32 ",\"rejected\":%" PRIu32 ",\"srtt_ms\":%" PRId64 ",",
+                   i > 0 ? "," : "", row.unicast, row.reachable ? "true" : "false", row.queued, row.coalesced,
+                   row.queue_full, row.rejected, row.srtt_ms);
+        write_stream(out, row.stream);
+        out.append("}");
+        if (out.is_full() || out.remaining() <= tail_size)
+        {
+            out.rewind(row_start);
+            page.next_slot = row.slot;
+            break;
+        }
+    }
+    out.append("]");
+    if (page.next_slot != 0)
+    {
+        out.append(",\"next\":%zu", page.next_slot);
+    }
+    out.append("}");
+
+    page.size = out.size();
+    return page.next_slot;
 }
 
 void message_queue_manager::print_debug() const
 {
+    std::lock_guard<std::recursive_mutex> lock(queue_mutex);
     ESP_LOGI(TAG, "=== Message Queue Status ===");
-    for (const auto &entry : node_queues)
+    static const char *class_names[] = {"interactive", "configuration", "background"};
+    for (size_t priority = 0; priority < latency.size(); priority++)
     {
-        const auto &queue = entry.second;
-        size_t queue_size = queue.size();
-        bool waiting = queue.is_waiting();
+        const latency_histogram &histogram = latency[priority];
+        ESP_LOGI(TAG, "Latency %-13s: %" PRIu32 " done, p50 %" PRIu32 " ms, p99 %" PRIu32 " ms, max %" PRIu32 " ms",
+                 class_names[priority], histogram.count(), histogram.percentile(50), histogram.percentile(99), histogram.max());
+    }
+    ESP_LOGI(TAG, "Budget: %d in flight, %d PDU/s (burst %d), deferred: %" PRIu32 " in flight limit, %" PRIu32 " airtime limit",
+             CONFIG_BM2MQTT_MESH_MAX_INFLIGHT, CONFIG_BM2MQTT_MESH_TX_RATE, CONFIG_BM2MQTT_MESH_TX_BURST,
+             deferred_in_flight, deferred_airtime);
+    for (size_t slot = 0; slot < node_queues.size(); slot++)
+    {
+        const auto &queue = node_queues[slot];
+        if (queue.get_unicast() == ESP_BLE_MESH_ADDR_UNASSIGNED)
+            continue;
+
+        const auto &in_flight = queue.get_in_flight();
+        ESP_LOGI(TAG, "Node 0x%04X (slot %zu): %zu message(s), in flight: %zu, coalesced: %" PRIu32 ", dropped: %" PRIu32 ", deferred: %" PRIu32,
+                 queue.get_unicast(), slot, queue.size(), in_flight.size(), queue.get_coalesced(), queue.get_dropped(), queue.deferred);
+
+        const rtt_estimator &rtt = queue.get_rtt();
+        if (!queue.is_reachable() || queue.get_rejected() > 0)
+        {
+            ESP_LOGI(TAG, "    %s, rejected: %" PRIu32 ", next probe delay: %" PRIu32 " s",
+                     queue.is_reachable() ? "reachable" : "unreachable", queue.get_rejected(), queue.probe_delay_ms / 1000);
+        }
 
-        ESP_LOGI(TAG, "Node 0x%04X: %zu message(s), waiting: %s",
-                 entry.first->unicast, queue_size, waiting ? "yes" : "no");
+        ESP_LOGI(TAG, "    rtt: %" PRId64 " ms (var %" PRId64 " ms, %" PRIu32 " samples), timeout: %" PRIu32 " ms, timeouts: %" PRIu32,
+                 rtt.srtt() / 1000, rtt.rttvar() / 1000, rtt.sample_count(), rtt.timeout_ms(), rtt.timeout_count());
 
-        // List opcodes in the queue
-        if (queue_size > 0)
+        // List opcodes waiting for an ack
+        for (size_t i = 0; i < in_flight.size(); i++)
         {
-            const auto &internal_queue = queue.get_queue();
-            ESP_LOGI(TAG, "    opcode: 0x%08X (retries left: %u)",
-                     internal_queue.front().opcode, internal_queue.front().retries_left);
+            ESP_LOGI(TAG, "    opcode: 0x%08" PRIX32 " dst: 0x%04X (retries left: %u)",
+                     in_flight[i].cmd.opcode, in_flight[i].cmd.dst, in_flight[i].cmd.retries_left);
+        }
+
+        if (!queue.get_pending().empty())
+        {
+            ESP_LOGI(TAG, "    next: 0x%08" PRIX32 ", %zu pending",
+                     queue.get_pending().front().opcode, queue.get_pending().size());
         }
     }
 }
@@ -207,6 +1079,57 @@ int print_debug_cmd(int argc, char **argv)
     return 0;
 }
 
+int print_stats_cmd(int argc, char **argv)
+{
+    message_queue().print_stats();
+    return 0;
+}
+
+int reset_stats_cmd(int argc, char **argv)
+{
+    message_queue().reset_stats();
+    return 0;
+}
+
+static struct
+{
+    struct arg_int *node_index;
+    struct arg_int *count;
+    struct arg_end *end;
+} slider_storm_args;
+
+// Replays what a dragged Home Assistant slider produces: a lightness set and a status publish per step.
+int slider_storm_cmd(int argc, char **argv)
+{
+    int nerrors = arg_parse(argc, argv, (void **)&slider_storm_args);
+    if (nerrors != 0)
+    {
+        arg_print_errors(stderr, slider_storm_args.end, argv[0]);
+        return 1;
+    }
+
+    bm2mqtt_node_info *node_info = node_manager().get_node(slider_storm_args.node_index->ival[0]);
+    if (!node_info || node_info->unicast == ESP_BLE_MESH_ADDR_UNASSIGNED)
+    {
+        return 1;
+    }
+
+    const int count = slider_storm_args.count->count > 0 ? slider_storm_args.count->ival[0] : 100;
+    const uint32_t heap_before = esp_get_free_heap_size();
+    for (int i = 0; i < count; i++)
+    {
+        update_node_field(node_info, &bm2mqtt_node_info::hsl_l, node_info->min_lightness + (i * 97) % (node_info->max_lightness - node_info->min_lightness + 1), FIELD_LIGHTNESS, state_source::assumed);
+        message_queue().enqueue(node_info, make_lightness_set(node_info->unicast, node_info->hsl_l));
+        message_queue().enqueue(node_info, make_mqtt_marker(node_info->unicast, mqtt_action_t::status, command_priority_t::interactive));
+    }
+    const uint32_t heap_after = esp_get_free_heap_size();
+
+    ESP_LOGI(TAG, "Slider storm: %d steps, free heap %" PRIu32 " -> %" PRIu32 " (%" PRId32 " bytes)",
+             count, heap_before, heap_after, (int32_t)(heap_before - heap_after));
+    message_queue().print_debug();
+    return 0;
+}
+
 void RegisterMessageQueueDebugCommands()
 {
     /* Register commands */
@@ -218,6 +1141,35 @@ void RegisterMessageQueueDebugCommands()
         .func = &print_debug_cmd,
     };
     ESP_ERROR_CHECK(register_console_command(&message_queue_print_debug_cmd));
+
+    const esp_console_cmd_t message_queue_print_stats_cmd = {
+        .command = "message_queue_print_stats",
+        .help = "Print retries, drops and latencies per node and per opcode",
+        .hint = NULL,
+        .func = &print_stats_cmd,
+    };
+    ESP_ERROR_CHECK(register_console_command(&message_queue_print_stats_cmd));
+
+    const esp_console_cmd_t message_queue_reset_stats_cmd = {
+        .command = "message_queue_reset_stats",
+        .help = "Reset the latency, retry and deferral counters of the message queue",
+        .hint = NULL,
+        .func = &reset_stats_cmd,
+    };
+    ESP_ERROR_CHECK(register_console_command(&message_queue_reset_stats_cmd));
+
+    slider_storm_args.node_index = arg_int1("n", "node", "<node_index>", "Node index as reported by prov_list_nodes command");
+    slider_storm_args.count = arg_int0("c", "count", "<steps>", "Number of slider steps (default 100)");
+    slider_storm_args.end = arg_end(2);
+
+    const esp_console_cmd_t slider_storm_cmd_desc = {
+        .command = "message_queue_slider_storm",
+        .help = "Enqueue a burst of lightness sets and report the heap used by the queue",
+        .hint = NULL,
+        .func = &slider_storm_cmd,
+        .argtable = &slider_storm_args,
+    };
+    ESP_ERROR_CHECK(register_console_command(&slider_storm_cmd_desc));
 }
 
-REGISTER_DEBUG_COMMAND(RegisterMessageQueueDebugCommands);
\ No newline at end of file
+REGISTER_DEBUG_COMMAND(RegisterMessageQueueDebugCommands);
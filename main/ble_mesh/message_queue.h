@@ -1,58 +1,243 @@
 #pragma once
-#include <queue>
-#include <functional>
+#include <array>
+#include <atomic>
 #include <cstdint>
-#include <map>
-#include <esp_timer.h>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <vector>
 #include "ble_mesh_node.h"
+#include "mesh_command.h"
+#include "static_ring.h"
+#include "latency_histogram.h"
+#include "mesh_stats.h"
+#include "rtt_estimator.h"
+#include "timer/timer_wheel.h"
 
-enum class message_type_t : uint8_t
-{
-    ble_mesh_message,
-    mqtt_message,
-};
-
-struct message_payload {
-    std::function<void()> send;
-    uint32_t opcode;
-    uint8_t retries_left = 3;
-    message_type_t type = message_type_t::ble_mesh_message;
-};
-
+// Per-node ordering, pipelining and retries. When a message actually goes on air is
+// decided by message_queue_manager, which shares the mesh bearer between all nodes.
 class message_queue {
 public:
-    void enqueue(const message_payload &msg);
-    void handle_ack(uint32_t opcode);
-    void handle_timeout(uint32_t opcode);
+    bool enqueue(const mesh_command &cmd);
+    void handle_ack(uint32_t opcode, uint16_t addr);
+    void handle_timeout(uint32_t opcode, uint16_t addr);
+    void clear();
+
+    // Dispatches the MQTT markers that reached the head, they do not use the mesh
+    void flush_markers();
+    // Index of the pending message allowed to go next, -1 if the node has to wait
+    int next_sendable() const;
+    // Class of a pending message, aging included
+    command_priority_t next_priority(size_t index) const;
+    // False when the mesh stack refused the message, it is dropped then
+    bool send_pending(size_t index);
+
+    size_t size() const { return pending.size() + in_flight.size(); }
+    bool is_waiting() const { return !in_flight.empty(); }
+    uint32_t get_coalesced() const { return coalesced; }
+    uint32_t get_dropped() const { return dropped; }
+    uint16_t get_unicast() const { return unicast; }
+    const rtt_estimator &get_rtt() const { return rtt; }
+    // Lock free, read from MQTT callbacks that hold the node table lock
+    bool is_reachable() const { return reachable; }
+    uint32_t get_rejected() const { return rejected; }
+    const node_latency_stats &get_stats() const { return stats; }
+    void set_unicast(uint16_t addr) { unicast = addr; }
+    // Node the queue serves, resolved through the node manager when needed
+    node_handle get_node() const { return node; }
+    void set_node(node_handle handle) { node = handle; }
+
+    struct in_flight_entry {
+        mesh_command cmd;
+        int64_t deadline_us;
+        int64_t sent_us;
+        int64_t first_sent_us;
+        uint8_t transmissions;
+    };
+
+    using pending_ring = static_ring<mesh_command, CONFIG_BM2MQTT_MSG_QUEUE_DEPTH>;
+    using in_flight_ring = static_ring<in_flight_entry, CONFIG_BM2MQTT_MSG_QUEUE_INFLIGHT_WINDOW>;
+    const pending_ring &get_pending() const { return pending; }
+    const in_flight_ring &get_in_flight() const { return in_flight; }
+
+    // Deficit round robin state, owned by message_queue_manager
+    int32_t deficit = 0;
+    bool quantum_granted = false;
+    uint32_t deferred = 0;
 
-    size_t size() const { return queue.size(); }
-    bool is_waiting() const { return waiting; }
-    const std::queue<message_payload> &get_queue() const { return queue; }
 private:
-    void try_send_next();
+    friend class message_queue_manager;
 
-     void ensure_failsafe_timer();
+    bool can_send(const mesh_command &cmd) const;
+    bool marker_ready(size_t index) const;
+    bool send(in_flight_entry &entry);
+    void drop_unsent(size_t index);
+    int find_in_flight(uint32_t opcode, uint16_t addr) const;
+
+    void arm_failsafe_timer();
     static void failsafe_callback(void *arg);
     void on_failsafe_trigger();
 
-    std::queue<message_payload> queue;
-    esp_timer_handle_t failsafe_timer = nullptr;
-    bool waiting = false;
+    // Circuit breaker, driven by message_queue_manager
+    void mark_unreachable();
+    void mark_reachable();
+    void arm_probe();
+    static void probe_callback(void *arg);
+
+    pending_ring pending;
+    in_flight_ring in_flight;
+    wheel_timer failsafe_timer;
+    uint16_t unicast = ESP_BLE_MESH_ADDR_UNASSIGNED;
+    node_handle node;
+    uint32_t coalesced = 0;
+    uint32_t dropped = 0;
+    rtt_estimator rtt;
+    node_latency_stats stats;
+
+    std::atomic<bool> reachable{true};
+    uint8_t consecutive_timeouts = 0;
+    uint32_t probe_delay_ms = 0;
+    uint32_t rejected = 0;
+    wheel_timer probe_timer;
 };
 
+// One queue per node manager slot, so every tracked node has its own whatever its provisioner index.
+// Nodes are served in deficit round robin, measured in network PDUs, under a global budget of
+// transactions in flight and PDUs per second so a scene touching many bulbs does not exhaust
+// the advertising buffers. Each priority class gets its own round, interactive first.
 class message_queue_manager {
 public:
-    void enqueue(bm2mqtt_node_info* node, const message_payload &msg);
-    void handle_ack(bm2mqtt_node_info* node, uint32_t opcode);
-    void handle_timeout(bm2mqtt_node_info* node, uint32_t opcode);
+    void enqueue(bm2mqtt_node_info* node, const mesh_command &cmd);
+    void handle_ack(bm2mqtt_node_info* node, uint32_t opcode, uint16_t addr);
+    void handle_timeout(bm2mqtt_node_info* node, uint32_t opcode, uint16_t addr);
 
     void print_debug() const;
     void clear_queue(bm2mqtt_node_info* node);
+    void reset_stats();
+    void print_stats() const;
+    // Per class, per opcode and per node stats as JSON, handed to consume as a string_view valid
+    // during the call. Nodes come by pages of BM2MQTT_MESH_STATS_PAGE_NODES from slot first_slot
+    // on. Returns the slot of the next page (also in "next"), 0 after the last one.
+    template <typename F>
+    size_t print_stats_json(size_t first_slot, F &&consume) const
+    {
+        std::lock_guard<std::mutex> lock(stats_mutex);
+        const size_t next_slot = write_stats_json(first_slot);
+        consume(std::string_view(stats_json->text.data(), stats_json->size));
+        return next_slot;
+    }
+    bool is_reachable(const bm2mqtt_node_info *node);
+    // Client timeout for the next message to this node, from its measured round trip time
+    uint32_t get_msg_timeout_ms(const bm2mqtt_node_info *node);
 
 private:
-    std::map<bm2mqtt_node_info*, message_queue> node_queues;
+    friend class message_queue;
+
+    // Holds queue_mutex. MQTT publishes requested under it (status markers, availability) go out
+    // once the outermost holder has released it, so a slow broker never blocks the mesh callbacks.
+    class queue_lock
+    {
+    public:
+        explicit queue_lock(message_queue_manager &manager);
+        ~queue_lock();
+
+    private:
+        message_queue_manager &manager;
+    };
+
+    struct mqtt_publish
+    {
+        enum class kind_t : uint8_t
+        {
+            marker,
+            online,
+            offline,
+        } kind;
+        mesh_command marker;
+        node_handle node; // For availability
+    };
+
+    message_queue *get_queue(const bm2mqtt_node_info *node);
+
+    // Stats copied under queue_mutex by write_stats_json, then serialized once it is released
+    struct node_stats_row
+    {
+        uint16_t unicast;
+        bool reachable;
+        uint32_t queued, coalesced, queue_full, rejected;
+        int64_t srtt_ms;
+        stream_summary stream;
+        size_t slot;
+    };
+    struct opcode_stats_row
+    {
+        uint32_t opcode;
+        stream_summary stream;
+    };
+    // The header and every opcode fit with their values at their largest, node rows fill the
+    // rest of the page and a page that runs out of room ends early
+    static constexpr size_t stats_json_max_size = 8192;
+    struct stats_json_buffer
+    {
+        std::array<histogram_summary, (size_t)command_priority_t::count> classes;
+        uint32_t deferred_in_flight, deferred_airtime;
+        std::array<opcode_stats_row, opcode_stats_table::slot_count> opcodes;
+        size_t opcode_count;
+        std::array<node_stats_row, CONFIG_BM2MQTT_MESH_STATS_PAGE_NODES> nodes;
+        size_t node_count;
+        size_t next_slot;
+        std::array<char, stats_json_max_size> text;
+        size_t size;
+    };
+    size_t write_stats_json(size_t first_slot) const;
+
+    void schedule();
+    // Returns false once the global budget is used up
+    bool schedule_class(command_priority_t priority, size_t &in_flight_total);
+    // Enqueue to ack (or MQTT publish for markers), per class
+    void record_latency(const mesh_command &cmd);
+    void on_failsafe(message_queue *queue);
+    void on_probe(message_queue *queue);
+    // Trips the breaker of a node that keeps timing out and keeps probing it while it is down
+    void update_reachability(message_queue *queue);
+    void publish_availability(const message_queue *queue, bool available);
+    // Queues an MQTT marker, dispatched once queue_mutex is released
+    void publish_marker(const mesh_command &marker);
+    void send_publishes();
+    // Charges the PDUs of a send (retries included) to the rate limiter
+    void consume_airtime(uint8_t pdus);
+    int64_t airtime_wait_us(uint8_t pdus) const;
+    static void airtime_timer_callback(void *arg);
+
+    // On the heap so a large fleet's queues can land in PSRAM (CONFIG_SPIRAM_USE_MALLOC)
+    std::vector<message_queue> node_queues = std::vector<message_queue>(CONFIG_BLE_MESH_MAX_PROV_NODES);
+    mutable std::recursive_mutex queue_mutex;
+    uint32_t lock_depth = 0;
+    // Filled under queue_mutex, swapped out and sent by one thread at a time. Both keep their
+    // capacity, so steady state publishing does not allocate.
+    std::vector<mqtt_publish> outbox;
+    std::vector<mqtt_publish> sending;
+    std::mutex publish_mutex;
+
+    // Queues holding pending or in flight messages, the only ones schedule() visits
+    void set_active(const message_queue &queue, bool active);
+    // First active slot at or after from, wrapping around
+    size_t next_active(size_t from) const;
+    std::array<uint32_t, (CONFIG_BLE_MESH_MAX_PROV_NODES + 31) / 32> active_words{};
+    size_t active_count = 0;
+
+    size_t drr_cursor = 0;
+    int64_t airtime_tat_us = 0; // Theoretical arrival time of the rate limiter (GCRA)
+    wheel_timer airtime_timer;
+    uint32_t deferred_in_flight = 0;
+    uint32_t deferred_airtime = 0;
+    std::array<latency_histogram, (size_t)command_priority_t::count> latency{};
+    opcode_stats_table opcode_stats;
+
+    // Allocated on first use, reused by every stats request
+    mutable std::mutex stats_mutex;
+    mutable std::unique_ptr<stats_json_buffer> stats_json;
 };
 
 
 message_queue_manager& message_queue();
-
@@ -0,0 +1,270 @@
+#include "node_index.h"
+#include <algorithm>
+#include <cstring>
+
+static constexpr uint64_t golden_ratio = 0x9E3779B97F4A7C15ull;
+
+static uint64_t mix(uint64_t value)
+{
+    value ^= value >> 33;
+    value *= golden_ratio;
+    return value ^ (value >> 29);
+}
+
+uint64_t mac_key(const uint8_t addr[6])
+{
+    uint64_t key = 0;
+    for (int i = 0; i < 6; i++)
+    {
+        key = (key << 8) | addr[i];
+    }
+    return key;
+}
+
+bool mac_key_from_hex(std::string_view hex, uint64_t *key)
+{
+    if (hex.size() != 12)
+        return false;
+
+    uint64_t value = 0;
+    for (char c : hex)
+    {
+        uint8_t digit;
+        if (c >= '0' && c <= '9')
+            digit = c - '0';
+        else if (c >= 'a' && c <= 'f')
+            digit = c - 'a' + 10;
+        else if (c >= 'A' && c <= 'F')
+            digit = c - 'A' + 10;
+        else
+            return false;
+        value = (value << 4) | digit;
+    }
+    *key = value;
+    return true;
+}
+
+size_t node_index::uuid_hash::operator()(const Uuid128 &uuid) const
+{
+    uint64_t high, low;
+    memcpy(&high, uuid.raw(), sizeof(high));
+    memcpy(&low, uuid.raw() + sizeof(high), sizeof(low));
+    return mix(high ^ mix(low));
+}
+
+size_t node_index::mac_hash::operator()(uint64_t mac) const
+{
+    return mix(mac);
+}
+
+template <typename Key, typename Hash>
+void node_index::hash_table<Key, Hash>::clear()
+{
+    entries.clear();
+    count = 0;
+}
+
+template <typename Key, typename Hash>
+void node_index::hash_table<Key, Hash>::grow()
+{
+    std::vector<entry> old = std::move(entries);
+    entries.assign(std::max<size_t>(16, old.size() * 2), entry{});
+    for (const entry &e : old)
+    {
+        if (e.slot == npos)
+            continue;
+        size_t i = home(e.key);
+        while (entries[i].slot != npos)
+        {
+            i = (i + 1) & (entries.size() - 1);
+        }
+        entries[i] = e;
+    }
+}
+
+template <typename Key, typename Hash>
+void node_index::hash_table<Key, Hash>::insert(const Key &key, uint16_t slot)
+{
+    if ((count + 1) * 2 > entries.size())
+    {
+        grow();
+    }
+
+    size_t i = home(key);
+    while (entries[i].slot != npos)
+    {
+        i = (i + 1) & (entries.size() - 1);
+    }
+    entries[i] = entry{key, slot};
+    count++;
+}
+
+template <typename Key, typename Hash>
+void node_index::hash_table<Key, Hash>::erase(const Key &key, uint16_t slot)
+{
+    if (entries.empty())
+        return;
+
+    const size_t mask = entries.size() - 1;
+    size_t hole = home(key);
+    while (entries[hole].slot != npos && !(entries[hole].slot == slot && entries[hole].key == key))
+    {
+        hole = (hole + 1) & mask;
+    }
+    if (entries[hole].slot == npos)
+        return;
+
+    entries[hole].slot = npos;
+    count--;
+
+    // Pull back the entries of the cluster that can no longer be reached past the hole
+    for (size_t i = (hole + 1) & mask; entries[i].slot != npos; i = (i + 1) & mask)
+    {
+        const size_t wanted = home(entries[i].key);
+        const bool reachable = hole <= i ? (wanted > hole && wanted <= i) : (wanted > hole || wanted <= i);
+        if (!reachable)
+        {
+            entries[hole] = entries[i];
+            entries[i].slot = npos;
+            hole = i;
+        }
+    }
+}
+
+template <typename Key, typename Hash>
+uint16_t node_index::hash_table<Key, Hash>::find(const Key &key) const
+{
+    if (entries.empty())
+        return npos;
+
+    for (size_t i = home(key); entries[i].slot != npos; i = (i + 1) & (entries.size() - 1))
+    {
+        if (entries[i].key == key)
+            return entries[i].slot;
+    }
+    return npos;
+}
+
+void node_index::clear()
+{
+    slots.clear();
+    unicast_ranges.clear();
+    widest_range = 0;
+    uuids.clear();
+    macs.clear();
+}
+
+void node_index::insert(uint16_t slot, const Uuid128 &uuid)
+{
+    if (slot >= slots.size())
+    {
+        slots.resize(slot + 1);
+    }
+    erase(slot);
+    slots[slot] = slot_keys{.used = true, .uuid = uuid};
+    // A duplicated UUID keeps resolving to the slot indexed first
+    if (uuids.find(uuid) == npos)
+    {
+        uuids.insert(uuid, slot);
+    }
+}
+
+void node_index::erase_range(uint16_t slot)
+{
+    std::erase_if(unicast_ranges, [slot](const unicast_range &range)
+                  { return range.slot == slot; });
+}
+
+void node_index::set_address(uint16_t slot, uint16_t unicast, uint8_t elem_num)
+{
+    if (slot >= slots.size() || !slots[slot].used)
+        return;
+
+    erase_range(slot);
+    slots[slot].unicast = unicast;
+    slots[slot].elem_num = elem_num;
+    if (unicast != 0 && elem_num > 0)
+    {
+        const unicast_range range{unicast, static_cast<uint16_t>(unicast + elem_num - 1), slot};
+        widest_range = std::max(widest_range, elem_num);
+        unicast_ranges.insert(std::upper_bound(unicast_ranges.begin(), unicast_ranges.end(), range), range);
+    }
+}
+
+void node_index::set_mac(uint16_t slot, uint64_t mac)
+{
+    if (slot >= slots.size() || !slots[slot].used || slots[slot].mac == mac)
+        return;
+
+    if (slots[slot].mac != 0)
+    {
+        macs.erase(slots[slot].mac, slot);
+    }
+    slots[slot].mac = mac;
+    if (mac != 0)
+    {
+        macs.insert(mac, slot);
+    }
+}
+
+void node_index::erase(uint16_t slot)
+{
+    if (slot >= slots.size() || !slots[slot].used)
+        return;
+
+    const slot_keys keys = slots[slot];
+    uuids.erase(keys.uuid, slot);
+    if (keys.mac != 0)
+    {
+        macs.erase(keys.mac, slot);
+    }
+    erase_range(slot);
+    slots[slot] = slot_keys{};
+
+    // Another slot with the same UUID takes over
+    for (size_t i = 0; i < slots.size() && uuids.find(keys.uuid) == npos; i++)
+    {
+        if (slots[i].used && slots[i].uuid == keys.uuid)
+        {
+            uuids.insert(keys.uuid, i);
+            break;
+        }
+    }
+}
+
+uint16_t node_index::find(const Uuid128 &uuid) const
+{
+    return uuids.find(uuid);
+}
+
+uint16_t node_index::find_unicast(uint16_t addr) const
+{
+    // Branchless search for the last range starting at or below addr
+    const unicast_range *base = unicast_ranges.data();
+    size_t length = unicast_ranges.size();
+    if (length == 0 || addr < base->first)
+        return npos;
+    while (length > 1)
+    {
+        const size_t half = length / 2;
+        base = base[half].first <= addr ? base + half : base;
+        length -= half;
+    }
+
+    // Stale nodes can overlap a range, the lowest slot containing addr wins like the scan did.
+    // Only ranges starting less than the widest node below addr can contain it.
+    uint16_t slot = npos;
+    for (;; base--)
+    {
+        if (addr <= base->last)
+            slot = std::min(slot, base->slot);
+        if (base == unicast_ranges.data() || base[-1].first + widest_range <= addr)
+            break;
+    }
+    return slot;
+}
+
+uint16_t node_index::find_mac(uint64_t mac) const
+{
+    return mac == 0 ? npos : macs.find(mac);
+}
@@ -0,0 +1,98 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "Uui128.h"
+
+// Packed BD address, the key the MAC index uses. 0 means no address.
+uint64_t mac_key(const uint8_t addr[6]);
+// Parses the 12 hex digits bt_hex() prints for an address, case insensitive
+bool mac_key_from_hex(std::string_view hex, uint64_t *key);
+
+// Lookup indexes over the node manager's slots, so the mesh callbacks and MQTT handlers do not
+// scan every node: unicast ranges sorted for a binary search, UUID and MAC in open addressing
+// hash tables. Slots are the owner's storage slots, which do not move. Not thread safe, the
+// owner locks.
+class node_index final
+{
+public:
+    static constexpr uint16_t npos = 0xFFFF;
+
+    void clear();
+    // Indexes a slot by its UUID, its address and MAC come later
+    void insert(uint16_t slot, const Uuid128 &uuid);
+    void set_address(uint16_t slot, uint16_t unicast, uint8_t elem_num);
+    void set_mac(uint16_t slot, uint64_t mac);
+    void erase(uint16_t slot);
+
+    uint16_t find(const Uuid128 &uuid) const;
+    // Slot whose element range contains addr
+    uint16_t find_unicast(uint16_t addr) const;
+    uint16_t find_mac(uint64_t mac) const;
+
+private:
+    struct slot_keys
+    {
+        bool used = false;
+        Uuid128 uuid;
+        uint64_t mac = 0;
+        uint16_t unicast = 0;
+        uint8_t elem_num = 0;
+    };
+
+    struct unicast_range
+    {
+        uint16_t first;
+        uint16_t last;
+        uint16_t slot;
+
+        bool operator<(const unicast_range &other) const
+        {
+            return first != other.first ? first < other.first : slot < other.slot;
+        }
+    };
+
+    // Linear probing with backward shift deletion, at most half full
+    template <typename Key, typename Hash>
+    class hash_table
+    {
+    public:
+        void clear();
+        void insert(const Key &key, uint16_t slot);
+        void erase(const Key &key, uint16_t slot);
+        uint16_t find(const Key &key) const;
+
+    private:
+        struct entry
+        {
+            Key key{};
+            uint16_t slot = npos;
+        };
+
+        size_t home(const Key &key) const { return Hash{}(key) & (entries.size() - 1); }
+        void grow();
+
+        std::vector<entry> entries;
+        size_t count = 0;
+    };
+
+    struct uuid_hash
+    {
+        size_t operator()(const Uuid128 &uuid) const;
+    };
+    struct mac_hash
+    {
+        size_t operator()(uint64_t mac) const;
+    };
+
+    void erase_range(uint16_t slot);
+
+    std::vector<slot_keys> slots;
+    std::vector<unicast_range> unicast_ranges;
+    uint8_t widest_range = 0; // Largest element count indexed so far
+    hash_table<Uuid128, uuid_hash> uuids;
+    hash_table<uint64_t, mac_hash> macs;
+};
@@ -0,0 +1,231 @@
+#include "node_record.h"
+#include <cstring>
+
+#include "ble_mesh_node.h"
+
+namespace
+{
+enum field_kind : uint8_t
+{
+    kind_varint = 0,
+    kind_bytes = 1,
+};
+
+struct u16_field
+{
+    uint8_t number;
+    uint16_t bm2mqtt_node_info::*member;
+};
+
+struct u8_field
+{
+    uint8_t number;
+    uint8_t bm2mqtt_node_info::*member;
+};
+
+// Field numbers are the flash format: never renumber or reuse one, retire it instead
+constexpr uint8_t config_uuid = 1;
+constexpr u8_field config_u8_fields[] = {
+    {3, &bm2mqtt_node_info::elem_num},
+    {6, &bm2mqtt_node_info::light_ctl_temp_offset},
+};
+constexpr u16_field config_u16_fields[] = {
+    {2, &bm2mqtt_node_info::unicast},
+    {4, &bm2mqtt_node_info::features},
+    {5, &bm2mqtt_node_info::features_to_bind},
+    {7, &bm2mqtt_node_info::min_hue},
+    {8, &bm2mqtt_node_info::max_hue},
+    {9, &bm2mqtt_node_info::min_saturation},
+    {10, &bm2mqtt_node_info::max_saturation},
+    {11, &bm2mqtt_node_info::min_lightness},
+    {12, &bm2mqtt_node_info::max_lightness},
+    {13, &bm2mqtt_node_info::min_temp},
+    {14, &bm2mqtt_node_info::max_temp},
+};
+
+constexpr uint8_t state_level = 2;
+constexpr uint8_t state_color_mode = 7;
+constexpr u8_field state_u8_fields[] = {
+    {1, &bm2mqtt_node_info::onoff},
+};
+constexpr u16_field state_u16_fields[] = {
+    {3, &bm2mqtt_node_info::hsl_h},
+    {4, &bm2mqtt_node_info::hsl_s},
+    {5, &bm2mqtt_node_info::hsl_l},
+    {6, &bm2mqtt_node_info::curr_temp},
+};
+
+const bm2mqtt_node_info defaults{};
+
+class record_writer
+{
+public:
+    void varint(uint64_t value)
+    {
+        do
+        {
+            // max_size fits every field, the bound only guards the array
+            const uint8_t byte = (value & 0x7F) | (value > 0x7F ? 0x80 : 0);
+            if (record.size < record.data.size())
+                record.data[record.size++] = byte;
+            value >>= 7;
+        } while (value != 0);
+    }
+
+    void field(uint8_t number, uint64_t value)
+    {
+        varint(number << 1 | kind_varint);
+        varint(value);
+    }
+
+    void field(uint8_t number, const uint8_t *bytes, size_t length)
+    {
+        varint(number << 1 | kind_bytes);
+        varint(length);
+        for (size_t i = 0; i < length && record.size < record.data.size(); i++)
+        {
+            record.data[record.size++] = bytes[i];
+        }
+    }
+
+    template <typename T, size_t N>
+    void fields(const bm2mqtt_node_info &node, const T (&table)[N])
+    {
+        for (const T &f : table)
+        {
+            if (node.*f.member != defaults.*f.member)
+                field(f.number, node.*f.member);
+        }
+    }
+
+    node_record record;
+};
+
+struct record_field
+{
+    uint8_t number;
+    field_kind kind;
+    uint64_t value;       // kind_varint
+    const uint8_t *bytes; // kind_bytes
+    size_t length;
+};
+
+class record_reader
+{
+public:
+    record_reader(const uint8_t *data, size_t size) : next(data), end(data + size) {}
+
+    bool at_end() const { return next == end; }
+
+    // Resets every member of f first, bytes stays null for varint fields. False on truncated or
+    // malformed input
+    bool read(record_field &f)
+    {
+        f = record_field{};
+        uint64_t key;
+        if (!varint(key))
+            return false;
+        f.number = key >> 1;
+        f.kind = static_cast<field_kind>(key & 1);
+        if (f.kind == kind_varint)
+            return varint(f.value);
+        if (!varint(f.value) || f.value > static_cast<size_t>(end - next))
+            return false;
+        f.bytes = next;
+        f.length = f.value;
+        next += f.length;
+        return true;
+    }
+
+private:
+    bool varint(uint64_t &value)
+    {
+        value = 0;
+        for (int shift = 0; shift < 64; shift += 7)
+        {
+            if (next == end)
+                return false;
+            const uint8_t byte = *next++;
+            value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+            if (!(byte & 0x80))
+                return true;
+        }
+        return false;
+    }
+
+    const uint8_t *next;
+    const uint8_t *end;
+};
+
+template <typename T, size_t N>
+bool apply_field(bm2mqtt_node_info &node, const T (&table)[N], const record_field &f)
+{
+    for (const T &entry : table)
+    {
+        if (entry.number == f.number && f.kind == kind_varint)
+        {
+            node.*entry.member = f.value;
+            return true;
+        }
+    }
+    return false;
+}
+
+uint64_t zigzag(int64_t value) { return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63); }
+int64_t unzigzag(uint64_t value) { return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1); }
+} // namespace
+
+node_record encode_node_config(const bm2mqtt_node_info &node)
+{
+    record_writer writer;
+    writer.field(config_uuid, node.uuid.raw(), node.uuid.data.size());
+    writer.fields(node, config_u16_fields);
+    writer.fields(node, config_u8_fields);
+    return writer.record;
+}
+
+node_record encode_node_state(const bm2mqtt_node_info &node)
+{
+    record_writer writer;
+    writer.fields(node, state_u8_fields);
+    writer.fields(node, state_u16_fields);
+    if (node.level != defaults.level)
+        writer.field(state_level, zigzag(node.level));
+    if (node.color_mode != defaults.color_mode)
+        writer.field(state_color_mode, static_cast<uint64_t>(node.color_mode));
+    return writer.record;
+}
+
+bool decode_node_config(const uint8_t *data, size_t size, bm2mqtt_node_info &node)
+{
+    record_reader reader(data, size);
+    record_field f{};
+    while (!reader.at_end())
+    {
+        if (!reader.read(f))
+            return false;
+        if (f.number == config_uuid && f.kind == kind_bytes && f.length == node.uuid.data.size())
+            memcpy(node.uuid.data.data(), f.bytes, f.length);
+        else if (!apply_field(node, config_u16_fields, f))
+            apply_field(node, config_u8_fields, f);
+    }
+    return true;
+}
+
+bool decode_node_state(const uint8_t *data, size_t size, bm2mqtt_node_info &node)
+{
+    record_reader reader(data, size);
+    record_field f{};
+    while (!reader.at_end())
+    {
+        if (!reader.read(f))
+            return false;
+        if (f.number == state_level && f.kind == kind_varint)
+            node.level = unzigzag(f.value);
+        else if (f.number == state_color_mode && f.kind == kind_varint)
+            node.color_mode = static_cast<color_mode_t>(f.value);
+        else if (!apply_field(node, state_u16_fields, f))
+            apply_field(node, state_u8_fields, f);
+    }
+    return true;
+}
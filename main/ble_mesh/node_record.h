@@ -0,0 +1,44 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+struct bm2mqtt_node_info;
+
+// Serialized node record as stored in NVS. Each field is a varint key (field number << 1 | kind)
+// followed by a varint, or for kind 1 a varint length and raw bytes. Fields holding their
+// default value are left out. Decoding starts from the defaults and skips unknown fields, so
+// records written by older or newer firmware load without a migration step.
+struct node_record
+{
+    static constexpr size_t max_size = 80; // Every config field present at its largest
+
+    std::array<uint8_t, max_size> data{};
+    size_t size = 0;
+
+    bool empty() const { return size == 0; }
+    // FNV-1a of the encoded bytes, never 0
+    uint32_t digest() const
+    {
+        uint32_t hash = 2166136261u;
+        for (size_t i = 0; i < size; i++)
+        {
+            hash = (hash ^ data[i]) * 16777619u;
+        }
+        return hash != 0 ? hash : 1;
+    }
+    bool operator==(const node_record &other) const
+    {
+        return size == other.size && std::equal(data.begin(), data.begin() + size, other.data.begin());
+    }
+};
+
+// Durable configuration: UUID, addresses, ranges, features, bindings
+node_record encode_node_config(const bm2mqtt_node_info &node);
+// Last known light state: on/off, level, HSL, temperature, color mode
+node_record encode_node_state(const bm2mqtt_node_info &node);
+
+// Only the fields present in the record are written to node. False if the record is truncated.
+bool decode_node_config(const uint8_t *data, size_t size, bm2mqtt_node_info &node);
+bool decode_node_state(const uint8_t *data, size_t size, bm2mqtt_node_info &node);
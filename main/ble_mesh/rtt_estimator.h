@@ -0,0 +1,56 @@
+#pragma once
+#include <cstdint>
+#include <algorithm>
+#include "sdkconfig.h"
+
+// Smoothed round trip time and variance of one node (Jacobson/Karels, RFC 6298).
+// The caller applies Karn's rule: only acks of messages sent once are sampled, and
+// retransmissions back off exponentially from the current estimate.
+class rtt_estimator
+{
+public:
+    static constexpr int64_t min_rto_us = CONFIG_BM2MQTT_RTO_MIN_MS * 1000;
+    static constexpr int64_t max_rto_us = CONFIG_BM2MQTT_RTO_MAX_MS * 1000;
+    static constexpr int64_t initial_rto_us = CONFIG_BM2MQTT_RTO_INITIAL_MS * 1000;
+
+    void sample(int64_t rtt_us)
+    {
+        if (samples == 0)
+        {
+            srtt_us = rtt_us;
+            rttvar_us = rtt_us / 2;
+        }
+        else
+        {
+            const int64_t error = srtt_us > rtt_us ? srtt_us - rtt_us : rtt_us - srtt_us;
+            rttvar_us = (3 * rttvar_us + error) / 4;
+            srtt_us = (7 * srtt_us + rtt_us) / 8;
+        }
+        samples++;
+        rto_us = std::clamp(srtt_us + 4 * rttvar_us, min_rto_us, max_rto_us);
+    }
+
+    // Timeout of the given retransmission, doubled each time. A node without samples keeps the
+    // initial timeout so an unknown or dead node does not hold its queue longer than before.
+    uint32_t timeout_ms(uint8_t retransmission = 0) const
+    {
+        const int64_t ceiling = samples > 0 ? max_rto_us : initial_rto_us;
+        return std::min(rto_us << std::min<uint8_t>(retransmission, 8), ceiling) / 1000;
+    }
+
+    void count_timeout() { timeouts++; }
+
+    void reset() { *this = rtt_estimator{}; }
+
+    int64_t srtt() const { return srtt_us; }
+    int64_t rttvar() const { return rttvar_us; }
+    uint32_t sample_count() const { return samples; }
+    uint32_t timeout_count() const { return timeouts; }
+
+private:
+    int64_t srtt_us = 0;
+    int64_t rttvar_us = 0;
+    int64_t rto_us = initial_rto_us;
+    uint32_t samples = 0;
+    uint32_t timeouts = 0;
+};
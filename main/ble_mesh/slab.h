@@ -0,0 +1,170 @@
+#pragma once
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+
+// Index of a slab slot plus the generation it was allocated in. A handle kept past the release
+// of its slot no longer resolves, even once the slot is reused.
+struct slab_handle
+{
+    static constexpr uint16_t invalid_index = 0xFFFF;
+
+    uint16_t index = invalid_index;
+    uint16_t generation = 0;
+
+    bool valid() const { return index != invalid_index; }
+    bool operator==(const slab_handle &other) const = default;
+};
+
+// Fixed capacity object pool: elements never move, so pointers stay valid until their slot is
+// released, and allocation, release and handle lookups are O(1) without touching the heap.
+// Occupancy and generations are kept apart from the elements, so iterating and validating
+// handles walk dense bitmaps instead of striding over every element.
+template <typename T, size_t N>
+class slab
+{
+    static_assert(N < slab_handle::invalid_index, "slab too large for its handles");
+
+public:
+    slab()
+    {
+        for (size_t i = 0; i < N; i++)
+        {
+            free_slots[i] = N - 1 - i; // Lowest slots are handed out first
+        }
+    }
+
+    static constexpr size_t capacity() { return N; }
+    size_t size() const { return N - free_count; }
+    bool full() const { return free_count == 0; }
+
+    // Slot reset to T{}, nullptr when full
+    T *allocate()
+    {
+        if (full())
+            return nullptr;
+        const uint16_t index = free_slots[--free_count];
+        values[index] = T{};
+        set_used(index, true);
+        return &values[index];
+    }
+
+    void release(const T *value)
+    {
+        if (const size_t index = index_of(value); index < N && used(index))
+        {
+            set_used(index, false);
+            generations[index]++;
+            free_slots[free_count++] = index;
+        }
+    }
+
+    void clear()
+    {
+        for (size_t i = 0; i < N; i++)
+        {
+            release(&values[i]);
+        }
+    }
+
+    slab_handle handle_of(const T *value) const
+    {
+        const size_t index = index_of(value);
+        if (index >= N || !used(index))
+            return {};
+        return {static_cast<uint16_t>(index), generations[index]};
+    }
+
+    // Slot an element lives in, capacity() for a pointer outside the slab. Does not check the
+    // slot is in use, so it needs no lock as long as the element is not released meanwhile.
+    size_t slot_of(const T *value) const { return index_of(value); }
+
+    T *get(slab_handle handle)
+    {
+        if (handle.index >= N || !used(handle.index) || generations[handle.index] != handle.generation)
+            return nullptr;
+        return &values[handle.index];
+    }
+
+    // Element in a slot, nullptr if the slot is free
+    T *at(size_t index)
+    {
+        return index < N && used(index) ? &values[index] : nullptr;
+    }
+
+    // First used slot at or after index, capacity() if there is none
+    size_t next_used(size_t index) const
+    {
+        while (index < N)
+        {
+            const uint32_t bits = used_words[index / word_bits] & (~0u << (index % word_bits));
+            if (bits != 0)
+                return index - index % word_bits + std::countr_zero(bits);
+            index += word_bits - index % word_bits;
+        }
+        return N;
+    }
+
+    template <typename F>
+    void for_each(F &&func)
+    {
+        for_each_index([this, &func](size_t index)
+                       { func(values[index]); });
+    }
+
+    template <typename F>
+    void for_each(F &&func) const
+    {
+        for_each_index([this, &func](size_t index)
+                       { func(values[index]); });
+    }
+
+private:
+    static constexpr size_t word_bits = 32;
+
+    bool used(size_t index) const { return used_words[index / word_bits] & (1u << (index % word_bits)); }
+
+    void set_used(size_t index, bool value)
+    {
+        const uint32_t bit = 1u << (index % word_bits);
+        used_words[index / word_bits] = value ? used_words[index / word_bits] | bit : used_words[index / word_bits] & ~bit;
+    }
+
+    // Visits used slots in index order, skipping empty words whole
+    template <typename F>
+    void for_each_index(F &&func) const
+    {
+        for (size_t word = 0; word < used_words.size(); word++)
+        {
+            const size_t first = word * word_bits;
+            if (used_words[word] == ~0u)
+            {
+                for (size_t index = first; index < first + word_bits; index++)
+                {
+                    func(index);
+                }
+                continue;
+            }
+            for (uint32_t bits = used_words[word]; bits != 0; bits &= bits - 1)
+            {
+                func(first + std::countr_zero(bits));
+            }
+        }
+    }
+
+    size_t index_of(const T *value) const
+    {
+        const auto address = reinterpret_cast<uintptr_t>(value);
+        const auto first = reinterpret_cast<uintptr_t>(values.data());
+        if (address < first || address >= first + sizeof(values) || (address - first) % sizeof(T) != 0)
+            return N;
+        return (address - first) / sizeof(T);
+    }
+
+    std::array<T, N> values{};
+    std::array<uint32_t, (N + word_bits - 1) / word_bits> used_words{};
+    std::array<uint16_t, N> generations{};
+    std::array<uint16_t, N> free_slots{};
+    size_t free_count = N;
+};
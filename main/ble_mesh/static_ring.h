@@ -0,0 +1,60 @@
+#pragma once
+#include <array>
+#include <cstddef>
+
+// Fixed capacity FIFO that never allocates. Elements can also be replaced or
+// removed in the middle, which the message queue needs for pipelining and coalescing.
+template <typename T, size_t N>
+class static_ring
+{
+public:
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    bool full() const { return count == N; }
+    static constexpr size_t capacity() { return N; }
+
+    T &operator[](size_t i) { return items[(head + i) % N]; }
+    const T &operator[](size_t i) const { return items[(head + i) % N]; }
+    T &front() { return items[head]; }
+    const T &front() const { return items[head]; }
+    T &back() { return (*this)[count - 1]; }
+
+    bool push_back(const T &item)
+    {
+        if (full())
+            return false;
+        items[(head + count) % N] = item;
+        count++;
+        return true;
+    }
+
+    void pop_front()
+    {
+        if (empty())
+            return;
+        head = (head + 1) % N;
+        count--;
+    }
+
+    void erase(size_t i)
+    {
+        if (i >= count)
+            return;
+        for (; i + 1 < count; i++)
+        {
+            (*this)[i] = (*this)[i + 1];
+        }
+        count--;
+    }
+
+    void clear()
+    {
+        head = 0;
+        count = 0;
+    }
+
+private:
+    std::array<T, N> items{};
+    size_t head = 0;
+    size_t count = 0;
+};
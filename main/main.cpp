@@ -167,7 +167,7 @@ extern "C" void app_main()
         
         node_manager().initialize();
         mqtt5_app_start();
-        refresh_all_nodes();
+        start_nodes();
 
         esp_log_level_set("*", ESP_LOG_INFO);
         esp_log_level_set("mqtt_client", ESP_LOG_VERBOSE);
@@ -0,0 +1,455 @@
+#include "light_command.h"
+#include <array>
+#include <charconv>
+#include <cstring>
+#include <string_view>
+
+namespace
+{
+enum class light_key : uint8_t
+{
+    none,
+    state,
+    brightness,
+    color,
+    color_temp,
+    transition,
+    effect,
+    h,
+    s,
+};
+
+struct key_name
+{
+    std::string_view name;
+    light_key key;
+};
+
+constexpr key_name key_names[] = {
+    {"state", light_key::state},
+    {"brightness", light_key::brightness},
+    {"color", light_key::color},
+    {"color_temp", light_key::color_temp},
+    {"transition", light_key::transition},
+    {"effect", light_key::effect},
+    {"h", light_key::h},
+    {"s", light_key::s},
+};
+
+// Perfect over key_names: length, first and last characters pick a distinct slot for each, any
+// other key costs one comparison against the name in its slot
+constexpr size_t key_slots = 16;
+
+constexpr size_t key_hash(std::string_view name)
+{
+    return (name.size() + static_cast<uint8_t>(name.front()) + (static_cast<uint8_t>(name.back()) << 3)) & (key_slots - 1);
+}
+
+constexpr std::array<key_name, key_slots> make_key_table()
+{
+    std::array<key_name, key_slots> table{};
+    for (const key_name &k : key_names)
+    {
+        table[key_hash(k.name)] = k;
+    }
+    return table;
+}
+
+constexpr std::array<key_name, key_slots> key_table = make_key_table();
+
+constexpr bool key_table_is_perfect()
+{
+    for (const key_name &k : key_names)
+    {
+        if (key_table[key_hash(k.name)].key != k.key)
+            return false;
+    }
+    return true;
+}
+static_assert(key_table_is_perfect(), "two light command keys share a slot, change key_hash");
+
+light_key lookup_key(std::string_view name)
+{
+    if (name.empty())
+        return light_key::none;
+    const key_name &k = key_table[key_hash(name)];
+    return k.name == name ? k.key : light_key::none;
+}
+
+bool is_hex(char c)
+{
+    return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+}
+
+uint16_t hex_value(const char *digits)
+{
+    uint16_t value = 0;
+    for (int i = 0; i < 4; i++)
+    {
+        const char c = digits[i];
+        value = (value << 4) | (c <= '9' ? c - '0' : (c | 0x20) - 'a' + 10);
+    }
+    return value;
+}
+
+// Unescapes a string checked by tokenizer::string() into out, truncated to capacity - 1 and NUL
+// terminated. Code points past ASCII come out as UTF-8, surrogates as '?'.
+std::string_view unescape(std::string_view raw, char *out, size_t capacity)
+{
+    size_t size = 0;
+    const auto put = [&](char c)
+    {
+        if (size + 1 < capacity)
+            out[size++] = c;
+    };
+    for (size_t i = 0; i < raw.size(); i++)
+    {
+        if (raw[i] != '\\')
+        {
+            put(raw[i]);
+            continue;
+        }
+        const char c = raw[++i];
+        switch (c)
+        {
+        case 'b': put('\b'); break;
+        case 'f': put('\f'); break;
+        case 'n': put('\n'); break;
+        case 'r': put('\r'); break;
+        case 't': put('\t'); break;
+        case 'u':
+        {
+            const uint16_t code = hex_value(&raw[i + 1]);
+            i += 4;
+            if (code < 0x80)
+            {
+                put(static_cast<char>(code));
+            }
+            else if (code < 0x800)
+            {
+                put(static_cast<char>(0xC0 | (code >> 6)));
+                put(static_cast<char>(0x80 | (code & 0x3F)));
+            }
+            else if (code >= 0xD800 && code <= 0xDFFF)
+            {
+                put('?');
+            }
+            else
+            {
+                put(static_cast<char>(0xE0 | (code >> 12)));
+                put(static_cast<char>(0x80 | ((code >> 6) & 0x3F)));
+                put(static_cast<char>(0x80 | (code & 0x3F)));
+            }
+            break;
+        }
+        default: put(c); break;
+        }
+    }
+    out[size] = '\0';
+    return {out, size};
+}
+
+// Escapes are rare in commands, only strings that have one are copied
+constexpr size_t name_max = 16; // Longer than any key or state value
+
+std::string_view plain(std::string_view raw, char (&buffer)[name_max])
+{
+    return raw.find('\\') == std::string_view::npos ? raw : unescape(raw, buffer, sizeof(buffer));
+}
+
+class tokenizer
+{
+public:
+    tokenizer(const char *data, size_t size) : p(data), end(data + size) {}
+
+    void skip_whitespace()
+    {
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r'))
+            p++;
+    }
+
+    bool consume(char c)
+    {
+        skip_whitespace();
+        if (p < end && *p == c)
+        {
+            p++;
+            return true;
+        }
+        return false;
+    }
+
+    char peek()
+    {
+        skip_whitespace();
+        return p < end ? *p : '\0';
+    }
+
+    bool at_end()
+    {
+        skip_whitespace();
+        return p == end;
+    }
+
+    // Raw string contents between the quotes, escapes checked but left in place
+    bool string(std::string_view *raw)
+    {
+        if (!consume('"'))
+            return false;
+        const char *start = p;
+        while (p < end && *p != '"')
+        {
+            if (static_cast<uint8_t>(*p) < 0x20)
+                return false;
+            if (*p == '\\')
+            {
+                if (++p == end)
+                    return false;
+                if (*p == 'u')
+                {
+                    if (end - p < 5 || !is_hex(p[1]) || !is_hex(p[2]) || !is_hex(p[3]) || !is_hex(p[4]))
+                        return false;
+                    p += 4;
+                }
+                else if (!strchr("\"\\/bfnrt", *p))
+                {
+                    return false;
+                }
+            }
+            p++;
+        }
+        if (p == end)
+            return false;
+        *raw = {start, static_cast<size_t>(p - start)};
+        p++;
+        return true;
+    }
+
+    bool number(double *value)
+    {
+        skip_whitespace();
+        const char *start = p;
+        if (p < end && *p == '-')
+            p++;
+        if (p == end || *p < '0' || *p > '9')
+            return false;
+        while (p < end && ((*p >= '0' && *p <= '9') || *p == '.' || *p == 'e' || *p == 'E' || *p == '+' || *p == '-'))
+            p++;
+        const auto [ptr, ec] = std::from_chars(start, p, *value);
+        return ec == std::errc{} && ptr == p;
+    }
+
+    bool literal(std::string_view word)
+    {
+        skip_whitespace();
+        if (static_cast<size_t>(end - p) < word.size() || std::string_view{p, word.size()} != word)
+            return false;
+        p += word.size();
+        return true;
+    }
+
+    // Any value, nested objects and arrays included, without recursion
+    bool skip_value()
+    {
+        uint64_t objects = 0; // Bit d set when the container open at depth d is an object
+        size_t depth = 0;
+        for (;;)
+        {
+            const char c = peek();
+            if (c == '{' || c == '[')
+            {
+                if (depth == max_depth)
+                    return false;
+                p++;
+                const bool object = c == '{';
+                objects = object ? objects | (1ull << depth) : objects & ~(1ull << depth);
+                depth++;
+                if (!consume(object ? '}' : ']'))
+                {
+                    if (object && !member_name())
+                        return false;
+                    continue;
+                }
+                depth--;
+            }
+            else if (!scalar())
+            {
+                return false;
+            }
+
+            // Past a value: the next member or element, or the end of the containers it closes
+            for (;;)
+            {
+                if (depth == 0)
+                    return true;
+                const bool object = objects & (1ull << (depth - 1));
+                if (consume(','))
+                {
+                    if (object && !member_name())
+                        return false;
+                    break;
+                }
+                if (!consume(object ? '}' : ']'))
+                    return false;
+                depth--;
+            }
+        }
+    }
+
+    // "name": of an object member, unescaped into buffer if it has escapes
+    bool member_name(std::string_view *name, char (&buffer)[name_max])
+    {
+        std::string_view raw;
+        if (!string(&raw) || !consume(':'))
+            return false;
+        *name = plain(raw, buffer);
+        return true;
+    }
+
+    bool member_name()
+    {
+        std::string_view raw;
+        return string(&raw) && consume(':');
+    }
+
+private:
+    static constexpr size_t max_depth = 64;
+
+    bool scalar()
+    {
+        std::string_view raw;
+        double value;
+        switch (peek())
+        {
+        case '"':
+            return string(&raw);
+        case 't':
+            return literal("true");
+        case 'f':
+            return literal("false");
+        case 'n':
+            return literal("null");
+        default:
+            return number(&value);
+        }
+    }
+
+    const char *p;
+    const char *end;
+};
+
+bool is_number_start(char c)
+{
+    return c == '-' || (c >= '0' && c <= '9');
+}
+
+// Number value of a member, skipped if it has another type
+bool number_member(tokenizer &tokens, double *value, uint8_t flag, uint8_t *present)
+{
+    if (!is_number_start(tokens.peek()))
+        return tokens.skip_value();
+    if (!tokens.number(value))
+        return false;
+    *present |= flag;
+    return true;
+}
+
+bool parse_color(tokenizer &tokens, light_command *command)
+{
+    if (tokens.peek() != '{')
+        return tokens.skip_value();
+    tokens.consume('{');
+    if (tokens.consume('}'))
+        return true;
+
+    uint8_t seen = 0;
+    do
+    {
+        std::string_view name;
+        char buffer[name_max];
+        if (!tokens.member_name(&name, buffer))
+            return false;
+        const light_key key = lookup_key(name);
+        const uint8_t flag = key == light_key::h ? light_command::HAS_HUE : key == light_key::s ? light_command::HAS_SATURATION : 0;
+        if (flag == 0 || (seen & flag))
+        {
+            if (!tokens.skip_value())
+                return false;
+            continue;
+        }
+        seen |= flag;
+        if (!number_member(tokens, key == light_key::h ? &command->hue : &command->saturation, flag, &command->present))
+            return false;
+    } while (tokens.consume(','));
+    return tokens.consume('}');
+}
+
+bool parse_member(tokenizer &tokens, light_key key, light_command *command)
+{
+    std::string_view raw;
+    char buffer[name_max];
+    switch (key)
+    {
+    case light_key::state:
+        command->present |= light_command::HAS_STATE;
+        if (tokens.peek() != '"')
+            return tokens.skip_value();
+        if (!tokens.string(&raw))
+            return false;
+        raw = plain(raw, buffer);
+        command->state = raw == "ON" ? light_command::state_t::on : raw == "OFF" ? light_command::state_t::off : light_command::state_t::other;
+        return true;
+    case light_key::brightness:
+        return number_member(tokens, &command->brightness, light_command::HAS_BRIGHTNESS, &command->present);
+    case light_key::color_temp:
+        return number_member(tokens, &command->color_temp, light_command::HAS_COLOR_TEMP, &command->present);
+    case light_key::transition:
+        return number_member(tokens, &command->transition, light_command::HAS_TRANSITION, &command->present);
+    case light_key::color:
+        return parse_color(tokens, command);
+    case light_key::effect:
+        if (tokens.peek() != '"')
+            return tokens.skip_value();
+        if (!tokens.string(&raw))
+            return false;
+        unescape(raw, command->effect, sizeof(command->effect));
+        command->present |= light_command::HAS_EFFECT;
+        return true;
+    default:
+        return tokens.skip_value();
+    }
+}
+} // namespace
+
+bool parse_light_command(const char *data, size_t size, light_command *command)
+{
+    *command = light_command{};
+    tokenizer tokens(data, size);
+    if (!tokens.consume('{'))
+        return false;
+    if (!tokens.consume('}'))
+    {
+        uint16_t seen = 0; // Keys met so far, by light_key
+        do
+        {
+            std::string_view name;
+            char buffer[name_max];
+            if (!tokens.member_name(&name, buffer))
+                return false;
+            const light_key key = lookup_key(name);
+            const uint16_t bit = 1u << static_cast<uint8_t>(key);
+            if (key == light_key::none || key == light_key::h || key == light_key::s || (seen & bit))
+            {
+                if (!tokens.skip_value())
+                    return false;
+                continue;
+            }
+            seen |= bit;
+            if (!parse_member(tokens, key, command))
+                return false;
+        } while (tokens.consume(','));
+        if (!tokens.consume('}'))
+            return false;
+    }
+    return tokens.at_end();
+}
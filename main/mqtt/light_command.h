@@ -0,0 +1,42 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// Command of the Home Assistant JSON light schema, as received on a node's /set topic
+struct light_command
+{
+    enum : uint8_t
+    {
+        HAS_STATE = 1 << 0, // "state" present, whatever its value
+        HAS_BRIGHTNESS = 1 << 1,
+        HAS_HUE = 1 << 2,
+        HAS_SATURATION = 1 << 3,
+        HAS_COLOR_TEMP = 1 << 4,
+        HAS_TRANSITION = 1 << 5,
+        HAS_EFFECT = 1 << 6,
+    };
+
+    enum class state_t : uint8_t
+    {
+        other, // Not "ON" or "OFF", or not a string
+        on,
+        off,
+    };
+
+    static constexpr size_t effect_max = 32;
+
+    uint8_t present = 0; // HAS_* of the keys given with a value of the expected type
+    state_t state = state_t::other;
+    double brightness = 0;
+    double hue = 0;
+    double saturation = 0;
+    double color_temp = 0;
+    double transition = 0;
+    char effect[effect_max] = {}; // Unescaped, truncated if longer, NUL terminated
+};
+
+// Single pass over the payload, which need not be NUL terminated, with no heap use. Keys are
+// matched case sensitively after unescaping, the first occurrence of a key wins like cJSON
+// lookups, unknown keys and values of the wrong type are skipped. False if the payload is not
+// one JSON object, trailing bytes and numbers past the double range included.
+bool parse_light_command(const char *data, size_t size, light_command *command);
@@ -2,7 +2,8 @@
 #include "mqtt_control.h"
 
 #include "esp_log.h"
-#include "esp_timer.h"
+#include "timer/timer_wheel.h"
+#include "ble_mesh/message_queue.h"
 #include "esp_heap_caps.h"
 #include "esp_mac.h"
 #include "esp_wifi.h"
@@ -38,13 +39,11 @@ std::string get_bridge_mac_identifier()
     return std::string(identifier);
 }
 
-std::string get_bridge_base_topic()
+const std::string &get_bridge_base_topic()
 {
-    // Create base topic with MAC address
-    char topic[32];
-    snprintf(topic, sizeof(topic), "blemesh2mqtt_%s", get_wifi_mac_string().c_str());
-    
-    return std::string(topic);
+    // Create base topic with MAC address, once: node topics are built from it
+    static const std::string topic{"blemesh2mqtt_" + get_wifi_mac_string()};
+    return topic;
 }
 
 const char* get_bridge_availability_topic()
@@ -59,6 +58,12 @@ const char* get_bridge_state_topic()
     return topic.c_str();
 }
 
+const char* get_bridge_mesh_stats_topic()
+{
+    static const std::string topic{get_bridge_base_topic() + "/bridge/mesh_stats"};
+    return topic.c_str();
+}
+
 static cJSON* create_bridge_device_object()
 {
     cJSON *device = cJSON_CreateObject();
@@ -353,7 +358,8 @@ void send_bridge_discovery()
 
 #define PUBLISH_INTERVAL_MS 10000
 
-esp_timer_handle_t publish_timer;
+static wheel_timer publish_timer;
+static wheel_timer mesh_stats_timer;
 
 void periodic_publish_callback(void *arg)
 {
@@ -361,17 +367,26 @@ void periodic_publish_callback(void *arg)
     publish_bridge_info(version);
 }
 
+void publish_mesh_stats(void *arg)
+{
+    // Large fleets are paged, each publish carries the nodes following those of the previous one
+    static size_t next_slot = 0;
+    next_slot = message_queue().print_stats_json(next_slot, [](std::string_view json)
+    {
+        int msg_id = esp_mqtt_client_publish(get_mqtt_client(), get_bridge_mesh_stats_topic(), json.data(), json.size(), 0, 0);
+        ESP_LOGV(TAG, "sent mesh stats publish successful, msg_id=%d", msg_id);
+    });
+}
+
 void start_periodic_publish_timer()
 {
-    const esp_timer_create_args_t timer_args = {
-        .callback = &periodic_publish_callback,
-        .arg = NULL,
-        .dispatch_method = ESP_TIMER_TASK,
-        .name = "mqtt_info_pub"
-    };
-
-    ESP_ERROR_CHECK(esp_timer_create(&timer_args, &publish_timer));
-    ESP_ERROR_CHECK(esp_timer_start_periodic(publish_timer, PUBLISH_INTERVAL_MS * 1000));
+    timer_wheel().init_timer(publish_timer, &periodic_publish_callback, NULL, "mqtt_info_pub");
+    timer_wheel().start_periodic(publish_timer, PUBLISH_INTERVAL_MS * 1000);
+
+#if CONFIG_BM2MQTT_MESH_STATS_PUBLISH_S > 0
+    timer_wheel().init_timer(mesh_stats_timer, &publish_mesh_stats, NULL, "mqtt_mesh_stats_pub");
+    timer_wheel().start_periodic(mesh_stats_timer, CONFIG_BM2MQTT_MESH_STATS_PUBLISH_S * 1000000ULL);
+#endif
 }
 
 void mqtt_publish_provisioning_enabled(bool enable_provisioning)
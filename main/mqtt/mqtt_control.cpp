@@ -13,6 +13,9 @@
 #include "ble_mesh/ble_mesh_control.h"
 #include "debug_console_common.h"
 #include "mqtt_bridge.h"
+#include "light_command.h"
+#include "status_json.h"
+#include "topic_router.h"
 #include <memory>
 #include <string>
 #include "cJSON.h"
@@ -64,55 +67,21 @@ static esp_mqtt5_disconnect_property_config_t disconnect_property = {
     .disconnect_reason = 0,
 };
 
-static std::string get_node_base_topic(const bm2mqtt_node_info *node_info)
+// <base>/+/set: one subscription covers the set topic of every node, provisioned later or not
+static const char *get_node_set_subscription()
 {
-    if (esp_ble_mesh_node_t *mesh_node = esp_ble_mesh_provisioner_get_node_with_uuid(node_info->uuid.raw()))
-    {
-        std::string node_addr {bt_hex(mesh_node->addr, BD_ADDR_LEN)};
-        return get_bridge_base_topic() + "/node_" + node_addr;
-    }
-    ESP_LOGW(TAG, "Failed to get node base topic - node not found");
-    return {};
-}
-
-std::string get_node_root_topic(const bm2mqtt_node_info *node_info)
-{
-    return get_node_base_topic(node_info);
-}
-
-std::string get_node_set_topic(const bm2mqtt_node_info *node_info)
-{
-    const std::string base = get_node_base_topic(node_info);
-    return base.empty() ? std::string{} : base + "/set";
-}
-
-std::string get_node_state_topic(const bm2mqtt_node_info *node_info)
-{
-    const std::string base = get_node_base_topic(node_info);
-    return base.empty() ? std::string{} : base + "/state";
-}
-
-std::string get_node_discovery_id(const bm2mqtt_node_info *node_info)
-{
-    if (esp_ble_mesh_node_t *mesh_node = esp_ble_mesh_provisioner_get_node_with_uuid(node_info->uuid.raw()))
-    {
-        char buf[64] = {0};
-        snprintf(buf, sizeof(buf), "homeassistant/light/blemesh2mqtt_%s", bt_hex(mesh_node->addr, BD_ADDR_LEN));
-
-        std::string uniq_id = std::string{buf} + "_light/config";
-
-        return uniq_id;
-    }
-    return {};
+    static const std::string topic{get_bridge_base_topic() + "/+/set"};
+    return topic.c_str();
 }
 
 void subscribe_nodes(esp_mqtt_client_handle_t client)
 {
-    node_manager().for_each_node([&client](const bm2mqtt_node_info *node_info)
+    int msg_id = esp_mqtt_client_subscribe(client, get_node_set_subscription(), 0);
+    ESP_LOGI(TAG, "sent subscribe successful, msg_id=%d", msg_id);
+
+    node_manager().for_each_node([](const bm2mqtt_node_info *node_info)
     {
-        int msg_id = esp_mqtt_client_subscribe(client, get_node_set_topic(node_info).c_str(), 0);
-        //send_status(node_info);
-        ESP_LOGI(TAG, "sent subscribe successful, msg_id=%d", msg_id);
+        mqtt_node_send_availability(node_info, message_queue().is_reachable(node_info));
     });
 }
 
@@ -144,8 +113,10 @@ static void mqtt5_event_handler(void *handler_args, esp_event_base_t base, int32
 
         esp_mqtt5_client_set_subscribe_property(client, &subscribe_property);
        
+        register_mqtt_routes();
         subscribe_nodes(client);
         mqtt_bridge_subscribe(client);
+        publish_all_node_status();
 
         start_periodic_publish_timer();
 
@@ -290,7 +261,7 @@ std::unique_ptr<cJSON> make_node_discovery_message(const bm2mqtt_node_info *node
 {
     cJSON *root = cJSON_CreateObject();
 
-    if (esp_ble_mesh_node_t *mesh_node = esp_ble_mesh_provisioner_get_node_with_uuid(node->uuid.raw()))
+    if (const esp_ble_mesh_node_t *mesh_node = get_prov_node(node))
     {
         char buf[64] = {0};
         snprintf(buf, sizeof(buf), "node_%s", bt_hex(mesh_node->addr, BD_ADDR_LEN));
@@ -301,8 +272,7 @@ std::unique_ptr<cJSON> make_node_discovery_message(const bm2mqtt_node_info *node
             cJSON_AddItemToObject(root, "dev", dev = cJSON_CreateObject());
             if (dev != nullptr)
             {
-                uint16_t node_index = get_node_index(node->uuid);
-                const char* node_name = esp_ble_mesh_provisioner_get_node_name(node_index);
+                const char* node_name = get_prov_node_name(node);
                 cJSON_AddItemToObject(dev, "name", cJSON_CreateString(node_name ? node_name : "light"));
                 cJSON_AddItemToObject(dev, "ids", cJSON_CreateString(buf));
                 std::string identifier = get_bridge_mac_identifier();
@@ -322,7 +292,8 @@ std::unique_ptr<cJSON> make_node_discovery_message(const bm2mqtt_node_info *node
         }
 
         //const std::string root_publish = "blemesh2mqtt/" + std::string{buf};
-        const std::string root_publish = get_node_root_topic(node);
+        const node_topics topics = node_manager().get_topics(node);
+        const std::string root_publish{topics.root()};
 
         cJSON_AddItemToObject(root, "~", cJSON_CreateString(root_publish.c_str()));
         cJSON_AddItemToObject(root, "name", cJSON_CreateNull());
@@ -330,6 +301,23 @@ std::unique_ptr<cJSON> make_node_discovery_message(const bm2mqtt_node_info *node
         cJSON_AddItemToObject(root, "uniq_id", cJSON_CreateString(uniq_id.c_str()));
         cJSON_AddItemToObject(root, "cmd_t", cJSON_CreateString("~/set"));
         cJSON_AddItemToObject(root, "stat_t", cJSON_CreateString("~/state"));
+
+        // Offline when either the bridge or the bulb is
+        cJSON *avty = nullptr;
+        cJSON_AddItemToObject(root, "avty", avty = cJSON_CreateArray());
+        if (avty != nullptr)
+        {
+            cJSON *bridge_avty = cJSON_CreateObject();
+            cJSON_AddStringToObject(bridge_avty, "t", get_bridge_availability_topic());
+            cJSON_AddStringToObject(bridge_avty, "pl_avail", "on");
+            cJSON_AddStringToObject(bridge_avty, "pl_not_avail", "offline");
+            cJSON_AddItemToArray(avty, bridge_avty);
+
+            cJSON *node_avty = cJSON_CreateObject();
+            cJSON_AddStringToObject(node_avty, "t", topics.availability());
+            cJSON_AddItemToArray(avty, node_avty);
+        }
+        cJSON_AddItemToObject(root, "avty_mode", cJSON_CreateString("all"));
         cJSON_AddItemToObject(root, "schema", cJSON_CreateString("json"));
         cJSON_AddItemToObject(root, "brightness", cJSON_CreateBool(1));
         cJSON *sup_clrm = nullptr;
@@ -361,185 +349,153 @@ std::unique_ptr<cJSON> make_node_discovery_message(const bm2mqtt_node_info *node
     return std::unique_ptr<cJSON>{root};
 }
 
-std::unique_ptr<cJSON> make_status_message(const bm2mqtt_node_info *node_info)
+static void handle_provisioning_set(const char *data, int data_len, node_handle)
 {
-    cJSON *root, *color;
-    root = cJSON_CreateObject();
+    //buffer_length = strlen(event->data) + sizeof("");
+    ESP_LOGI(TAG, "Received provisioning command from MQTT: [%.*s]", data_len, data);
 
-    if (node_info->unicast != ESP_BLE_MESH_ADDR_UNASSIGNED)
+    ble_mesh_set_provisioning_enabled(strncmp(data, "ON", data_len) == 0);
+}
+
+static void handle_restart_set(const char *data, int data_len, node_handle)
+{
+    ESP_LOGI(TAG, "Received restart command from MQTT: [%.*s]", data_len, data);
+
+    if (strncmp(data, "RESTART", data_len) == 0)
     {
-        cJSON_AddStringToObject(root, "state", node_info->onoff ? "ON" : "OFF");
+        ESP_LOGW(TAG, "Bridge restart requested via MQTT - restarting in 2 seconds...");
         
-        if (node_info->color_mode == color_mode_t::brightness)
-        {
-            cJSON_AddStringToObject(root, "color_mode", "brightness");
-            cJSON_AddNumberToObject(root, "brightness", (uint16_t)map(node_info->hsl_l, node_info->min_lightness, node_info->max_lightness, 0, 255));
-        }
-        else if (node_info->color_mode == color_mode_t::color_temp)
-        {
-            cJSON_AddStringToObject(root, "color_mode", "color_temp");
-            cJSON_AddNumberToObject(root, "color_temp", node_info->curr_temp);
-        }
-        else if (node_info->color_mode == color_mode_t::hs)
-        {
-            cJSON_AddStringToObject(root, "color_mode", "hs");
-            cJSON_AddItemToObject(root, "color", color = cJSON_CreateObject());
-            cJSON_AddNumberToObject(color, "h", (uint16_t)map(node_info->hsl_h, node_info->min_hue, node_info->max_hue, 0, 360));
-            cJSON_AddNumberToObject(color, "s", (uint16_t)map(node_info->hsl_s, node_info->min_saturation, node_info->max_saturation, 0, 100));    
-        }
+        // Give time for MQTT response to be sent before restarting
+        vTaskDelay(pdMS_TO_TICKS(2000));
+        esp_restart();
     }
-
-    return std::unique_ptr<cJSON>{root};
 }
 
-void parse_mqtt_event_data(esp_mqtt_event_handle_t event)
+static void handle_node_set(const char *data, int data_len, node_handle node)
 {
-
-    if (strncmp(event->topic, get_bridge_provisioning_set_topic(), event->topic_len) == 0)
+    bm2mqtt_node_info *node_info = node_manager().get_node(node);
+    if (!node_info)
     {
-        //buffer_length = strlen(event->data) + sizeof("");
-        ESP_LOGI(TAG, "Received provisioning command from MQTT: [%.*s]", event->data_len, event->data  );
+        return;
+    }
 
-        ble_mesh_set_provisioning_enabled(strncmp(event->data, "ON",event->data_len) == 0);
-   
+    light_command command;
+    if (!parse_light_command(data, data_len, &command))
+    {
+        ESP_LOGW(TAG, "Invalid light command for node 0x%04X: [%.*s]", node_info->unicast, data_len, data);
         return;
     }
+    if (!(command.present & light_command::HAS_STATE))
+    {
+        return;
+    }
+
+    if (command.state == light_command::state_t::on)
+    {
+        update_node_field(node_info, &bm2mqtt_node_info::onoff, true, FIELD_ONOFF, state_source::assumed);
+        gen_onoff_set(node_info);
+    }
+    else if (command.state == light_command::state_t::off)
+    {
+        update_node_field(node_info, &bm2mqtt_node_info::onoff, false, FIELD_ONOFF, state_source::assumed);
+        gen_onoff_set(node_info);
+    }
 
-    if (strncmp(event->topic, get_bridge_restart_set_topic(), event->topic_len) == 0)
+    bool light_value_changed = false;
+    color_mode_t current_mode = node_info->color_mode;
+  
+    if ((node_info->features & FEATURE_LIGHT_LIGHTNESS) || (node_info->features & FEATURE_LIGHT_HSL))
     {
-        ESP_LOGI(TAG, "Received restart command from MQTT: [%.*s]", event->data_len, event->data);
+        ESP_LOGW(TAG, "[parse_mqtt_event_data] Light Lightness feature supported");
+        if (command.present & light_command::HAS_BRIGHTNESS)
+        {
+            current_mode = color_mode_t::brightness;
+            uint16_t filteredValue = (uint16_t)map(command.brightness, 0, 255, node_info->min_lightness, node_info->max_lightness);
+            update_node_field(node_info, &bm2mqtt_node_info::hsl_l, filteredValue, FIELD_LIGHTNESS, state_source::assumed);
+            light_value_changed = true;
+        }
+    }
 
-        if (strncmp(event->data, "RESTART", event->data_len) == 0)
+    if (node_info->features & FEATURE_LIGHT_HSL)
+    {
+        ESP_LOGW(TAG, "[parse_mqtt_event_data] Light HSL feature supported");
+        if (command.present & light_command::HAS_HUE)
         {
-            ESP_LOGW(TAG, "Bridge restart requested via MQTT - restarting in 2 seconds...");
-            
-            // Give time for MQTT response to be sent before restarting
-            vTaskDelay(pdMS_TO_TICKS(2000));
-            esp_restart();
+            uint16_t filteredValue = (uint16_t)map(command.hue, 0, 360, node_info->min_hue, node_info->max_hue);
+            update_node_field(node_info, &bm2mqtt_node_info::hsl_h, filteredValue, FIELD_HUE_SATURATION, state_source::assumed);
+            current_mode = color_mode_t::hs;
+            light_value_changed = true;
+        }
+        if (command.present & light_command::HAS_SATURATION)
+        {
+            uint16_t filteredValue = (uint16_t)map(command.saturation, 0, 100, node_info->min_saturation, node_info->max_saturation);
+            update_node_field(node_info, &bm2mqtt_node_info::hsl_s, filteredValue, FIELD_HUE_SATURATION, state_source::assumed);
+            current_mode = color_mode_t::hs;
+            light_value_changed = true;
         }
-        
-        return;
     }
 
-    // FIX-ME : likely slow af
-    const std::string topic{event->topic, static_cast<std::string::size_type>(event->topic_len)};
-    if (auto index_pos = topic.find("node_"); index_pos != std::string::npos)
+    if (node_info->features & FEATURE_LIGHT_CTL)
     {
-        // +5 : sizeof node_
-        // 12 sizeof mac address string
-        const std::string mac{topic, index_pos + 5, 12};
-        if (bm2mqtt_node_info *node_info = node_manager().get_node(mac))
+        ESP_LOGW(TAG, "[parse_mqtt_event_data] Light CTL feature supported");
+        if (command.present & light_command::HAS_COLOR_TEMP)
         {
-            if (cJSON *response = cJSON_Parse(event->data))
-            {
-                if (const cJSON *name = cJSON_GetObjectItemCaseSensitive(response, "state"))
-                {
-                    if (cJSON_IsString(name) && (name->valuestring != NULL))
-                    {
-                        if (strcmp(name->valuestring, "ON") == 0)
-                        {
-                            node_info->onoff = true;
-                            gen_onoff_set(node_info);
-                        }
-                        else if (strcmp(name->valuestring, "OFF") == 0)
-                        {
-                            node_info->onoff = false;
-                            gen_onoff_set(node_info);
-                        }
-                    }
-
-                    bool light_value_changed = false;
-                    color_mode_t current_mode = node_info->color_mode;
-                  
-                    if ((node_info->features & FEATURE_LIGHT_LIGHTNESS) || (node_info->features & FEATURE_LIGHT_HSL))
-                    {
-                        ESP_LOGW(TAG, "[parse_mqtt_event_data] Light Lightness feature supported");
-                        if (cJSON *brightness = cJSON_GetObjectItemCaseSensitive(response, "brightness"))
-                        {
-                            if (cJSON_IsNumber(brightness))
-                            {
-                                current_mode = color_mode_t::brightness;
-                                uint16_t filteredValue = (uint16_t)map(brightness->valuedouble, 0, 255, node_info->min_lightness, node_info->max_lightness);
-                                node_info->hsl_l = filteredValue;
-                                light_value_changed = true;
-                            }
-                        }
-                    }
-
-                    if (node_info->features & FEATURE_LIGHT_HSL)
-                    {
-                        ESP_LOGW(TAG, "[parse_mqtt_event_data] Light HSL feature supported");
-                        if (cJSON *color = cJSON_GetObjectItemCaseSensitive(response, "color"))
-                        {
-                            if (cJSON_IsObject(color))
-                            {
-                                cJSON *hue = cJSON_GetObjectItemCaseSensitive(color, "h");
-                                cJSON *saturation = cJSON_GetObjectItemCaseSensitive(color, "s");
-
-                                if (cJSON_IsNumber(hue))
-                                {
-                                    uint16_t filteredValue = (uint16_t)map(hue->valuedouble, 0, 360, node_info->min_hue, node_info->max_hue);
-                                    node_info->hsl_h = filteredValue;
-                                    current_mode = color_mode_t::hs;
-                                    light_value_changed = true;
-                                }
-                                if (cJSON_IsNumber(saturation))
-                                {
-                                    uint16_t filteredValue = (uint16_t)map(saturation->valuedouble, 0, 100, node_info->min_saturation, node_info->max_saturation);
-                                    node_info->hsl_s = filteredValue;
-                                    current_mode = color_mode_t::hs;
-                                    light_value_changed = true;
-                                }
-                            }
-                        }
-                    }
-
-                    if (node_info->features & FEATURE_LIGHT_CTL)
-                    {
-                        ESP_LOGW(TAG, "[parse_mqtt_event_data] Light CTL feature supported");
-                        if (cJSON *color_temp = cJSON_GetObjectItemCaseSensitive(response, "color_temp"))
-                        {
-                            if (cJSON_IsNumber(color_temp))
-                            {
-                                uint16_t filteredValue = (uint16_t)map(color_temp->valuedouble, 2000, 6535, node_info->min_temp, node_info->max_temp);
-                                node_info->curr_temp = filteredValue;
-                                current_mode = color_mode_t::color_temp;
-                                light_value_changed = true;
-                            }
-                        }
-                    }
-
-                    if (light_value_changed)
-                    {
-                        if (current_mode == color_mode_t::color_temp)
-                        {
-                            // ble_mesh_ctl_temperature_set(node_info);
-                            ble_mesh_ctl_set(node_info);
-                        }
-                        else if (current_mode == color_mode_t::hs)
-                        {
-                            light_hsl_set(node_info);
-                        }
-                        else if (current_mode == color_mode_t::brightness)
-                        {
-                            ble_mesh_lightness_set(node_info);
-                        }
-                    }
-
-                    message_queue().enqueue(node_info, message_payload{
-                                           .send = [node_info]()
-                                           {
-                                               mqtt_node_send_status(node_info);
-                                           },
-                                           .opcode = 0x0000, // No specific opcode, just a marker
-                                           .retries_left = 0,
-                                           .type = message_type_t::mqtt_message, // Indicate this is a MQTT message
-                                       });
-                }
-                cJSON_Delete(response);
-            }
+            uint16_t filteredValue = (uint16_t)map(command.color_temp, 2000, 6535, node_info->min_temp, node_info->max_temp);
+            update_node_field(node_info, &bm2mqtt_node_info::curr_temp, filteredValue, FIELD_TEMPERATURE, state_source::assumed);
+            current_mode = color_mode_t::color_temp;
+            light_value_changed = true;
         }
     }
+
+    if (light_value_changed)
+    {
+        if (current_mode == color_mode_t::color_temp)
+        {
+            // ble_mesh_ctl_temperature_set(node_info);
+            ble_mesh_ctl_set(node_info);
+        }
+        else if (current_mode == color_mode_t::hs)
+        {
+            light_hsl_set(node_info);
+        }
+        else if (current_mode == color_mode_t::brightness)
+        {
+            ble_mesh_lightness_set(node_info);
+        }
+    }
+
+    message_queue().enqueue(node_info, make_mqtt_marker(node_info->unicast, mqtt_action_t::status, command_priority_t::interactive));
+}
+
+// node_<mac> level of a node topic
+static node_handle resolve_node_level(std::string_view level)
+{
+    constexpr std::string_view node_prefix{"node_"};
+    if (!level.starts_with(node_prefix))
+    {
+        return {};
+    }
+    return node_manager().get_handle(node_manager().get_node(level.substr(node_prefix.size())));
+}
+
+void register_mqtt_routes()
+{
+    topic_router &router = mqtt_topic_router();
+    router.clear();
+    router.add(get_bridge_provisioning_set_topic(), &handle_provisioning_set);
+    router.add(get_bridge_restart_set_topic(), &handle_restart_set);
+    router.add_level(get_bridge_base_topic(), "set", &handle_node_set, &resolve_node_level);
+}
+
+void parse_mqtt_event_data(esp_mqtt_event_handle_t event)
+{
+    const topic_router::route route = mqtt_topic_router().find({event->topic, static_cast<size_t>(event->topic_len)});
+    if (!route.handler)
+    {
+        ESP_LOGW(TAG, "No route for topic %.*s", event->topic_len, event->topic);
+        return;
+    }
+    route.handler(event->data, event->data_len, route.node);
 }
 
 int send_discovery(int argc, char **argv)
@@ -556,7 +512,7 @@ int send_discovery(int argc, char **argv)
         std::unique_ptr<cJSON> discovery_message = make_node_discovery_message(node_info);
         char *json_data = cJSON_PrintUnformatted(discovery_message.get());
         int msg_id = 0;
-        msg_id = esp_mqtt_client_publish(mqtt_client, get_node_discovery_id(node_info).c_str(), json_data, 0, 0, 0);
+        msg_id = esp_mqtt_client_publish(mqtt_client, node_manager().get_topics(node_info).discovery(), json_data, 0, 0, 0);
         ESP_LOGI(TAG, "sent discovery publish successful, msg_id=%d", msg_id);
     
         cJSON_free(json_data);
@@ -578,7 +534,7 @@ int delete_entity(int argc, char **argv)
     {
         const char *json_data = "";
         int msg_id = 0;
-        msg_id = esp_mqtt_client_publish(mqtt_client, get_node_discovery_id(node_info).c_str(), json_data, 0, 0, 0);
+        msg_id = esp_mqtt_client_publish(mqtt_client, node_manager().get_topics(node_info).discovery(), json_data, 0, 0, 0);
         ESP_LOGI(TAG, "sent discovery publish successful, msg_id=%d", msg_id);
     }
 
@@ -592,30 +548,30 @@ void mqtt_node_send_status(const bm2mqtt_node_info *node_info)
         return;
     }
 
-    const std::string root_publish = get_node_state_topic(node_info);
-    if (root_publish.empty()) {
+    const node_topics topics = node_manager().get_topics(node_info);
+    if (topics.empty()) {
         ESP_LOGE(TAG, "mqtt_node_send_status: failed to get state topic for node");
         return;
     }
 
-    std::unique_ptr<cJSON> status_message = make_status_message(node_info);
-    if (!status_message) {
-        ESP_LOGE(TAG, "mqtt_node_send_status: failed to create status message");
-        return;
-    }
+    const status_json json_data = make_status_json(*node_info);
+    int msg_id = esp_mqtt_client_publish(mqtt_client, topics.state(), json_data.c_str(), json_data.size, 0, 0);
+    ESP_LOGI(TAG, "sent status publish successful, msg_id=%d", msg_id);
+    ESP_LOGI(TAG, "TOPIC=%s", topics.state());
+    ESP_LOGI(TAG, "DATA=%s", json_data.c_str());
+}
 
-    char *json_data = cJSON_PrintUnformatted(status_message.get());
-    if (!json_data) {
-        ESP_LOGE(TAG, "mqtt_node_send_status: failed to format JSON");
+void mqtt_node_send_availability(const bm2mqtt_node_info *node_info, bool available)
+{
+    const node_topics topics = node_manager().get_topics(node_info);
+    if (topics.empty()) {
+        ESP_LOGE(TAG, "mqtt_node_send_availability: failed to get availability topic for node");
         return;
     }
 
-    int msg_id = esp_mqtt_client_publish(mqtt_client, root_publish.c_str(), json_data, 0, 0, 0);
-    ESP_LOGI(TAG, "sent status publish successful, msg_id=%d", msg_id);
-    ESP_LOGI(TAG, "TOPIC=%s", root_publish.c_str());
-    ESP_LOGI(TAG, "DATA=%s", json_data);
-
-    cJSON_free(json_data);
+    // Retained so Home Assistant picks it up after a restart
+    int msg_id = esp_mqtt_client_publish(mqtt_client, topics.availability(), available ? "online" : "offline", 0, 1, 1);
+    ESP_LOGI(TAG, "sent availability publish successful, msg_id=%d, TOPIC=%s, %s", msg_id, topics.availability(), available ? "online" : "offline");
 }
 
 void mqtt_send_discovery(const bm2mqtt_node_info *node_info)
@@ -623,7 +579,7 @@ void mqtt_send_discovery(const bm2mqtt_node_info *node_info)
     std::unique_ptr<cJSON> discovery_message = make_node_discovery_message(node_info);
         char *json_data = cJSON_PrintUnformatted(discovery_message.get());
         int msg_id = 0;
-        msg_id = esp_mqtt_client_publish(mqtt_client, get_node_discovery_id(node_info).c_str(), json_data, 0, 0, 0);
+        msg_id = esp_mqtt_client_publish(mqtt_client, node_manager().get_topics(node_info).discovery(), json_data, 0, 0, 0);
         ESP_LOGI(TAG, "sent discovery publish successful, msg_id=%d", msg_id);
 
         cJSON_free(json_data);
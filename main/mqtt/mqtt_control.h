@@ -8,14 +8,11 @@ esp_mqtt_client_handle_t get_mqtt_client();
 void mqtt5_app_start();
 void RegisterMQTTDebugCommands();
 void parse_mqtt_event_data(esp_mqtt_event_handle_t event);
-
-// Node topic generation functions
-std::string get_node_root_topic(const bm2mqtt_node_info *node_info);
-std::string get_node_set_topic(const bm2mqtt_node_info *node_info);
-std::string get_node_state_topic(const bm2mqtt_node_info *node_info);
-std::string get_node_discovery_id(const bm2mqtt_node_info *node_info);
+// Routes of the bridge topics and of the node set topics, which the router resolves by MAC
+void register_mqtt_routes();
 
 // Node communication functions
 void mqtt_node_send_status(const bm2mqtt_node_info *node_info);
+void mqtt_node_send_availability(const bm2mqtt_node_info *node_info, bool available);
 void mqtt_send_discovery(const bm2mqtt_node_info *node_info);
 int mqtt_send_status(int argc, char **argv);
\ No newline at end of file
@@ -0,0 +1,44 @@
+#include "node_topics.h"
+#include <cstring>
+#include <initializer_list>
+
+#include "esp_ble_mesh_defs.h"
+#include "ble_mesh_example_init.h"
+
+node_topics make_node_topics(std::string_view bridge_base, const uint8_t mac[6])
+{
+    node_topics topics;
+    const std::string_view mac_hex{bt_hex(mac, BD_ADDR_LEN)};
+    size_t size = 0;
+    bool fits = true;
+    const auto append = [&](std::initializer_list<std::string_view> parts)
+    {
+        const size_t start = size;
+        for (std::string_view part : parts)
+        {
+            if (size + part.size() >= topics.data.size())
+            {
+                fits = false;
+                return start;
+            }
+            memcpy(topics.data.data() + size, part.data(), part.size());
+            size += part.size();
+        }
+        topics.data[size++] = '\0';
+        return start;
+    };
+
+    const size_t root_size = bridge_base.size() + strlen("/node_") + mac_hex.size();
+    append({bridge_base, "/node_", mac_hex, "/state"});
+    const size_t availability_offset = append({bridge_base, "/node_", mac_hex, "/availability"});
+    const size_t discovery_offset = append({"homeassistant/light/blemesh2mqtt_", mac_hex, "_light/config"});
+    if (!fits || discovery_offset > UINT8_MAX)
+    {
+        return {};
+    }
+
+    topics.root_size = root_size;
+    topics.availability_offset = availability_offset;
+    topics.discovery_offset = discovery_offset;
+    return topics;
+}
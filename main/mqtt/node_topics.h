@@ -0,0 +1,30 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+// MQTT topics of one node, built once its MAC is known and kept next to its record, so publishing
+// needs no formatting. The strings are stored back to back, each NUL terminated, the state topic
+// first: the root topic is its prefix.
+struct node_topics
+{
+    // <bridge>/node_<mac>/state and /availability, then the discovery config topic, for the 25
+    // characters of the bridge base topic. Commands come through the <bridge>/+/set wildcard.
+    static constexpr size_t max_size = 168;
+
+    std::array<char, max_size> data{};
+    uint8_t root_size = 0; // 0 until built
+    uint8_t availability_offset = 0;
+    uint8_t discovery_offset = 0;
+
+    bool empty() const { return root_size == 0; }
+
+    std::string_view root() const { return {data.data(), root_size}; }
+    const char *state() const { return data.data(); }
+    const char *availability() const { return data.data() + availability_offset; }
+    const char *discovery() const { return data.data() + discovery_offset; }
+};
+
+// Empty if the topics do not fit, which a longer bridge base topic would cause
+node_topics make_node_topics(std::string_view bridge_base, const uint8_t mac[6]);
@@ -0,0 +1,70 @@
+#include "status_json.h"
+#include <charconv>
+#include <cstring>
+
+#include "ble_mesh/ble_mesh_control.h"
+#include "ble_mesh/ble_mesh_node.h"
+
+namespace
+{
+class json_writer
+{
+public:
+    explicit json_writer(status_json &out) : out(out) {}
+
+    void literal(std::string_view text)
+    {
+        memcpy(out.data.data() + out.size, text.data(), text.size());
+        out.size += text.size();
+    }
+
+    // cJSON prints whole numbers with %d, the values here are all uint16_t
+    void number(uint16_t value)
+    {
+        out.size = std::to_chars(out.data.data() + out.size, out.data.data() + out.data.size(), value).ptr - out.data.data();
+    }
+
+private:
+    status_json &out;
+};
+} // namespace
+
+status_json make_status_json(const bm2mqtt_node_info &node)
+{
+    status_json json;
+    json_writer writer(json);
+
+    writer.literal("{");
+    if (node.unicast != ESP_BLE_MESH_ADDR_UNASSIGNED)
+    {
+        writer.literal(node.onoff ? "\"state\":\"ON\"" : "\"state\":\"OFF\"");
+
+        if (node.color_mode == color_mode_t::brightness)
+        {
+            writer.literal(",\"color_mode\":\"brightness\",\"brightness\":");
+            writer.number((uint16_t)map(node.hsl_l, node.min_lightness, node.max_lightness, 0, 255));
+        }
+        else if (node.color_mode == color_mode_t::color_temp)
+        {
+            writer.literal(",\"color_mode\":\"color_temp\",\"color_temp\":");
+            writer.number(node.curr_temp);
+        }
+        else if (node.color_mode == color_mode_t::hs)
+        {
+            writer.literal(",\"color_mode\":\"hs\",\"color\":{\"h\":");
+            writer.number((uint16_t)map(node.hsl_h, node.min_hue, node.max_hue, 0, 360));
+            writer.literal(",\"s\":");
+            writer.number((uint16_t)map(node.hsl_s, node.min_saturation, node.max_saturation, 0, 100));
+            writer.literal("}");
+        }
+
+        // Restored from NVS at a warm start, not confirmed by the light yet
+        if (get_field_source(&node, FIELD_ONOFF) == state_source::assumed)
+        {
+            writer.literal(",\"assumed\":true");
+        }
+    }
+    writer.literal("}");
+    json.data[json.size] = '\0';
+    return json;
+}
@@ -0,0 +1,23 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <string_view>
+
+struct bm2mqtt_node_info;
+
+// Node state payload for the light's state topic, written straight into a fixed buffer. Same
+// bytes as the cJSON tree it replaced printed unformatted, without allocating.
+struct status_json
+{
+    // {"state":"OFF","color_mode":"color_temp","color_temp":65535,"assumed":true} and the hs
+    // form with both color components at their largest fit with room to spare
+    static constexpr size_t max_size = 96;
+
+    std::array<char, max_size> data{};
+    size_t size = 0;
+
+    const char *c_str() const { return data.data(); }
+    std::string_view view() const { return {data.data(), size}; }
+};
+
+status_json make_status_json(const bm2mqtt_node_info &node);
@@ -0,0 +1,121 @@
+#include "topic_router.h"
+#include <algorithm>
+
+// FNV-1a, like node_record digests
+uint32_t topic_router::hash_topic(std::string_view topic)
+{
+    uint32_t hash = 2166136261u;
+    for (char c : topic)
+    {
+        hash = (hash ^ static_cast<uint8_t>(c)) * 16777619u;
+    }
+    return hash;
+}
+
+void topic_router::clear()
+{
+    entries.clear();
+    level_routes.clear();
+    pool.clear();
+    count = 0;
+}
+
+// Slot holding topic, or the empty slot ending its probe sequence
+size_t topic_router::probe(std::string_view topic, uint32_t hash) const
+{
+    const size_t mask = entries.size() - 1;
+    size_t i = hash & mask;
+    while (entries[i].target.handler && !(entries[i].hash == hash && key(entries[i]) == topic))
+    {
+        i = (i + 1) & mask;
+    }
+    return i;
+}
+
+void topic_router::grow()
+{
+    std::vector<entry> old = std::move(entries);
+    entries.assign(std::max<size_t>(16, old.size() * 2), entry{});
+    for (const entry &e : old)
+    {
+        if (!e.target.handler)
+            continue;
+        size_t i = e.hash & (entries.size() - 1);
+        while (entries[i].target.handler)
+        {
+            i = (i + 1) & (entries.size() - 1);
+        }
+        entries[i] = e;
+    }
+}
+
+void topic_router::add(std::string_view topic, handler_t handler, slab_handle node)
+{
+    if (!handler || topic.size() > UINT16_MAX)
+        return;
+    if ((count + 1) * 2 > entries.size())
+    {
+        grow();
+    }
+
+    const uint32_t hash = hash_topic(topic);
+    entry &e = entries[probe(topic, hash)];
+    if (!e.target.handler)
+    {
+        e.hash = hash;
+        e.offset = store(topic);
+        e.length = topic.size();
+        count++;
+    }
+    e.target = {handler, node};
+}
+
+uint32_t topic_router::store(std::string_view text)
+{
+    const uint32_t offset = pool.size();
+    pool.insert(pool.end(), text.begin(), text.end());
+    return offset;
+}
+
+void topic_router::add_level(std::string_view prefix, std::string_view suffix, handler_t handler, resolver_t resolver)
+{
+    if (!handler || !resolver || prefix.size() > UINT16_MAX || suffix.size() > UINT16_MAX)
+        return;
+    level_route r;
+    r.prefix_offset = store(prefix);
+    r.prefix_length = prefix.size();
+    r.suffix_offset = store(suffix);
+    r.suffix_length = suffix.size();
+    r.handler = handler;
+    r.resolver = resolver;
+    level_routes.push_back(r);
+}
+
+topic_router::route topic_router::find(std::string_view topic) const
+{
+    if (!entries.empty())
+    {
+        if (const route &exact = entries[probe(topic, hash_topic(topic))].target; exact.handler)
+            return exact;
+    }
+
+    for (const level_route &r : level_routes)
+    {
+        const std::string_view prefix{pool.data() + r.prefix_offset, r.prefix_length};
+        const std::string_view suffix{pool.data() + r.suffix_offset, r.suffix_length};
+        if (topic.size() < prefix.size() + suffix.size() + 2 || !topic.starts_with(prefix) || !topic.ends_with(suffix) ||
+            topic[prefix.size()] != '/' || topic[topic.size() - suffix.size() - 1] != '/')
+            continue;
+        const std::string_view level = topic.substr(prefix.size() + 1, topic.size() - prefix.size() - suffix.size() - 2);
+        if (level.find('/') != std::string_view::npos)
+            continue;
+        return {r.handler, r.resolver(level)};
+    }
+    return {};
+}
+
+topic_router &mqtt_topic_router()
+{
+    static topic_router router;
+    return router;
+}
@@ -0,0 +1,69 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+#include "ble_mesh/slab.h"
+
+// Inbound MQTT dispatch. Exact topics are registered with their handler: a lookup hashes the
+// received topic once and probes an open addressing table, at most half full, topic bytes kept in
+// one pool. Topics of a single-level wildcard subscription, prefix/+/suffix, go to a level route
+// whose resolver maps the + level to the node it addresses, so nodes need no registration of
+// their own. Not thread safe: registration and dispatch both run on the MQTT task.
+class topic_router final
+{
+public:
+    // data is the MQTT payload, not NUL terminated; node is invalid for bridge topics
+    using handler_t = void (*)(const char *data, int data_len, slab_handle node);
+    // Node addressed by the + level of a wildcard topic, invalid if none
+    using resolver_t = slab_handle (*)(std::string_view level);
+
+    struct route
+    {
+        handler_t handler = nullptr;
+        slab_handle node;
+    };
+
+    void clear();
+    // A topic registered again takes the new route
+    void add(std::string_view topic, handler_t handler, slab_handle node = {});
+    // Topics prefix + "/" + level + "/" + suffix, level holding no '/'. Exact topics win.
+    void add_level(std::string_view prefix, std::string_view suffix, handler_t handler, resolver_t resolver);
+    // handler is nullptr for topics never registered
+    route find(std::string_view topic) const;
+
+    size_t size() const { return count + level_routes.size(); }
+
+private:
+    struct entry
+    {
+        uint32_t hash = 0;
+        uint32_t offset = 0;
+        uint16_t length = 0;
+        route target;
+    };
+
+    struct level_route
+    {
+        uint32_t prefix_offset = 0;
+        uint16_t prefix_length = 0;
+        uint32_t suffix_offset = 0;
+        uint16_t suffix_length = 0;
+        handler_t handler = nullptr;
+        resolver_t resolver = nullptr;
+    };
+
+    static uint32_t hash_topic(std::string_view topic);
+    uint32_t store(std::string_view text);
+    std::string_view key(const entry &e) const { return {pool.data() + e.offset, e.length}; }
+    size_t probe(std::string_view topic, uint32_t hash) const;
+    void grow();
+
+    std::vector<entry> entries;
+    std::vector<level_route> level_routes;
+    std::vector<char> pool;
+    size_t count = 0;
+};
+
+topic_router &mqtt_topic_router();
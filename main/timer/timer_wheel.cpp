@@ -0,0 +1,262 @@
+#include "timer_wheel.h"
+#include "esp_log.h"
+#include <algorithm>
+#include <esp_console.h>
+#include "debug/debug_commands_registry.h"
+#include "debug/console_cmd.h"
+
+static const char *TAG = "TimerWheel";
+
+static constexpr int64_t tick_us = CONFIG_BM2MQTT_TIMER_WHEEL_TICK_MS * 1000;
+
+timer_wheel_service &timer_wheel()
+{
+    static timer_wheel_service instance;
+    return instance;
+}
+
+static void list_init(wheel_timer &head)
+{
+    head.prev = &head;
+    head.next = &head;
+}
+
+static void list_push_back(wheel_timer &head, wheel_timer &timer)
+{
+    timer.prev = head.prev;
+    timer.next = &head;
+    head.prev->next = &timer;
+    head.prev = &timer;
+}
+
+timer_wheel_service::timer_wheel_service()
+{
+    for (auto &slot : slots)
+    {
+        list_init(slot);
+    }
+    list_init(due);
+}
+
+void timer_wheel_service::init_timer(wheel_timer &timer, wheel_timer::callback_t callback, void *arg, const char *name)
+{
+    stop(timer);
+    timer.callback = callback;
+    timer.arg = arg;
+    timer.name = name;
+}
+
+// First tick at or after the deadline, so a timer never fires early and at most one tick late
+static uint64_t deadline_tick(int64_t deadline_us)
+{
+    return (std::max<int64_t>(deadline_us, 0) + tick_us - 1) / tick_us;
+}
+
+void timer_wheel_service::start_once(wheel_timer &timer, uint64_t timeout_us)
+{
+    std::lock_guard<std::mutex> lock(wheel_mutex);
+    unlink_locked(timer);
+    timer.period_ticks = 0;
+    arm_locked(timer, deadline_tick(esp_timer_get_time() + timeout_us));
+}
+
+void timer_wheel_service::start_periodic(wheel_timer &timer, uint64_t period_us)
+{
+    std::lock_guard<std::mutex> lock(wheel_mutex);
+    unlink_locked(timer);
+    timer.period_ticks = std::max<uint32_t>(1, (period_us + tick_us - 1) / tick_us);
+    arm_locked(timer, deadline_tick(esp_timer_get_time() + period_us));
+}
+
+void timer_wheel_service::stop(wheel_timer &timer)
+{
+    std::lock_guard<std::mutex> lock(wheel_mutex);
+    timer.period_ticks = 0;
+    // The esp_timer stays armed, the wake it was armed for finds nothing due and reschedules
+    unlink_locked(timer);
+}
+
+bool timer_wheel_service::is_active(const wheel_timer &timer)
+{
+    std::lock_guard<std::mutex> lock(wheel_mutex);
+    return timer.prev != nullptr;
+}
+
+void timer_wheel_service::arm_locked(wheel_timer &timer, uint64_t tick)
+{
+    timer.expires_tick = std::max(tick, cursor_tick + 1);
+    list_push_back(slots[timer.expires_tick % slot_count], timer);
+
+    active++;
+    peak_active = std::max(peak_active, active);
+
+    if (!ticking || timer.expires_tick < wake_tick)
+    {
+        wake_at_locked(timer.expires_tick);
+    }
+}
+
+void timer_wheel_service::unlink_locked(wheel_timer &timer)
+{
+    if (!timer.prev)
+        return;
+
+    timer.prev->next = timer.next;
+    timer.next->prev = timer.prev;
+    timer.prev = nullptr;
+    timer.next = nullptr;
+    active--;
+}
+
+// Every linked timer expires after cursor_tick, and a slot only holds ticks congruent to its
+// index, so the first exact match walking the next turn of the wheel is the earliest deadline.
+uint64_t timer_wheel_service::next_expiry_locked() const
+{
+    uint64_t earliest = UINT64_MAX;
+    for (uint64_t tick = cursor_tick + 1; tick <= cursor_tick + slot_count; tick++)
+    {
+        const wheel_timer &slot = slots[tick % slot_count];
+        for (const wheel_timer *timer = slot.next; timer != &slot; timer = timer->next)
+        {
+            if (timer->expires_tick == tick)
+                return tick;
+            earliest = std::min(earliest, timer->expires_tick);
+        }
+    }
+    return earliest;
+}
+
+void timer_wheel_service::wake_at_locked(uint64_t tick)
+{
+    if (!tick_timer)
+    {
+        const esp_timer_create_args_t timer_args = {
+            .callback = &timer_wheel_service::tick_callback,
+            .arg = this,
+            .dispatch_method = ESP_TIMER_TASK,
+            .name = "timer_wheel"};
+        ESP_ERROR_CHECK(esp_timer_create(&timer_args, &tick_timer));
+    }
+
+    // Fails when the timer already fired and its callback waits for the lock, that is harmless
+    esp_timer_stop(tick_timer);
+    const int64_t delay_us = (int64_t)tick * tick_us - esp_timer_get_time();
+    esp_timer_start_once(tick_timer, std::max<int64_t>(delay_us, 0));
+    ticking = true;
+    wake_tick = tick;
+}
+
+void timer_wheel_service::tick_callback(void *arg)
+{
+    auto *self = static_cast<timer_wheel_service *>(arg);
+    self->on_tick();
+}
+
+void timer_wheel_service::on_tick()
+{
+    {
+        std::lock_guard<std::mutex> lock(wheel_mutex);
+        wakeups++;
+
+        // Visit the slots of every tick since the last wake, at most one turn of the wheel
+        const uint64_t now_tick = esp_timer_get_time() / tick_us;
+        const uint64_t first = std::max(cursor_tick + 1, now_tick >= slot_count ? now_tick - slot_count + 1 : 0);
+        for (uint64_t tick = first; tick <= now_tick; tick++)
+        {
+            wheel_timer &slot = slots[tick % slot_count];
+            wheel_timer *timer = slot.next;
+            while (timer != &slot)
+            {
+                wheel_timer *next = timer->next;
+                if (timer->expires_tick <= now_tick)
+                {
+                    unlink_locked(*timer);
+                    list_push_back(due, *timer);
+                    active++;
+                }
+                timer = next;
+            }
+        }
+        cursor_tick = std::max(cursor_tick, now_tick);
+    }
+
+    // Callbacks run without the lock so they can start or stop timers, including their own
+    while (true)
+    {
+        wheel_timer::callback_t callback;
+        void *arg;
+        {
+            std::lock_guard<std::mutex> lock(wheel_mutex);
+            if (due.next == &due)
+            {
+                // Nothing armed means no wake until the next start
+                if (active == 0)
+                {
+                    esp_timer_stop(tick_timer);
+                    ticking = false;
+                }
+                else if (const uint64_t tick = next_expiry_locked(); !ticking || tick != wake_tick)
+                {
+                    wake_at_locked(tick);
+                }
+                return;
+            }
+
+            wheel_timer &timer = *due.next;
+            unlink_locked(timer);
+            if (timer.period_ticks > 0)
+            {
+                arm_locked(timer, cursor_tick + timer.period_ticks);
+            }
+            callback = timer.callback;
+            arg = timer.arg;
+            fired++;
+        }
+
+        if (callback)
+        {
+            callback(arg);
+        }
+    }
+}
+
+void timer_wheel_service::print_debug()
+{
+    std::lock_guard<std::mutex> lock(wheel_mutex);
+    ESP_LOGI(TAG, "=== Timer Wheel Status ===");
+    ESP_LOGI(TAG, "Tick: %d ms, slots: %" PRIu32 ", current tick: %" PRIu64, CONFIG_BM2MQTT_TIMER_WHEEL_TICK_MS, slot_count, cursor_tick);
+    if (ticking)
+        ESP_LOGI(TAG, "Next wake in %" PRIu64 " tick(s)", wake_tick > cursor_tick ? wake_tick - cursor_tick : 0);
+    else
+        ESP_LOGI(TAG, "Idle");
+    ESP_LOGI(TAG, "Active timers: %" PRIu32 " (peak %" PRIu32 "), fired: %" PRIu32 ", wakeups: %" PRIu32, active, peak_active, fired, wakeups);
+
+    for (uint32_t i = 0; i < slot_count; i++)
+    {
+        const wheel_timer &slot = slots[i];
+        for (const wheel_timer *timer = slot.next; timer != &slot; timer = timer->next)
+        {
+            ESP_LOGI(TAG, "    slot %" PRIu32 ": %s (expires at tick %" PRIu64 ", period: %" PRIu32 " ticks)",
+                     i, timer->name, timer->expires_tick, timer->period_ticks);
+        }
+    }
+}
+
+int timer_wheel_print_debug_cmd(int argc, char **argv)
+{
+    timer_wheel().print_debug();
+    return 0;
+}
+
+void RegisterTimerWheelDebugCommands()
+{
+    const esp_console_cmd_t timer_wheel_print_debug = {
+        .command = "timer_wheel_print_debug",
+        .help = "Print the timers registered with the bridge timer wheel",
+        .hint = NULL,
+        .func = &timer_wheel_print_debug_cmd,
+    };
+    ESP_ERROR_CHECK(register_console_command(&timer_wheel_print_debug));
+}
+
+REGISTER_DEBUG_COMMAND(RegisterTimerWheelDebugCommands);
@@ -0,0 +1,70 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <mutex>
+#include <esp_timer.h>
+
+// A deadline registered with the timer wheel. The owner keeps it alive (usually as a
+// member), the wheel only links it into its slots, so arming and cancelling never allocate.
+struct wheel_timer
+{
+    using callback_t = void (*)(void *arg);
+
+    callback_t callback = nullptr;
+    void *arg = nullptr;
+    const char *name = "";
+
+    // Managed by timer_wheel_service
+    wheel_timer *prev = nullptr;
+    wheel_timer *next = nullptr;
+    uint64_t expires_tick = 0;
+    uint32_t period_ticks = 0;
+};
+
+// Hashed timer wheel driven by a single one-shot esp_timer. Every bridge deadline (queue
+// failsafes, debounced NVS saves, periodic publishes) is a wheel_timer, start and stop are O(1)
+// whatever the number of nodes. The esp_timer is armed on the tick of the earliest deadline,
+// so long timers do not wake the CPU every tick. Callbacks run on the esp_timer task, like before.
+class timer_wheel_service
+{
+public:
+    static constexpr uint32_t slot_count = 64;
+
+    timer_wheel_service();
+
+    void init_timer(wheel_timer &timer, wheel_timer::callback_t callback, void *arg, const char *name);
+
+    // Same semantics as esp_timer_start_once / start_periodic: an armed timer is re-armed.
+    void start_once(wheel_timer &timer, uint64_t timeout_us);
+    void start_periodic(wheel_timer &timer, uint64_t period_us);
+    void stop(wheel_timer &timer);
+    bool is_active(const wheel_timer &timer);
+
+    void print_debug();
+
+private:
+    static void tick_callback(void *arg);
+    void on_tick();
+
+    void arm_locked(wheel_timer &timer, uint64_t tick);
+    void unlink_locked(wheel_timer &timer);
+    // Earliest tick holding a deadline, only called with timers armed
+    uint64_t next_expiry_locked() const;
+    void wake_at_locked(uint64_t tick);
+
+    // Sentinels of the circular lists, a timer is linked when its prev pointer is set
+    std::array<wheel_timer, slot_count> slots{};
+    wheel_timer due{};
+
+    std::mutex wheel_mutex;
+    esp_timer_handle_t tick_timer = nullptr;
+    bool ticking = false;
+    uint64_t wake_tick = 0; // Tick the esp_timer is armed on while ticking
+    uint64_t cursor_tick = 0; // Last tick processed, ticks count from esp_timer epoch
+    uint32_t active = 0;
+    uint32_t wakeups = 0;
+    uint32_t peak_active = 0;
+    uint32_t fired = 0;
+};
+
+timer_wheel_service &timer_wheel();
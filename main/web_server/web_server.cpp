@@ -11,6 +11,7 @@
 #include <mqtt/mqtt_control.h>
 #include <mqtt/mqtt_bridge.h>
 #include "wifi/wifi_provisioning.h"
+#include <ble_mesh/message_queue.h>
 
 #define TAG "WEB_SERVER"
 
@@ -190,26 +191,14 @@ esp_err_t set_lightness_handler(httpd_req_t *req)
     }
 
     // Find the node by UUID
-    const esp_ble_mesh_node_t *node = NULL;
-    for (int i = 0; i < CONFIG_BLE_MESH_MAX_PROV_NODES; i++)
-    {
-        const esp_ble_mesh_node_t *n = esp_ble_mesh_provisioner_get_node_table_entry()[i];
-        if (n && memcmp(n->dev_uuid, uuid, 16) == 0)
-        {
-            node = n;
-            break;
-        }
-    }
-
-    if (!node)
+    const Uuid128 dev_uuid{uuid};
+    if (!node_manager().get_node(dev_uuid))
     {
         httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "Node not found");
         return ESP_FAIL;
     }
 
-    // Optional: use node->unicast_addr or other data
     printf("Lightness for UUID: %s → %d\n", uuid_str, lightness);
-    const Uuid128 dev_uuid{uuid};
     ble_mesh_ctl_lightness_set(lightness, dev_uuid); // Extend this to accept node?
 
     httpd_resp_send(req, NULL, 0);
@@ -373,6 +362,25 @@ esp_err_t list_console_commands_handler(httpd_req_t *req) {
     return httpd_resp_sendstr_chunk(req, NULL);
 }
 
+// Large fleets are paged: ?from=<slot> starts at a node slot, "next" in the answer gives the following page
+esp_err_t mesh_stats_json_handler(httpd_req_t *req)
+{
+    size_t first_slot = 0;
+    char query[32];
+    char from[12];
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK &&
+        httpd_query_key_value(query, "from", from, sizeof(from)) == ESP_OK) {
+        first_slot = strtoul(from, NULL, 10);
+    }
+
+    httpd_resp_set_type(req, "application/json");
+    esp_err_t err = ESP_OK;
+    message_queue().print_stats_json(first_slot, [req, &err](std::string_view json) {
+        err = httpd_resp_send(req, json.data(), json.size());
+    });
+    return err;
+}
+
 esp_err_t send_bridge_mqtt_discovery_handler(httpd_req_t *req)
 {
     send_bridge_discovery();
@@ -528,6 +536,13 @@ httpd_uri_t console_cmds_uri = {
     .user_ctx = NULL
 };
 
+httpd_uri_t mesh_stats_uri = {
+    .uri = "/api/mesh_stats",
+    .method = HTTP_GET,
+    .handler = mesh_stats_json_handler,
+    .user_ctx = NULL
+};
+
 httpd_uri_t rename_uri = {
     .uri = "/api/rename_node",
     .method = HTTP_POST,
@@ -720,6 +735,7 @@ void start_webserver(void)
             httpd_register_uri_handler(server, &reset_wifi_uri);
             httpd_register_uri_handler(server, &json_nodes_uri);
             httpd_register_uri_handler(server, &console_cmds_uri);
+            httpd_register_uri_handler(server, &mesh_stats_uri);
            
             websocket_logger_register_uri(server);
             websocket_logger_install();